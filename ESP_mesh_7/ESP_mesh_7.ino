@@ -15,6 +15,9 @@ void setup() {
   Serial.begin(9600);                   // baud rate (should be same for EM50 datalogger)
 
   randomSeed(system_get_rtc_time());    // randomize seed for subnet generation
+  rtc.load();                           // parent, lease and softAP from before deep-sleep/reset, if any
+  load_role();                          // gateway root or mesh node, from flash
+  restore_duty_cycle();                 // back on the wake schedule after a scheduled sleep
   
   if (MESH_MODE_ACTIVE){  
     setup_mesh();                       // setup mesh AP
@@ -24,8 +27,11 @@ void setup() {
 }
 
 void loop() {    
-  if (Serial.available()) {
-    decode_command(Serial.readString());  // decodes/executes serial command
+  unsigned long loop_ms = millis();
+  
+  String command;
+  if (console.read_command(command)) {    // serial command, text or framed
+    decode_command(command);              // decodes/executes serial command
   }
   listen_to_ports();                      // process TCP/UDP messages
 
@@ -37,12 +43,11 @@ void loop() {
       digitalWrite(5, 0);    
       // ------------------------------------
       
-      if (!is_connected_to_mesh()) {
-        connect_to_mesh();
-      }               
       ticker=0; 
     }
     ticker++;
+    reconnect_maintenance();              // check the link, reconnect with backoff and jitter
   }
-  delay(DELAY);
+  stalls.loop_done(millis() - loop_ms);   // flag iterations that kept the node deaf
+  mesh_delay(DELAY);                      // reads TCP meanwhile, shorter if a SENSOR_AT sample is due
 }
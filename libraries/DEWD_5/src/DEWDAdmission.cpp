@@ -0,0 +1,126 @@
+/*
+ DEWDAdmission.cpp Body file defining the admission control of broadcasts.
+ Created by agent, 2026.
+ 
+ */
+ 
+#include <Arduino.h>
+#include <DEWDAdmission.h>
+
+DEWDAdmission admission;
+
+ICACHE_FLASH_ATTR DEWDAdmission::DEWDAdmission() {
+}
+
+/* Change the rate limit, buckets start full again
+     *
+	 * param new_rate: broadcasts per minute and originator, 0 turns rate limiting off
+	 * param new_burst: bucket size
+     */
+void ICACHE_FLASH_ATTR DEWDAdmission::set(uint16_t new_rate, uint8_t new_burst) {
+	rate = new_rate;
+	burst = new_burst > 0 ? new_burst : 1;
+	_count = 0;
+}
+
+/* Apply "<per_minute> [<burst> [<in_flight>]]" as carried by ADMIT. Missing fields keep their 
+	value, so a short command cannot turn rate limiting off by accident. Nothing changes if a 
+	given field is not a number.
+     *
+	 * param args: the fields, separated by single spaces
+	 * return: false if the fields are malformed
+     */
+bool ICACHE_FLASH_ATTR DEWDAdmission::configure(String args) {
+	long values[3] = {rate, burst, in_flight};
+	const long limits[3] = {0xFFFF, 0xFF, 0xFF};
+	for (int i=0; i<3 && args.length() > 0; i++) {
+		int end = args.indexOf(' ');
+		String word = end < 0 ? args : args.substring(0, end);
+		args = end < 0 ? String() : args.substring(end + 1);
+		if (!isdigit(word[0]) || word.toInt() > limits[i])
+			return false;
+		values[i] = word.toInt();
+	}
+	if (args.length() > 0)											// more than three fields
+		return false;
+	if (values[0] != rate || values[1] != burst)					// buckets start full again only on a change
+		set(values[0], values[1]);
+	in_flight = values[2];
+	return true;
+}
+
+/* Take a token from the originator's bucket
+     *
+	 * param origin: STA MAC of the originator
+	 * param now: current time in ms
+	 * return: false if the originator is over its rate
+     */
+bool DEWDAdmission::admit(MACAddress origin, unsigned long now) {
+	if (rate == 0) {
+		admitted++;
+		return true;
+	}
+	const uint32_t full = (uint32_t)burst * 60000;
+	int i;
+	for (i=0; i<_count; i++)
+		if (_buckets[i].origin == origin)
+			break;
+	if (i == _count) {
+		if (_count < ADMIT_ORIGINS)
+			_count++;
+		else {														// reuse the bucket refilled longest ago
+			i = 0;
+			for (int j=1; j<_count; j++)
+				if (_buckets[j].refill_ms - _buckets[i].refill_ms > 0x7FFFFFFF)
+					i = j;
+		}
+		_buckets[i].origin = origin;
+		_buckets[i].tokens = full;
+		_buckets[i].refill_ms = now;
+	}
+	
+	DEWDBucket & b = _buckets[i];
+	unsigned long elapsed = now - b.refill_ms;
+	if (elapsed >= 60000 || elapsed * rate >= full - b.tokens)
+		b.tokens = full;
+	else
+		b.tokens += elapsed * rate;
+	b.refill_ms = now;
+	if (b.tokens < 60000) {
+		dropped_rate++;
+		return false;
+	}
+	b.tokens -= 60000;
+	admitted++;
+	return true;
+}
+
+/* Check the in-flight limit of the originator
+     *
+	 * param active: broadcasts active on this node
+	 * return: false if a new broadcast has to wait
+     */
+bool DEWDAdmission::may_start(int active) {
+	if (in_flight == 0 || active < in_flight)
+		return true;
+	dropped_busy++;
+	return false;
+}
+
+String ICACHE_FLASH_ATTR DEWDAdmission::print_values(void) {
+	String res = " rate=";
+	res += rate;
+	res += "/min burst=";
+	res += burst;
+	res += " in_flight=";
+	res += in_flight;
+	res += " admitted=";
+	res += admitted;
+	res += " dropped_rate=";
+	res += dropped_rate;
+	res += " dropped_busy=";
+	res += dropped_busy;
+	res += " origins=";
+	res += _count;
+	return res;
+}
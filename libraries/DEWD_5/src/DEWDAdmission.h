@@ -0,0 +1,52 @@
+/*
+ DEWDAdmission.h Header file defining the admission control of broadcasts.
+ Every relay keeps a token bucket per originator of broadcasts, identified by the "#O<mac>" option, 
+ and answers broadcasts over the rate with a busy entry "!<mac> busy;" instead of forwarding them. 
+ The originator also limits the broadcasts it has in flight and answers 'tcp -b' with "BUSY" when 
+ the limit is reached, so a collector polling too fast backs off instead of flooding the mesh.
+ Created by agent, 2026.
+ 
+ */
+ 
+#ifndef DEWDAdmission_h
+#define DEWDAdmission_h
+
+#include <MACAddress.h>
+#include <WString.h>
+
+	const int ADMIT_ORIGINS = 8;									// originators with a bucket of their own, the oldest is reused
+	const uint16_t ADMIT_RATE = 30;									// default broadcasts per minute and originator
+	const uint8_t ADMIT_BURST = 5;									// default bucket size
+	const uint8_t ADMIT_IN_FLIGHT = 3;								// default broadcasts an originator has active at a time
+
+struct DEWDBucket {
+	MACAddress origin;
+	uint32_t tokens;												// in 1/60000 of a broadcast, so a ms adds rate units
+	unsigned long refill_ms;
+};
+
+class DEWDAdmission
+{
+private:
+	DEWDBucket _buckets[ADMIT_ORIGINS];
+	int _count = 0;
+
+public:
+	uint16_t rate = ADMIT_RATE;										// broadcasts per minute, 0 turns rate limiting off
+	uint8_t burst = ADMIT_BURST;
+	uint8_t in_flight = ADMIT_IN_FLIGHT;
+	uint32_t admitted = 0;											// statistics, see print_values()
+	uint32_t dropped_rate = 0;
+	uint32_t dropped_busy = 0;
+	
+	DEWDAdmission();
+	void set(uint16_t new_rate, uint8_t new_burst);
+	bool configure(String args);
+	bool admit(MACAddress origin, unsigned long now);
+	bool may_start(int active);
+	String print_values(void);
+};
+
+extern DEWDAdmission admission;
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ DEWDBackoff.cpp Body file defining when a node that has lost the mesh tries to reconnect.
+ Created by agent, 2026.
+ 
+ */
+ 
+#include <Arduino.h>
+#include <DEWDBackoff.h>
+
+ICACHE_FLASH_ATTR DEWDBackoff::DEWDBackoff(unsigned long check) {
+	check_ms = check;
+}
+
+/* return: a random wait between half of wait and wait
+     */
+unsigned long DEWDBackoff::jitter(unsigned long wait) {
+	return wait / 2 + random(wait / 2 + 1);
+}
+
+/* return: true if the link should be checked, or a reconnect attempted, now
+     */
+bool DEWDBackoff::due(unsigned long now) {
+	return (long)(now - _next_ms) >= 0;
+}
+
+/* The node is connected to the mesh, check again in check_ms
+     *
+	 * param now: current time in ms
+     */
+void ICACHE_FLASH_ATTR DEWDBackoff::connected(unsigned long now) {
+	if (lost_ms != 0) {
+		recovery_ms = now - lost_ms;
+		lost_ms = 0;
+	}
+	attempts = 0;
+	_next_ms = now + check_ms;
+}
+
+/* The link check found the node disconnected, the first attempt follows after a random part of BACKOFF_BASE
+     *
+	 * param now: current time in ms
+     */
+void ICACHE_FLASH_ATTR DEWDBackoff::lost(unsigned long now) {
+	if (lost_ms != 0)
+		return;
+	lost_ms = now ? now : 1;
+	attempts = 0;
+	_next_ms = now + random(BACKOFF_BASE + 1);
+}
+
+/* Double the wait after a failed attempt, up to BACKOFF_CAP
+     *
+	 * param now: current time in ms
+     */
+void ICACHE_FLASH_ATTR DEWDBackoff::attempt_failed(unsigned long now) {
+	if (lost_ms == 0)
+		lost_ms = now ? now : 1;
+	unsigned long wait = BACKOFF_CAP;
+	if (attempts < 16 && (BACKOFF_BASE << attempts) < BACKOFF_CAP)
+		wait = BACKOFF_BASE << attempts;
+	if (attempts < 255)
+		attempts++;
+	failed++;
+	_next_ms = now + jitter(wait);
+}
+
+/* Look at a finished scan while waiting to reconnect. More joinable parents than after the scan 
+	before means a parent has come back or has room, so the next attempt is moved to within BACKOFF_FAST ms.
+     *
+	 * param parents: joinable parents, see DEWDParentTable::joinable()
+	 * param now: current time in ms
+     */
+void ICACHE_FLASH_ATTR DEWDBackoff::on_scan(int parents, unsigned long now) {
+	bool appeared = _parents >= 0 && parents > _parents;
+	_parents = parents;
+	if (!appeared || lost_ms == 0)
+		return;
+	unsigned long next = now + random(BACKOFF_FAST + 1);
+	if ((long)(_next_ms - next) > 0) {
+		_next_ms = next;
+		fast++;
+	}
+}
+
+String ICACHE_FLASH_ATTR DEWDBackoff::print_values(unsigned long now) {
+	String res = lost_ms != 0 ? " disconnected for " : " connected, check in ";
+	res += lost_ms != 0 ? now - lost_ms : (due(now) ? 0 : _next_ms - now);
+	res += " ms";
+	if (lost_ms != 0) {
+		res += "\n attempts=";
+		res += attempts;
+		res += " next_in_ms=";
+		res += due(now) ? 0 : _next_ms - now;
+	}
+	res += "\n failed=";
+	res += failed;
+	res += " fast_retries=";
+	res += fast;
+	res += " last_recovery_ms=";
+	res += recovery_ms;
+	return res;
+}
@@ -0,0 +1,47 @@
+/*
+ DEWDBackoff.h Header file defining when a node that has lost the mesh tries to reconnect.
+ Every failed attempt doubles the wait, up to BACKOFF_CAP, and the actual wait is drawn at random 
+ from its upper half, so nodes that lost their parent at the same time (a root reboot) do not keep 
+ retrying in lockstep and colliding on the air. A scan after which more parents can be joined than 
+ after the one before means a parent came back or the tree has grown, the next attempt is then pulled 
+ forward to a short random delay.
+ Created by agent, 2026.
+ 
+ */
+ 
+#ifndef DEWDBackoff_h
+#define DEWDBackoff_h
+
+#include <WString.h>
+
+	const unsigned long BACKOFF_BASE = 2000;						// ms before the first attempt after the link was lost
+	const unsigned long BACKOFF_CAP = 60000;						// longest wait between two attempts
+	const unsigned long BACKOFF_FAST = 3000;						// attempts after a new mesh beacon are spread over this many ms
+	const unsigned long BACKOFF_SCAN_AGE = 10000;					// ms a scan is good for while waiting to reconnect
+
+class DEWDBackoff
+{
+private:
+	unsigned long _next_ms = 0;
+	int _parents = -1;												// joinable parents after the last scan, -1 before the first one
+	
+	unsigned long jitter(unsigned long wait);
+
+public:
+	uint8_t attempts = 0;											// failed attempts since the link was lost
+	unsigned long check_ms;											// interval of the link check while connected
+	uint16_t failed = 0;											// statistics, see print_values()
+	uint16_t fast = 0;
+	unsigned long lost_ms = 0;
+	unsigned long recovery_ms = 0;									// time the last reconnect took
+	
+	DEWDBackoff(unsigned long check);
+	bool due(unsigned long now);
+	void connected(unsigned long now);
+	void lost(unsigned long now);
+	void attempt_failed(unsigned long now);
+	void on_scan(int parents, unsigned long now);
+	String print_values(unsigned long now);
+};
+
+#endif
@@ -54,6 +54,11 @@ String DEWDBroadcast::print_values(void) {
 	res += ".";
 	res += src_ip[3];
 	
+	if (sample_pending) {
+		res += " sample_at=";
+		res += sample_at;
+	}
+	
 	res += " resp_message:";
 	res += '\n';
 	res += "	";
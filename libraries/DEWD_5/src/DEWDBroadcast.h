@@ -10,6 +10,7 @@
 #define DEWDBroadcast_h
 
 #include <IPAddress.h>
+#include <MACAddress.h>
 #include <WString.h>
 class DEWDBroadcast {
     public:
@@ -18,6 +19,21 @@ class DEWDBroadcast {
 		uint8_t resp_index = 0;			// number indicating how many messages sent and how many responses to expect back
 		IPAddress src_ip;				// the IP of the originating broadcast
 		String resp_message;			// response to be sent to src_ip. Can be a combination of multiple responses
+		unsigned long start_ms = 0;		// millis() when the broadcast was received or originated
+		bool sample_pending = false;	// SENSOR_AT: own sample not taken yet, counted in resp_index
+		unsigned long sample_at = 0;	// mesh time of the scheduled sample
+		String sample_command;			// command for the sensor
+		bool trace = false;				// every node reports its timing, see parse_options()
+		uint8_t hop = 0;				// hops from the originator, only carried when tracing
+		unsigned long exec_ms = 0;		// time spent executing the command on this node
+		unsigned long forward_ms = 0;	// time from start_ms until the broadcast was forwarded to all neighbours
+		MACAddress origin;				// #O<mac>: STA MAC of the originator, for admission control
+		bool topology = false;			// MAP_TOPOLOGY, the originator prints the decoded tree
+		bool stream = false;			// #S: answers travel up at once, the originator prints them as they arrive
+		uint8_t expected = 0;			// originator only, nodes in the live topology view when streaming, 0 if unknown
+		uint8_t limit = 0;				// #A<n>: the originator stops the query after n answers, 0 waits for all
+		uint8_t answers = 0;			// originator only, answers received so far
+		unsigned long first_ms = 0;		// originator only, time from start_ms to the first answer
 	
         // Constructors
         DEWDBroadcast();
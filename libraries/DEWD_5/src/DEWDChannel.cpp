@@ -0,0 +1,69 @@
+/*
+ DEWDChannel.cpp Body file defining the softAP channel planning.
+ Created by agent, 2026.
+ 
+ */
+ 
+#include <Arduino.h>
+#include <DEWDChannel.h>
+
+ICACHE_FLASH_ATTR DEWDChannelPlan::DEWDChannelPlan() {
+	memset(scores, 0, sizeof(scores));
+}
+
+/* Compute the occupancy of every channel from a scan table
+     *
+	 * param results: APs in range
+	 * param n: number of entries in results
+     */
+void ICACHE_FLASH_ATTR DEWDChannelPlan::score(const DEWDScanResult * results, int n) {
+	memset(scores, 0, sizeof(scores));
+	for (int i=0; i<n; i++) {
+		int ch = results[i].channel;
+		int strength = results[i].rssi - CHANNEL_NOISE_FLOOR;
+		if (ch < 1 || ch > CHANNEL_MAX || strength <= 0)
+			continue;
+		scores[ch] += CHANNEL_AP_COST;
+		for (int k=1; k<=CHANNEL_MAX; k++) {
+			int distance = k > ch ? k - ch : ch - k;
+			if (distance <= CHANNEL_OVERLAP)
+				scores[k] += strength * (CHANNEL_OVERLAP + 1 - distance) / (CHANNEL_OVERLAP + 1);
+		}
+	}
+}
+
+/* Choose the softAP channel
+     *
+	 * param results: APs in range
+	 * param n: number of entries in results
+	 * param parent_channel: channel of the parent, 0 for a root
+	 * return: the parent's channel, or for a root the least occupied channel, 1, 6 and 11 preferred on ties
+     */
+uint8_t ICACHE_FLASH_ATTR DEWDChannelPlan::choose(const DEWDScanResult * results, int n, uint8_t parent_channel) {
+	score(results, n);
+	if (parent_channel >= 1 && parent_channel <= CHANNEL_MAX)
+		return parent_channel;
+	
+	const uint8_t preferred[] = {1, 6, 11};
+	uint8_t best = preferred[0];
+	for (int i=1; i<3; i++) {
+		if (scores[preferred[i]] < scores[best])
+			best = preferred[i];
+	}
+	for (int ch=1; ch<=CHANNEL_MAX; ch++) {							// another channel only if strictly better
+		if (scores[ch] < scores[best])
+			best = ch;
+	}
+	return best;
+}
+
+String ICACHE_FLASH_ATTR DEWDChannelPlan::print_values(void) {
+	String res = " occupancy per channel:";
+	for (int ch=1; ch<=CHANNEL_MAX; ch++) {
+		res += ' ';
+		res += ch;
+		res += '=';
+		res += scores[ch];
+	}
+	return res;
+}
@@ -0,0 +1,33 @@
+/*
+ DEWDChannel.h Header file defining the softAP channel planning.
+ STA and softAP of an ESP8266 share one channel, so a node with a parent simply uses the parent's channel. 
+ A root picks the channel with the least occupancy in a scan: every AP adds its signal strength above the 
+ noise floor to its own channel and, reduced, to the channels it overlaps, plus a fixed cost per AP. 
+ The planner only works on scan tables, so it can be run on recorded tables off the device.
+ Created by agent, 2026.
+ 
+ */
+ 
+#ifndef DEWDChannel_h
+#define DEWDChannel_h
+
+#include <WString.h>
+#include <DEWDScan.h>
+
+	const int CHANNEL_MAX = 13;
+	const int CHANNEL_OVERLAP = 4;									// 20 MHz channels overlap with up to 4 neighbours on each side
+	const int CHANNEL_NOISE_FLOOR = -95;							// dBm, weaker APs do not count
+	const int CHANNEL_AP_COST = 10;									// fixed cost per AP on the channel itself, for airtime sharing
+
+class DEWDChannelPlan
+{
+public:
+	long scores[CHANNEL_MAX + 1];									// occupancy per channel, index 0 unused
+	
+	DEWDChannelPlan();
+	void score(const DEWDScanResult * results, int n);
+	uint8_t choose(const DEWDScanResult * results, int n, uint8_t parent_channel);
+	String print_values(void);
+};
+
+#endif
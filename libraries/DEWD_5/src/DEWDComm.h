@@ -13,6 +13,19 @@
 #include <MACAddress.h>
 #include <DEWDUdp.h>
 #include <DEWDTcp.h>
+#include <DEWDStations.h>
+#include <DEWDRoute.h>
+#include <DEWDTree.h>
+#include <DEWDRtc.h>
+#include <DEWDSleep.h>
+#include <DEWDMailbox.h>
+#include <DEWDTime.h>
+#include <DEWDMetrics.h>
+#include <DEWDConsole.h>
+#include <DEWDTopology.h>
+#include <DEWDTopoSync.h>
+#include <DEWDAdmission.h>
+#include <DEWDLink.h>
 	
 	IPAddress host;
 	DEWDUdpClass udp(UDP_PORT, MULTICAST_IP, MULTICAST_PORT);		// unreliable, sometimes port initialization fails (ports get set to 4097 and 4098)! 
@@ -23,8 +36,28 @@
 	DEWDBroadcast active_broadcasts [6];							// an array of max 5 (0 is ignored) active DEWDBroadcasts, to allow for 
 																	// varying propagation delays when multiple broadcast active at same time.
 																	// Eventually should be replaced with list, while making sure memory is managed
+	DEWDRouteTable routes;											// route cache for multi-hop MAC-addressed unicast
+	
+	DEWDTree tree;													// spanning-tree view, broadcasts are only sent along tree links
+	IPAddress tree_gateway(255,255,255,255);						// gateway the tree view was built for, none yet
+	bool tree_parent_hello_due = false;								// parent has to be told whether its link is a tree link
+	unsigned long tree_hello_ms = 0;								// millis() of the last hello round to the children
+	
+	DEWDSleepSchedule sleep_schedule;								// shared wake schedule for duty cycling
+	bool sleep_answered = false;									// an edge node has answered a broadcast in this wake window
+	String deferred_broadcasts[SLEEP_DEFERRED_MAX];					// broadcast commands waiting for the next wake window
+	int deferred_count = 0;
+	
+	DEWDMailbox mailbox;											// packets parked for sleeping or disassociated children
+	unsigned long mailbox_check_ms = 0;								// millis() of the last delivery attempt
+	
+	unsigned long link_check_ms = 0;								// millis() of the last link table update
+	unsigned long link_scanned_ms = 0;								// scan whose RSSI values went into the link table
+	
+	DEWDMeshTime mesh_time;											// offset to the root's clock, for synchronous sampling
 	
 void decode_command(String com);									// forward declaration of decode_command()
+void topology_pull();											// forward declaration, a pull arrives as MAC-addressed unicast
 
 /* Helper function for parsing strings 
      *
@@ -93,9 +126,284 @@ String mac_string (bool sta){
 }
 
 
+/* Convert a MACAddress into a String formatted the same way as mac_string()
+     *
+	 * param mac: MACAddress object to be converted
+	 * return: String object xx:xx:xx:xx:xx:xx
+     */
+String mac_to_string(MACAddress mac) {
+	String ret;
+	for (int i=0;i<5;i++) {
+		ret += String(mac[i], HEX);
+		ret += ":";
+	}
+	ret += String(mac[5], HEX);
+	return ret;
+}
+
+/* Convert a String into MACAddress object
+     *
+     * param r: String to be translated, each octet is hex and separated by a ':' (leading zeros optional)
+	 * return: MACAddress object
+     */
+MACAddress string_to_mac(String r) {
+	MACAddress mac;
+	int start_pos=0, oct_nr=0;
+	
+	for (unsigned int i=0; i<=r.length() && oct_nr<6; i++) {
+		if (i == r.length() || r[i] == ':') {
+			mac[oct_nr++] = strtol(r.substring(start_pos, i).c_str(), NULL, 16);
+			start_pos = i+1;
+		}
+	}
+	return mac;
+}
+
+/* Check whether a MAC address belongs to one of this nodes interfaces
+     *
+	 * param mac: MAC address to be checked
+	 * return: true if mac is the STA or the softAP MAC of this node
+     */
+bool is_own_mac(MACAddress mac) {
+	uint8 own[6];
+	wifi_get_macaddr(STATION_IF, own);
+	if (mac == own)
+		return true;
+	wifi_get_macaddr(SOFTAP_IF, own);
+	return mac == own;
+}
+
+/* Returns the STA MAC of this node, which identifies the node in responses and routes
+     *
+	 * return: MACAddress object
+     */
+MACAddress own_mac() {
+	uint8 own[6];
+	wifi_get_macaddr(STATION_IF, own);
+	return MACAddress(own);
+}
+
+/* Remove the first word of a String
+     *
+	 * param str: String to be split, the first word and the following space are removed from it
+	 * return: the first word, or the whole String if it contains no space
+     */
+String pop_word(String & str) {
+	String word;
+	int i = get_divider(str);
+	if (i < 0) {
+		word = str;
+		str = "";
+	}
+	else {
+		word = str.substring(0, i);
+		str = str.substring(i + 1);
+	}
+	return word;
+}
+
+/* Returns the IP address of this node on the link towards a neighbour 
+     *
+	 * param dest: IP of the neighbour
+	 * return: STA IP if dest is the host, softAP IP otherwise
+     */
+IPAddress link_ip(IPAddress dest) {
+	if (dest == WiFi.gatewayIP())
+		return WiFi.localIP();
+	return WiFi.softAPIP();
+}
+
+/* Check whether an IP address belongs to one of this nodes interfaces
+     *
+	 * param ip: IP address to be checked
+	 * return: true if ip is the STA or the softAP IP of this node
+     */
+bool is_own_ip(IPAddress ip) {
+	return ip == WiFi.localIP() || ip == WiFi.softAPIP();
+}
+
+/* Check whether a STA MAC belongs to the host of this node. WiFi.BSSID() is the softAP MAC of 
+	the host, which differs from its STA MAC in the first octets only, so the last three are compared 
+	as in DEWDTopology.
+     *
+	 * param mac: STA MAC to be checked
+	 * return: true if this node is connected and mac is the host's
+     */
+bool is_host_mac(MACAddress mac) {
+	if (WiFi.gatewayIP()[0] == 0)
+		return false;
+	uint8_t * bssid = WiFi.BSSID();
+	for (int i = 6 - TOPO_SUFFIX; i < 6; i++)
+		if (mac[i] != bssid[i])
+			return false;
+	return true;
+}
+
+/* Split the options off the payload of a broadcast. Options are words starting with '#' in front 
+	of the command: "#T" asks every node for a trace record, "#H<n>" is the number of hops from the originator.
+     *
+	 * param payload: payload of the broadcast
+	 * param b: broadcast the options are stored in
+	 * return: the command without options
+     */
+String parse_options(String payload, DEWDBroadcast & b) {
+	while (payload[0] == '#') {
+		String option = pop_word(payload);
+		if (option[1] == 'T')
+			b.trace = true;
+		else if (option[1] == 'H')
+			b.hop = option.substring(2).toInt();
+		else if (option[1] == 'A')
+			b.limit = option.substring(2).toInt();
+		else if (option[1] == 'S')
+			b.stream = true;
+		else if (option[1] == 'O')
+			b.origin = string_to_mac(option.substring(2));
+	}
+	return payload;
+}
+
+/* return: options to be forwarded with a broadcast, one hop further from the originator
+     */
+String forward_options(DEWDBroadcast & b) {
+	String options;
+	if (b.trace) {
+		options += "#T #H";
+		options += b.hop + 1;
+		options += " ";
+	}
+	if (b.limit > 0) {
+		options += "#A";
+		options += b.limit;
+		options += " ";
+	}
+	if (b.stream)
+		options += "#S ";
+	if (!(b.origin == MACAddress())) {
+		options += "#O";
+		options += mac_to_string(b.origin);
+		options += " ";
+	}
+	return options;
+}
+
+/* return: true if relays send answers on at once instead of collecting their subtree's, see #A and #S
+     */
+bool sends_at_once(DEWDBroadcast & b) {
+	return b.limit > 0 || b.stream;
+}
+
+/* In a limited query (#A<n>) only answers travel up the tree: entries whose response is not empty. 
+	"No response" is the answer to an unknown command, "0 " an empty sensor response.
+     *
+	 * param entry: response entry "<mac> <response>;"
+	 * return: true if the entry counts as an answer
+     */
+bool is_answer(String entry) {
+	if (entry[0] == '%')												// topology record
+		return true;
+	String resp = entry.substring(entry.indexOf(' ') + 1);
+	return !resp.startsWith("No response") && !resp.startsWith("0 ") && resp != ";";
+}
+
+/* return: number of answers in a response, trace records and busy entries do not count
+     */
+int count_answers(String resp) {
+	int n = 0;
+	int start = 0;
+	int end;
+	while ((end = resp.indexOf(';', start)) >= 0) {
+		if (end > start && resp[start] != '~' && resp[start] != '!')
+			n++;
+		start = end + 1;
+	}
+	return n;
+}
+
+/* return: number of busy entries in a response, relays that did not forward the broadcast, see DEWDAdmission.h
+     */
+int count_busy(String resp) {
+	int n = 0;
+	int start = 0;
+	int end;
+	while ((end = resp.indexOf(';', start)) >= 0) {
+		if (resp[start] == '!')
+			n++;
+		start = end + 1;
+	}
+	return n;
+}
+
+/* Trace record of this node for a traced broadcast, format: "~<mac> <hops> <fwd_ms> <exec_ms> <wait_ms>;". 
+	fwd is the time from receiving the broadcast until it was forwarded to all neighbours, exec the time 
+	spent executing the command and wait the time spent waiting for the neighbours' responses after that.
+	All of them are local millis() deltas.
+     *
+	 * param b: broadcast that is finished
+	 * return: the trace record
+     */
+String trace_record(DEWDBroadcast & b) {
+	unsigned long busy = b.forward_ms;
+	if (is_own_ip(b.src_ip))										// the originator executes after forwarding
+		busy += b.exec_ms;
+	unsigned long total = millis() - b.start_ms;
+	
+	String record = "~";
+	record += mac_string(true);
+	record += " ";
+	record += b.hop;
+	record += " ";
+	record += b.forward_ms;
+	record += " ";
+	record += b.exec_ms;
+	record += " ";
+	record += total > busy ? total - busy : 0;
+	record += ";";
+	return record;
+}
+
+/* Print the trace records of a response as a tree, indented by hops from the originator
+     *
+	 * param resp: response of a traced broadcast
+     */
+void print_trace(String resp) {
+	console.println("Trace (node: receive-to-forward, execute, wait for responses):");
+	int end;
+	while ((end = resp.indexOf(';')) >= 0) {
+		String record = resp.substring(0, end);
+		resp = resp.substring(end + 1);
+		if (record[0] != '~')
+			continue;
+		record = record.substring(1);
+		String mac = pop_word(record);
+		int hops = pop_word(record).toInt();
+		
+		for (int i=0; i<hops; i++)
+			console.print("  ");
+		console.print(mac);
+		console.print(": fwd=");
+		console.print(pop_word(record));
+		console.print(" exec=");
+		console.print(pop_word(record));
+		console.print(" wait=");
+		console.print(record);
+		console.println(" ms");
+	}
+}
+
+/* Free a slot of the active_broadcasts array, the last broadcast takes its place
+     *
+	 * param nr: index of the object in active_broadcasts that is to be deleted
+     */
+void free_active_broadcast(int nr) {
+	if (nr != active_broadcasts_index)										// if not the last broadcast...
+		active_broadcasts[nr] = active_broadcasts[active_broadcasts_index];	// overwrite with last broadcast
+	active_broadcasts_index--;		
+}
+
 /* Once a broadcast is complete it needs to be deleted and a response sent to broadcast originator. 
-	This function rearranges the active_broadcasts array so that the removed DEWDBroadcast 
-	object does not necessarily have to be last in active_broadcasts array
+	On the originator itself the response is printed to serial. This function rearranges the active_broadcasts 
+	array so that the removed DEWDBroadcast object does not necessarily have to be last in active_broadcasts array
      *
 	 * param nr: index of the object in active_broadcasts that is to be deleted
 	 * 
@@ -103,29 +411,61 @@ String mac_string (bool sta){
 void remove_active_broadcasts(int nr) {
 	if (nr > 5) {
 		if (DEBUG)
-			Serial.println("No such broadcast nr");
+			console.println("No such broadcast nr");
+		return;
 	}
-	else {
-		if (nr != active_broadcasts_index) {									// if not the last broadcast...						
-			active_broadcasts[nr] = active_broadcasts[active_broadcasts_index];	// overwrite with last broadcast
+	DEWDBroadcast & b = active_broadcasts[nr];
+	if (DEBUG) {
+		console.println("Removing broadcast: ");		
+		console.println(b.print_values());
+	}
+	if (b.trace)															// own trace record in front of the children's, pre-order
+		b.resp_message = trace_record(b) + b.resp_message;
+
+	if (is_own_ip(b.src_ip)) {												// this node originated the broadcast, result goes to serial
+		sleep_schedule.query_done(millis() - b.start_ms);
+		console.line(FRAME_RESULT, tcp.make_packet('R', WiFi.softAPIP(), b.stream ? "" : b.resp_message, b.id));	// streamed answers are out already
+		if (b.trace)
+			print_trace(b.resp_message);
+		int busy = count_busy(b.resp_message);
+		if (busy > 0) {
+			console.print("BUSY ");
+			console.print(busy);
+			console.println(" subtrees over the rate limit");
 		}
-		if (DEBUG) {
-			Serial.println("Removing broadcast: ");		
-			Serial.println(active_broadcasts[nr].print_values());
+		if (b.topology) {
+			topology.load(b.resp_message);
+			console.println(topology.print_values());
 		}
-
-		//String tcp_packet = tcp.make_packet('R', INADDR_NONE, active_broadcasts[nr].resp_message, active_broadcasts[nr].id);			// CHANGE IP BEFORE RELEASE!
-		String tcp_packet = tcp.make_packet('R', WiFi.softAPIP(), active_broadcasts[nr].resp_message, active_broadcasts[nr].id);
-		if (!tcp.send_by_ip(tcp_packet, active_broadcasts[nr].src_ip)) {											// send response to broadcast source
-			if (DEBUG)
-				Serial.println("Couldn't reach source IP for broadcast response");
+		if (sends_at_once(b)) {
+			console.print("Answers ");
+			console.print(b.answers);
+			console.print("/");
+			if (b.limit > 0)
+				console.print(b.limit);
+			else if (b.expected > 0)
+				console.print(b.expected);
+			else
+				console.print("?");
+			console.print(", first after ");
+			console.print(b.first_ms);
+			console.print(" ms, done after ");
+			console.print(millis() - b.start_ms);
+			console.println(b.limit > 0 && b.answers >= b.limit ? " ms, rest cancelled" : " ms");
 		}
-		else {
+	}
+	else {
+		//String tcp_packet = tcp.make_packet('R', INADDR_NONE, b.resp_message, b.id);			// CHANGE IP BEFORE RELEASE!
+		String tcp_packet = tcp.make_packet('R', WiFi.softAPIP(), b.resp_message, b.id);
+		if (!tcp.send_by_ip(tcp_packet, b.src_ip)) {											// send response to broadcast source
 			if (DEBUG)
-				Serial.println("Response sent");
-			active_broadcasts_index--;		
+				console.println("Couldn't reach source IP for broadcast response");
 		}
+		else if (DEBUG)
+			console.println("Response sent");
 	}
+	
+	free_active_broadcast(nr);
 }
 
 /* Return the payload part of a message
@@ -157,6 +497,85 @@ String get_ip_string(String str) {
 	}
 }
 
+/* Forward a command to the sensor and wait for its response
+     *
+	 * param command: sensor command
+	 * return: length and response of the sensor, i.e. "17 data from sensor|"
+     */
+String read_sensor(String command) {
+	String resp;
+	char buff[1024];											// response buffer, may be increased if needed
+	
+	if (console.framed())										// serial belongs to the host link, not a sensor
+		return "0 no sensor on a framed link";
+	unsigned long start = micros();
+	command += '\r';											// guarantee correct sensor input termination 
+	Serial.print(command);										// print command to serial (to sensor)
+	Serial.flush();												// force CPU to wait for serial to transmit
+
+	unsigned long stall = stalls.enter();
+	Serial.readBytes(buff, 1024);								// fill buffer, waits for the serial timeout
+	stalls.leave("sensor", stall);
+	resp = strlen(buff);										
+	resp += ' ';
+	resp += String(buff);
+	resp.replace('\r', '|');
+	metrics.record(HIST_SENSOR, micros() - start);
+	return resp;
+}
+
+/* Set up the own sample of a SENSOR_AT broadcast, format: "SENSOR_AT <mesh_ms> <sensor command>". 
+	The sample is taken in sample_maintenance() and counted as one more response the broadcast waits for.
+     *
+	 * param b: broadcast the sample belongs to
+	 * param command: payload of the broadcast
+	 * return: true if command is a SENSOR_AT command
+     */
+bool schedule_sample(DEWDBroadcast & b, String command) {
+	if (strcmp(command.substring(0, 9).c_str(), "SENSOR_AT"))
+		return false;
+	String args = command.substring(10);
+	b.sample_at = strtoul(pop_word(args).c_str(), NULL, 10);
+	b.sample_command = args;
+	b.sample_pending = true;
+	b.resp_index++;
+	return true;
+}
+
+/* Fill in the topology record of this node, see DEWDTopology.h
+     *
+	 * param r: record to be filled in
+	 * param mac: MAC the node is identified by
+     */
+void own_topology(DEWDTopologyRecord & r, const uint8_t * mac) {
+	memcpy(r.mac, mac, 6);
+	memset(r.parent, 0, TOPO_SUFFIX);
+	if (WiFi.status() == WL_CONNECTED)
+		memcpy(r.parent, WiFi.BSSID() + 6 - TOPO_SUFFIX, TOPO_SUFFIX);
+	r.depth = tree.depth;
+	r.rssi = WiFi.RSSI();
+	r.child_count = stations.count() < TOPO_MAX_CHILDREN ? stations.count() : TOPO_MAX_CHILDREN;
+	for (int i=0; i<r.child_count; i++)
+		for (int j=0; j<TOPO_SUFFIX; j++)
+			r.children[i][j] = stations.get(i)->mac[6 - TOPO_SUFFIX + j];
+}
+
+/* Topology record of this node for MAP_TOPOLOGY
+     *
+	 * param mac: MAC the node answers with
+	 * return: response entry "%<record>;"
+     */
+String topology_entry(const uint8_t * mac) {
+	DEWDTopologyRecord r;
+	own_topology(r, mac);
+	tree_hello_ms = millis() - HELLO_FREQ;							// refresh the tree view at the next maintenance
+	
+	String entry = "%";
+	entry += DEWDTopology::encode(r);
+	entry += ";";
+	return entry;
+}
+
 /* Execute the command depending on the broadcast-mode flag in the payload part of the broadcast. 
 	A CR character is added to all strings as a precaution against incorrect input. 
      *
@@ -165,7 +584,6 @@ String get_ip_string(String str) {
      */
 String execute_broadcast(String command) {
 	String resp = "No response";
-	char buff[1024];					// response buffer, may be increased if needed
 	
 	// map the network by returning the current nodes host and clients MAC addresses
 	if (!strcmp(command.substring(0, 11).c_str(), "MAP_NETWORK")) {
@@ -179,26 +597,26 @@ String execute_broadcast(String command) {
 		}
 		resp += String(*mac_gate, HEX);
 		// ------------------------------
+		resp += "| D: ";
+		resp += tree.depth;											// depth in the spanning tree
+		tree_hello_ms = millis() - HELLO_FREQ;						// refresh the tree view at the next maintenance
 		resp += "| C: ";
 		// ---- CLIENT MAC ADDRESSES ----
-		int count = 0;
-		struct station_info * station = wifi_softap_get_station_info();
-		struct station_info * next_station;	  
-		if (station == NULL)
+		DEWDStation children[MAX_STATIONS];
+		int n = stations.copy(children);
+		if (n == 0)
 			resp += "none|";
 		  
-		while(station)
+		for (int i=0; i<n; i++)
 		{ 		
-			for (int i=0;i<5;i++) {
-				resp += String(station->bssid[i], HEX);
+			DEWDStation * station = &children[i];
+			for (int j=0;j<5;j++) {
+				resp += String(station->mac[j], HEX);
 				resp += ':';
 			}
-			resp += String(station->bssid[5], HEX);		
-			next_station = STAILQ_NEXT(station, next);
-			station = next_station;
+			resp += String(station->mac[5], HEX);		
 			resp += '|';
 		}
-		wifi_softap_free_station_info();
 		// --------------------------------
 		return resp;
 	}
@@ -206,26 +624,57 @@ String execute_broadcast(String command) {
 	else if (!strcmp(command.substring(0, 10).c_str(), "DEEP_SLEEP")) {
 		long sleep_time = command.substring(11).toInt();	
 		sleep_time = sleep_time * 1000000;							// multiply with 10^6 to get microseconds
+		rtc.save();													// keep link state and handled broadcast ids for fast rejoin
 		system_deep_sleep_set_option(1);							// calibrate RF when waking up
 		system_deep_sleep(sleep_time);
 	}
 	// shortcut for network-wide restart. No resp message is needed
 	else if (!strcmp(command.substring(0, 10).c_str(), "RESTART")) {
+		rtc.save();
 		system_restart();
 	}
+	// agree on a shared wake schedule, format: "DUTY_CYCLE <period_s> <awake_s> [<mesh_anchor_ms>]". A period of 0 turns 
+	// duty cycling off. start_broadcast() adds the mesh time the first window starts at, if the root's clock is known
+	else if (!strcmp(command.substring(0, 10).c_str(), "DUTY_CYCLE")) {
+		String args = command.substring(11);
+		unsigned long period = pop_word(args).toInt();
+		unsigned long awake = pop_word(args).toInt();
+		sleep_schedule.set(period * 1000, awake * 1000, millis());	// window starts on reception, hop delays are covered by SLEEP_WAKE_LEAD
+		sleep_answered = false;
+		if (isdigit(args[0])) {										// follow the mesh clock from the next sync round on
+			sleep_schedule.set_mesh_anchor(strtoul(args.c_str(), NULL, 10));
+			if (mesh_time.synced())
+				sleep_schedule.resync(mesh_time.now(), millis());
+		}
+		resp = "duty cycle ";
+		resp += awake * 100 / (period ? period : 1);
+		resp += "%";
+		return resp;
+	}
+	// counters and latency histograms of this node, see DEWDMetrics::encode() for the format
+	else if (!strcmp(command.substring(0, 7).c_str(), "METRICS")) {
+		return metrics.encode();
+	}
+	// ETX and RSSI of the links to the neighbours, see DEWDLinkTable::encode() for the format
+	else if (!strcmp(command.substring(0, 5).c_str(), "LINKS")) {
+		return links.encode();
+	}
+	// admission control of every node, format: "ADMIT [<per_minute> [<burst> [<in_flight>]]]". A rate of 0 turns 
+	// rate limiting off, missing fields are left as they are
+	else if (!strcmp(command.substring(0, 5).c_str(), "ADMIT")) {
+		String args = command.substring(6);
+		args.trim();
+		if (!admission.configure(args))
+			return "ADMIT ignored, malformed: " + args;
+		return admission.print_values();
+	}
+	// blocking sections and slow main-loop iterations of this node, see DEWDStallProfiler::encode() for the format
+	else if (!strcmp(command.substring(0, 6).c_str(), "STALLS")) {
+		return stalls.encode();
+	}
 	// forward command to sensor and wait for response
 	else if (!strcmp(command.substring(0, 6).c_str(), "SENSOR")) {
-		command = command.substring(7);
-		command += '\r';											// guarantee correct sensor input termination 
-		Serial.print(command);										// print command to serial (to sensor)
-		Serial.flush();												// force CPU to wait for serial to transmit
-
-		Serial.readBytes(buff, 1024);								// fill buffer
-		resp = strlen(buff);										
-		resp += ' ';
-		resp += String(buff);
-		resp.replace('\r', '|');
-		return resp;												// i.e. resp = 17 data from sensor|
+		return read_sensor(command.substring(7));
 	}
 	// execute an ESP8266 command. See API (or decode_command()) for exact list and format of command
 	else {
@@ -235,212 +684,1161 @@ String execute_broadcast(String command) {
 	}					
 }
 
-/* Create a broadcast to be sent to all neighbours (AP and STAs).
+/* Create a broadcast to be sent to all neighbours (AP and STAs).
+     *
+	 * param payload: String to be broadcast
+	 * param b: broadcast object containing the necessary meta-data
+	 * 
+     */
+void broadcast(String payload, DEWDBroadcast b) {
+	if (DEBUG)
+		console.println("Composing broadcast messages...");
+	
+	// This part forwards broadcast to host
+	if (b.src_ip != WiFi.gatewayIP() && WiFi.gatewayIP()[0] != 0 && tree.use_parent()) {	// host it not source of broadcast and is on a tree link
+		if (DEBUG)
+			console.println("Sending to host...");
+		
+		String tcp_packet = tcp.make_packet('B', WiFi.localIP(), payload, b.id);		// make tcp broadcast-packet with STA-IP as source
+		if (!tcp.send_by_ip(tcp_packet, WiFi.gatewayIP())) {																
+			if (DEBUG)
+				console.println("failed");
+		}
+		else {
+			active_broadcasts[active_broadcasts_index].resp_index++;					// increase number of responses expected
+			tree.broadcasts_sent++;
+			rtc.note_forward();
+			if (DEBUG)
+					console.println("sent");
+		}			
+	}
+	
+	if (DEBUG) {
+		console.print("active_broadcasts_index=");
+		console.println(active_broadcasts_index);
+	}
+	
+	// This part forwards broadcast to clients
+	String tcp_packet = tcp.make_packet('B', WiFi.softAPIP(), payload, b.id);					// make tcp broadcast-packet with SoftAP-IP as source
+	
+	if (stations.count() == 0) {																// if no clients...
+		active_broadcasts[active_broadcasts_index].forward_ms = millis() - active_broadcasts[active_broadcasts_index].start_ms;
+		if (active_broadcasts[active_broadcasts_index].resp_index == 0)							// and not awaiting any responses...
+			remove_active_broadcasts(active_broadcasts_index);									// finalize broadcast by sending a response and then freeing active broadcasts slot  
+		return;
+	}
+	
+	DEWDStation children[MAX_STATIONS];															// a send yields, the table may change meanwhile
+	int n = stations.copy(children);
+	for (int i=0; i<n; i++)																		// for each station connected to AP ...
+	{ 
+		DEWDStation * station = &children[i];
+		IPAddress client_ip = station->ip;														// address actually leased by DHCP
+		
+		if (DEBUG) {
+			console.print("Client ");
+			console.print(i + 1);
+			console.print(": ");
+			console.print(client_ip);
+			console.println(" - sending...");
+		}
+
+		if (client_ip[0] == 0) {																// associated, but DHCP lease not known yet
+			if (DEBUG)
+				console.println("no IP leased yet - nothing sent");
+		}
+		else if (!tree.child_in_tree(station->mac)) {											// client reaches the rest of the mesh through another link
+			if (DEBUG)
+				console.println("not a tree link - nothing sent");
+		}
+		else if (b.src_ip != client_ip) {														// check that the client is not the source of the broadcast
+			if (!tcp.send_by_ip(tcp_packet, client_ip)) {												// not parked: a late DEEP_SLEEP or RESTART would 
+				if (DEBUG)																		// hit a child that has moved on
+					console.println("failed");
+			}
+			else {
+				active_broadcasts[active_broadcasts_index].resp_index++;						// expect a response from this client
+				tree.broadcasts_sent++;
+				rtc.note_forward();
+				if (DEBUG)
+					console.println("sent");
+			}		
+		}
+		else {																					// nothing sent to this client and no response is awaited
+			if (DEBUG)
+				console.println("client is the source - nothing sent");
+		}
+	}  
+	active_broadcasts[active_broadcasts_index].forward_ms = millis() - active_broadcasts[active_broadcasts_index].start_ms;
+	if (active_broadcasts[active_broadcasts_index].resp_index == 0){							// this is needed if the only client connected to AP 
+		if (DEBUG)																				// was the source of the broadcast
+			console.println("No more broadcasts");
+		remove_active_broadcasts(active_broadcasts_index);										// finalize broadcast by sending a responces and then freeing active broadcasts slot
+	}
+}
+
+/* Response entry of this node to a broadcast: "<mac> <response>;", or a topology record for MAP_TOPOLOGY
+     *
+	 * param sta: answer with the station MAC, otherwise with the softAP MAC
+	 * param command: broadcast command
+	 * return: the entry to be added to the broadcast response
+     */
+String own_response(bool sta, String command) {
+	if (!strcmp(command.substring(0, 12).c_str(), "MAP_TOPOLOGY")) {
+		uint8 mac[6];
+		wifi_get_macaddr(sta ? STATION_IF : SOFTAP_IF, mac);
+		return topology_entry(mac);
+	}
+	return mac_string(sta) + " " + execute_broadcast(command) + ";";
+}
+
+/* Tell everyone a broadcast was sent to that it is cancelled, they free its slot and tell their neighbours
+     *
+	 * param b: the broadcast
+     */
+void send_cancel(DEWDBroadcast & b) {
+	String tcp_packet = tcp.make_packet('X', INADDR_NONE, "", b.id);
+	if (b.src_ip != WiFi.gatewayIP() && WiFi.gatewayIP()[0] != 0 && tree.use_parent())
+		tcp.send_by_ip(tcp_packet, WiFi.gatewayIP());
+	DEWDStation children[MAX_STATIONS];								// a send yields, the table may change meanwhile
+	int n = stations.copy(children);
+	for (int i=0; i<n; i++) {
+		DEWDStation * station = &children[i];
+		if (station->ip[0] != 0 && station->ip != b.src_ip && tree.child_in_tree(station->mac))
+			tcp.send_by_ip(tcp_packet, station->ip);
+	}
+}
+
+/* Add a response to an active broadcast. In a limited query a relay sends answers on at once, 
+	the originator stops the query once it has enough of them.
+     *
+	 * param nr: index of the broadcast in active_broadcasts
+	 * param resp: response entries
+	 * param final: true if this completes one of the responses counted in resp_index, false for a partial one
+     */
+void add_response(int nr, String resp, bool final) {
+	DEWDBroadcast & b = active_broadcasts[nr];
+	if (sends_at_once(b) && !is_own_ip(b.src_ip)) {
+		if (resp.length() > 0)												// answers and trace records
+			tcp.send_by_ip(tcp.make_packet('R', WiFi.softAPIP(), "+" + resp, b.id), b.src_ip);
+	}
+	else {
+		b.resp_message += resp;
+		if (sends_at_once(b)) {
+			if (b.answers == 0 && count_answers(resp) > 0)
+				b.first_ms = millis() - b.start_ms;
+			b.answers += count_answers(resp);
+		}
+		if (b.stream && resp.length() > 0) {								// "S <id> <answers>/<expected> <entries>"
+			String line = "S ";
+			line += b.id;
+			line += " ";
+			line += b.answers;
+			line += "/";
+			if (b.expected > 0)
+				line += b.expected;
+			else
+				line += "?";
+			line += " ";
+			line += resp;
+			console.line(FRAME_RESULT, line);
+		}
+		if (b.limit > 0 && b.answers >= b.limit) {							// satisfied, the rest of the mesh can stop
+			send_cancel(b);
+			remove_active_broadcasts(nr);
+			return;
+		}
+	}
+	if (final && b.resp_index == 0)
+		remove_active_broadcasts(nr);
+}
+
+/* Cancel an active broadcast, format: "X <id>". The slot is freed without a response 
+	and the cancel goes on to the neighbours the broadcast was sent to.
+     *
+	 * param s: cancel message
+     */
+void parse_cancel(String s) {
+	int id = atoi(s.substring(1, 5).c_str());
+	for (int i=1; i<=active_broadcasts_index; i++) {
+		if (active_broadcasts[i].id == id) {
+			send_cancel(active_broadcasts[i]);
+			free_active_broadcast(i);
+			return;
+		}
+	}
+}
+
+/* This function does one of 3 things, sequentially going from 1-3:
+		1) broadcast is identified as a duplicate and a wrong-response message is sent (flag 'W')
+		2) current node is an edge node so a response message is sent (flag 'R')
+		3) current node is connected to at least one other ESP that is not the source of broadcast - a new broadcast object is created 
+     *
+	 * param s: Broadcast string to be parsed
+	 *
+     */
+void parse_broadcast(String s) {
+	
+	// s might look something like "B 123 192.168.4.1 texttextext"
+	int s_id = atoi(s.substring(1, 5).c_str());
+	IPAddress s_src = string_to_ip(get_ip_string(s.substring(6)));
+	if (DEBUG) {
+		console.print("ID is: ");
+		console.print(s_id);
+		console.print(", SRC_IP is: ");
+		console.println(s_src);
+	}
+	
+	if (active_broadcasts_index > 5) {
+		if (DEBUG)
+			console.println("Too many active broadcasts");
+		metrics.drop(s[0]);
+		active_broadcasts_index = 1;										// round-robin
+	}
+	
+	if (active_broadcasts_index != 0) {										// check if duplicate broadcast
+		for (int i=1; i<=active_broadcasts_index; i++) {	
+			if (DEBUG) {
+				console.print("active_broadcasts[");
+				console.print(i);
+				console.print("].id = ");
+				console.println(active_broadcasts[i].id);
+			}
+			if (active_broadcasts[i].id == s_id) {
+				if (DEBUG)
+					console.println("Duplicate broadcast!");
+				metrics.drop(s[0]);
+				String tcp_packet = tcp.make_packet('W', INADDR_NONE, "", s_id);
+				// send "W <id>" to s_src IP
+				if (!tcp.send_by_ip(tcp_packet, s_src)) {										
+					if (DEBUG)
+						console.println("W-message not sent");
+				}
+				else
+					tree.wrong_responses_sent++;
+				return;
+			}
+		}
+	}	
+	DEWDBroadcast br(s_src, s_id);
+	br.start_ms = millis();
+	String command = parse_options(get_payload_string(s.substring(6)), br);
+	
+	if (rtc.seen_before_wake(s_id, br.origin)) {							// handled before the last sleep/reset
+		if (DEBUG)
+			console.println("Broadcast handled before wake-up!");
+		metrics.drop(s[0]);
+		if (tcp.send_by_ip(tcp.make_packet('W', INADDR_NONE, "", s_id), s_src))
+			tree.wrong_responses_sent++;
+		return;
+	}
+	rtc.note_broadcast(s_id, br.origin);
+	
+	if (!admission.admit(br.origin, millis())) {							// originator over its rate, the subtree is not bothered
+		if (DEBUG)
+			console.println("Broadcast over rate - busy");
+		metrics.drop(s[0]);
+		tcp.send_by_ip(tcp.make_packet('R', INADDR_NONE, "!" + mac_string(true) + " busy;", s_id), s_src);
+		return;
+	}
+	
+	// if this is an edge node...
+	if (stations.count() == 0) {								
+		if (DEBUG) 
+			console.println("Edge node");
+		
+		if (schedule_sample(br, command)) {									// answered once the sample is taken
+			active_broadcasts[++active_broadcasts_index] = br;
+			return;
+		}
+		String payload = own_response(true, command);
+		if (br.limit > 0 && !is_answer(payload))							// limited query, only answers count
+			payload = "";
+		if (br.trace) {
+			br.exec_ms = millis() - br.start_ms;
+			payload = trace_record(br) + payload;
+		}
+		String tcp_packet = tcp.make_packet('R', INADDR_NONE, payload, s_id);
+		
+		if (!tcp.send_by_ip(tcp_packet, s_src)) {							// send response to broadcast source
+			if (DEBUG)
+				console.println("Couldn't reach source IP for broadcast response");
+		}
+		else {
+			if (DEBUG)
+				console.println("Response sent");
+			sleep_answered = true;											// edge node may go back to sleep
+		}
+		return;
+	}		
+	// ...otherwise create broadcast object
+	if (DEBUG)
+		console.println("Create new DEWDBroadcast object...");
+
+	active_broadcasts[++active_broadcasts_index] = br;
+	
+	if (!schedule_sample(active_broadcasts[active_broadcasts_index], command)) {
+		String own = own_response(WiFi.localIP()[0] != 0, command);
+		if (!sends_at_once(br))
+			active_broadcasts[active_broadcasts_index].resp_message += own;
+		else if (br.limit == 0 || is_answer(own))							// the answer goes up at once
+			tcp.send_by_ip(tcp.make_packet('R', WiFi.softAPIP(), "+" + own, br.id), br.src_ip);
+		active_broadcasts[active_broadcasts_index].exec_ms = millis() - br.start_ms;
+	}
+	
+	// broadcast message, must be placed here, otherwise br is removed in broadcast() before response is composed
+	if (DEBUG) 
+		console.println("Here calling broadcast()...");
+	broadcast(forward_options(br) + command, br);
+}
+
+/* Originate a broadcast from this node, see 'tcp -b'. Options, see parse_options(), may precede the command.
+     *
+	 * param command_string: command to be executed by every node
+     */
+void start_broadcast(String command_string) {
+	DEWDBroadcast br(random(100, 256));
+	br.start_ms = millis();
+	command_string = parse_options(command_string, br);
+	
+	if (!strcmp(command_string.substring(0, 11).c_str(), "SENSOR_AT +")) {		// relative time in s, all nodes get the same mesh time
+		String args = command_string.substring(11);
+		unsigned long at = mesh_time.now() + pop_word(args).toInt() * 1000;
+		command_string = "SENSOR_AT ";
+		command_string += at;
+		command_string += " ";
+		command_string += args;
+	}
+	if (!strcmp(command_string.substring(0, 11).c_str(), "DUTY_CYCLE ") && mesh_time.synced()) {	// first window starts now, in mesh time
+		String args = command_string.substring(11);
+		unsigned long period = pop_word(args).toInt();
+		unsigned long awake = pop_word(args).toInt();
+		if (args.length() == 0) {
+			command_string = "DUTY_CYCLE ";
+			command_string += period;
+			command_string += " ";
+			command_string += awake;
+			command_string += " ";
+			command_string += mesh_time.now();
+		}
+	}
+	
+	if (WiFi.localIP()[0] != 0)
+		br.src_ip = WiFi.localIP();
+	else
+		br.src_ip= WiFi.softAPIP();
+	
+	int own_active = 0;
+	for (int i=1; i<=active_broadcasts_index; i++)
+		if (is_own_ip(active_broadcasts[i].src_ip))
+			own_active++;
+	if (!admission.may_start(own_active)) {								// "BUSY <reason>", the collector backs off
+		console.line(FRAME_RESULT, "BUSY in_flight " + String(own_active) + "/" + String(admission.in_flight));
+		return;
+	}
+	br.origin = own_mac();
+	if (!admission.admit(br.origin, millis())) {
+		console.line(FRAME_RESULT, "BUSY rate " + String(admission.rate) + "/min");
+		return;
+	}
+	
+	br.topology = !strcmp(command_string.substring(0, 12).c_str(), "MAP_TOPOLOGY");
+	br.expected = topo_sync.view.count;
+	active_broadcasts[++active_broadcasts_index] = br;
+	rtc.note_broadcast(br.id, br.origin);
+	sleep_schedule.query_started();
+	console.line(FRAME_STARTED, tcp.make_packet('B', br.src_ip, command_string, br.id));	// the id the response will be printed with
+	
+	if (schedule_sample(active_broadcasts[active_broadcasts_index], command_string)) {
+		broadcast(forward_options(br) + command_string, br);
+		return;
+	}
+	active_broadcasts[active_broadcasts_index].resp_index++;						// own response, keeps broadcast() from finishing it
+	broadcast(forward_options(br) + command_string, br);
+	
+	DEWDBroadcast & b = active_broadcasts[active_broadcasts_index];
+	unsigned long exec_start = millis();
+	String own = own_response(true, command_string);
+	b.exec_ms = millis() - exec_start;
+	b.resp_index--;
+	if (b.limit == 0 || is_answer(own))
+		add_response(active_broadcasts_index, own, true);
+	else if (b.resp_index == 0)
+		remove_active_broadcasts(active_broadcasts_index);
+}
+
+/* Restore the duty-cycle schedule after waking up from a scheduled sleep. Call once at boot, after rtc.load().
+     *
+     */
+void restore_duty_cycle() {
+	if (rtc.restored && rtc.state.sleep_scheduled && rtc.state.sleep_period_ms != 0) {
+		// woke SLEEP_WAKE_LEAD ms before a window, i.e. the last window started a period earlier. The sleep timer 
+		// drifts by a few percent, the first mesh clock sync after the rejoin corrects the estimate
+		sleep_schedule.set(rtc.state.sleep_period_ms, rtc.state.sleep_awake_ms, millis() + SLEEP_WAKE_LEAD - rtc.state.sleep_period_ms);
+		if (rtc.state.sleep_anchored)
+			sleep_schedule.set_mesh_anchor(rtc.state.sleep_anchor_ms);
+	}
+	rtc.state.sleep_scheduled = 0;
+}
+
+/* Start deferred broadcasts once the wake window opens, and put the node to sleep when the 
+	schedule allows it. Roots are attached to the collector and stay awake. Called once per main-loop iteration.
+     *
+     */
+void duty_cycle() {
+	if (!sleep_schedule.active())
+		return;
+	
+	if (!sleep_schedule.in_window(millis()))
+		sleep_answered = false;										// the next window starts unanswered
+	else if (deferred_count > 0) {									// one per iteration, in the order they came in
+		String command_string = deferred_broadcasts[0];
+		for (int i=1; i<deferred_count; i++)
+			deferred_broadcasts[i - 1] = deferred_broadcasts[i];
+		deferred_broadcasts[--deferred_count] = "";
+		start_broadcast(command_string);
+	}
+	if (WiFi.gatewayIP()[0] == 0)
+		return;
+	
+	unsigned long t = sleep_schedule.sleep_time(millis(), stations.count() > 0, active_broadcasts_index > 0, sleep_answered);
+	if (t == 0)
+		return;
+	
+	if (DEBUG) {
+		console.print("Duty cycle: sleeping for ");
+		console.print(t);
+		console.println(" ms");
+	}
+	rtc.state.sleep_period_ms = sleep_schedule.period_ms;
+	rtc.state.sleep_awake_ms = sleep_schedule.awake_ms;
+	rtc.state.sleep_anchored = sleep_schedule.mesh_anchored;
+	rtc.state.sleep_anchor_ms = sleep_schedule.mesh_anchor_ms;
+	rtc.state.sleep_scheduled = 1;
+	rtc.save();
+	system_deep_sleep_set_option(1);								// calibrate RF when waking up
+	system_deep_sleep((uint64)t * 1000);
+}
+
+/* return: true if a packet for dest may wait in the mailbox: it is unicast data and dest is a 
+	tree child of this node that was associated recently
+     */
+bool parks_for(char flag, MACAddress dest) {
+	return flag == 'D' && mailbox.is_child(dest) && tree.child_in_tree(dest);
+}
+
+/* Hand a MAC-addressed packet to the next hop towards its destination: the host or a client 
+	if dest is a direct neighbour, otherwise the next hop of a cached route. Unicast data for a tree 
+	child that is asleep or away is parked in the mailbox, route replies are not.
+     *
+	 * param flag: 'D' for unicast data, 'P' for route replies
+	 * param dest: STA MAC of the destination
+	 * param payload: payload of the packet
+	 * param id: packet id
+	 * return: true if the next hop accepted the packet, false if there is no route or it is broken
+     */
+bool forward_by_mac(char flag, MACAddress dest, String payload, int id) {
+	IPAddress next_hop;
+	DEWDStation * station = stations.find(dest);
+	DEWDRoute * route;
+	
+	if (is_host_mac(dest))
+		next_hop = WiFi.gatewayIP();
+	else if (station != NULL && station->ip[0] != 0)
+		next_hop = station->ip;
+	else if ((route = routes.find(dest)) != NULL)
+		next_hop = route->next_hop;
+	else if (parks_for(flag, dest))									// child is asleep or away, park the packet
+		return mailbox.put(dest, tcp.make_packet(flag, WiFi.softAPIP(), payload, id));
+	else
+		return false;
+	
+	String tcp_packet = tcp.make_packet(flag, link_ip(next_hop), payload, id);
+	if (tcp.send_by_ip(tcp_packet, next_hop)) {
+		rtc.note_forward();
+		return true;
+	}
+	if (station != NULL && next_hop == station->ip && parks_for(flag, dest))	// child did not answer, deliver when it is back
+		return mailbox.put(dest, tcp_packet);
+	
+	routes.remove_next_hop(next_hop);								// link is broken, rediscover routes through it
+	return false;
+}
+
+/* Flood a route request to all neighbours except the one it was received from
+     *
+	 * param payload: "<orig_mac> <orig_seq> <dest_mac> <hops> <cost>"
+	 * param id: request id
+	 * param from: IP of the neighbour the request came from, 0.0.0.0 if this node originates it
+     */
+void flood_route_request(String payload, int id, IPAddress from) {
+	if (from != WiFi.gatewayIP() && WiFi.gatewayIP()[0] != 0) {
+		if (tcp.send_by_ip(tcp.make_packet('Q', WiFi.localIP(), payload, id), WiFi.gatewayIP()))
+			routes.rreq_sent++;
+	}
+	
+	String tcp_packet = tcp.make_packet('Q', WiFi.softAPIP(), payload, id);
+	DEWDStation children[MAX_STATIONS];								// a send yields, the table may change meanwhile
+	int n = stations.copy(children);
+	for (int i=0; i<n; i++) {
+		DEWDStation * station = &children[i];
+		if (station->ip[0] != 0 && station->ip != from) {
+			if (tcp.send_by_ip(tcp_packet, station->ip))
+				routes.rreq_sent++;
+		}
+	}
+}
+
+/* Start route discovery for a destination
+     *
+	 * param dest: STA MAC of the destination
+     */
+void discover_route(MACAddress dest) {
+	int id = random(100, 256);
+	
+	routes.own_seq++;
+	routes.seen_request(own_mac(), id);								// ignore own request when it is echoed back
+	
+	String payload = mac_to_string(own_mac());
+	payload += " ";
+	payload += routes.own_seq;
+	payload += " ";
+	payload += mac_to_string(dest);
+	payload += " 0 0";
+	
+	if (DEBUG) {
+		console.print("Searching route to ");
+		console.println(mac_to_string(dest));
+	}
+	flood_route_request(payload, id, IPAddress(0, 0, 0, 0));
+}
+
+/* Send a message to a node addressed by its MAC. If no route is known the message is parked 
+	and route discovery is started; route_maintenance() sends it once a route reply arrives.
+     *
+	 * param dest: STA MAC of the destination
+	 * param text: message to be printed to serial at the destination
+	 * return: false if the message had to be dropped
+     */
+bool send_to_mac(MACAddress dest, String text) {
+	int id = random(100, 256);
+	
+	String payload = mac_to_string(dest);
+	payload += " ";
+	payload += mac_string(true);
+	payload += " ";
+	payload += ROUTE_TTL;
+	payload += " ";
+	payload += text;
+	
+	if (forward_by_mac('D', dest, payload, id)) {
+		routes.data_sent++;
+		return true;
+	}
+	if (!routes.queue(dest, payload, id)) {
+		routes.data_dropped++;
+		return false;
+	}
+	discover_route(dest);
+	return true;
+}
+
+/* Send parked unicasts whose route has been discovered, and retry or give up on the rest.
+	Called once per main-loop iteration.
+     *
+     */
+void route_maintenance() {
+	for (int i=0; i<MAX_PENDING; i++) {
+		DEWDPendingUnicast * pending = routes.get_pending(i);
+		if (pending == NULL)
+			continue;
+		
+		if (forward_by_mac('D', pending->dest, pending->payload, pending->id)) {
+			routes.data_sent++;
+			pending->used = false;
+		}
+		else if (millis() - pending->sent_ms >= RREQ_TIMEOUT) {
+			if (pending->retries >= RREQ_RETRIES) {
+				console.print("No route to ");
+				console.println(mac_to_string(pending->dest));
+				routes.data_dropped++;
+				pending->used = false;
+			}
+			else {
+				pending->retries++;
+				pending->sent_ms = millis();
+				discover_route(pending->dest);
+			}
+		}
+	}
+}
+
+/* Cost of a route learned from a neighbour: the cost the packet carried, which every relay has 
+	increased by the ETX of the link it arrived on, plus the ETX of the link from the neighbour. 
+	A packet of a node without the cost field counts 100 for every hop behind the neighbour.
+     *
+	 * param from: IP of the neighbour the route goes through
+	 * param hops: distance to the destination over that neighbour
+	 * param carried: cost field of the packet, empty if it has none
+	 * return: cost x100, compared by DEWDRouteTable::update() and passed on in the packet
+     */
+uint16_t route_cost(IPAddress from, int hops, String carried) {
+	long cost = isdigit(carried[0]) ? carried.toInt() : (hops - 1) * 100L;
+	cost += links.etx(from);
+	return cost > 0xFFFF ? 0xFFFF : cost;
+}
+
+/* Handle a route request: set up the reverse route to its originator, then either answer it 
+	(this node is the destination or knows a route to it) or flood it further.
+     *
+	 * param s: "Q <id> <src_ip> <orig_mac> <orig_seq> <dest_mac> <hops> <cost>"
+     */
+void parse_route_request(String s) {
+	int id = atoi(s.substring(1, 5).c_str());
+	IPAddress from = string_to_ip(get_ip_string(s.substring(6)));
+	String fields = tcp.parse(s);
+	
+	MACAddress orig = string_to_mac(pop_word(fields));
+	uint16_t orig_seq = pop_word(fields).toInt();
+	MACAddress dest = string_to_mac(pop_word(fields));
+	int hops = pop_word(fields).toInt() + 1;
+	uint16_t cost = route_cost(from, hops, pop_word(fields));
+	
+	if (is_own_mac(orig) || routes.seen_request(orig, id))			// echo or duplicate, drop silently
+		return;
+	routes.update(orig, from, hops, orig_seq, cost);				// reverse route towards the originator
+	
+	String payload;
+	DEWDStation * station = stations.find(dest);
+	DEWDRoute * route;
+	
+	if (is_own_mac(dest)) {											// this node is the destination
+		routes.own_seq++;
+		payload = mac_string(true);
+		payload += " ";
+		payload += routes.own_seq;
+		payload += " ";
+		payload += mac_to_string(orig);
+		payload += " 0 0";
+	}
+	else if (station != NULL && station->ip[0] != 0) {				// destination is a client of this node
+		payload = mac_to_string(dest);
+		payload += " 0 ";
+		payload += mac_to_string(orig);
+		payload += " 1 ";
+		payload += links.etx(station->ip);
+	}
+	else if ((route = routes.find(dest)) != NULL) {					// answer from the route cache
+		payload = mac_to_string(dest);
+		payload += " ";
+		payload += route->seq;
+		payload += " ";
+		payload += mac_to_string(orig);
+		payload += " ";
+		payload += route->hops;
+		payload += " ";
+		payload += route->cost;
+	}
+	else {															// keep flooding
+		payload = mac_to_string(orig);
+		payload += " ";
+		payload += orig_seq;
+		payload += " ";
+		payload += mac_to_string(dest);
+		payload += " ";
+		payload += hops;
+		payload += " ";
+		payload += cost;
+		flood_route_request(payload, id, from);
+		return;
+	}
+	
+	if (tcp.send_by_ip(tcp.make_packet('P', link_ip(from), payload, id), from))
+		routes.rrep_sent++;
+}
+
+/* Handle a route reply: set up the forward route to the destination and pass the reply 
+	on along the reverse route, unless this node originated the request.
+     *
+	 * param s: "P <id> <src_ip> <dest_mac> <dest_seq> <orig_mac> <hops> <cost>"
+     */
+void parse_route_reply(String s) {
+	int id = atoi(s.substring(1, 5).c_str());
+	IPAddress from = string_to_ip(get_ip_string(s.substring(6)));
+	String fields = tcp.parse(s);
+	
+	MACAddress dest = string_to_mac(pop_word(fields));
+	uint16_t dest_seq = pop_word(fields).toInt();
+	MACAddress orig = string_to_mac(pop_word(fields));
+	int hops = pop_word(fields).toInt() + 1;
+	uint16_t cost = route_cost(from, hops, pop_word(fields));
+	
+	routes.update(dest, from, hops, dest_seq, cost);				// forward route towards the destination
+	if (is_own_mac(orig))											// parked unicasts are sent by route_maintenance()
+		return;
+	
+	String payload = mac_to_string(dest);
+	payload += " ";
+	payload += dest_seq;
+	payload += " ";
+	payload += mac_to_string(orig);
+	payload += " ";
+	payload += hops;
+	payload += " ";
+	payload += cost;
+	if (forward_by_mac('P', orig, payload, id))
+		routes.rrep_sent++;
+	else if (DEBUG)
+		console.println("Route reply dropped - no reverse route");
+}
+
+/* Handle a MAC-addressed unicast: print it if this node is the destination, otherwise forward it one hop.
+     *
+	 * param s: "D <id> <src_ip> <dest_mac> <orig_mac> <ttl> <text>"
+     */
+void parse_unicast(String s) {
+	int id = atoi(s.substring(1, 5).c_str());
+	String fields = tcp.parse(s);
+	
+	MACAddress dest = string_to_mac(pop_word(fields));
+	String orig = pop_word(fields);
+	int ttl = pop_word(fields).toInt();
+	
+	if (is_own_mac(dest)) {
+		routes.data_delivered++;
+		if (fields.startsWith("TOPO_PULL")) {							// the root missed a topology change of this subtree
+			topology_pull();
+			return;
+		}
+		if (DEBUG) {
+			console.print("Unicast from ");
+			console.println(orig);
+		}
+		console.println(fields);										// print it to serial!
+		return;
+	}
+	if (--ttl <= 0) {
+		routes.data_dropped++;
+		return;
+	}
+	
+	String payload = mac_to_string(dest);
+	payload += " ";
+	payload += orig;
+	payload += " ";
+	payload += ttl;
+	payload += " ";
+	payload += fields;
+	if (forward_by_mac('D', dest, payload, id))
+		routes.data_sent++;
+	else {
+		routes.data_dropped++;
+		if (DEBUG)
+			console.println("Unicast dropped - no route");
+	}
+}
+
+/* Deliver the parked packets of a child in one batch, oldest first. Stops at the first packet the child does not take.
+     *
+	 * param child: STA MAC of the child
+	 * param ip: IP the child has now
+     */
+void deliver_mail(MACAddress child, IPAddress ip) {
+	int i;
+	while ((i = mailbox.oldest(child)) >= 0) {						// in the order the packets were parked
+		if (!tcp.send_by_ip(mailbox.get(i)->packet, ip))
+			return;
+		mailbox.delivered_mail(i);
+		rtc.note_forward();
+	}
+}
+
+/* Keep track of the children and deliver parked packets to the ones that are back. 
+	Called once per main-loop iteration, deliveries are attempted every MAILBOX_RETRY ms.
+     *
+     */
+void mailbox_maintenance() {
+	for (int i=0; i<stations.count(); i++)
+		mailbox.note_child(stations.get(i)->mac);
+	
+	if (millis() - mailbox_check_ms < MAILBOX_RETRY)
+		return;
+	mailbox_check_ms = millis();
+	mailbox.expire();
+	
+	DEWDStation children[MAX_STATIONS];								// a send yields, the table may change meanwhile
+	int n = stations.copy(children);
+	for (int i=0; i<n; i++) {
+		DEWDStation * station = &children[i];
+		if (station->ip[0] != 0 && mailbox.pending(station->mac) > 0)
+			deliver_mail(station->mac, station->ip);
+	}
+}
+
+/* Take the scheduled SENSOR_AT samples that are due. Nothing waits here: mesh_delay() ends the 
+	main-loop delay at the agreed mesh time, so all nodes sample at the same instant.
+     *
+     */
+void sample_maintenance() {
+	for (int i=1; i<=active_broadcasts_index; i++) {
+		DEWDBroadcast & b = active_broadcasts[i];
+		if (!b.sample_pending || (long)(b.sample_at - mesh_time.now()) > 0)
+			continue;
+		
+		b.sample_pending = false;
+		b.resp_message += mac_string(true);
+		b.resp_message += " @";
+		b.resp_message += mesh_time.now();							// actual time of the sample, late if the broadcast arrived late
+		b.resp_message += " err=";
+		if (mesh_time.synced())
+			b.resp_message += mesh_time.error_ms;
+		else
+			b.resp_message += "?";
+		b.resp_message += " ";
+		b.resp_message += read_sensor(b.sample_command);
+		b.resp_message += ";";
+		
+		if (--b.resp_index == 0) {
+			if (stations.count() == 0)
+				sleep_answered = true;								// edge node may go back to sleep
+			remove_active_broadcasts(i);
+			return;													// active_broadcasts has been rearranged
+		}
+	}
+}
+
+/* Main-loop delay. Inbound lines are read every TCP_POLL ms meanwhile, so they are stamped when they 
+	arrive rather than when the loop comes round, and the delay ends early when a scheduled SENSOR_AT 
+	sample falls due.
+     *
+	 * param ms: delay of the main loop
+     */
+void mesh_delay(unsigned long ms) {
+	for (int i=1; i<=active_broadcasts_index; i++) {
+		DEWDBroadcast & b = active_broadcasts[i];
+		if (!b.sample_pending)
+			continue;
+		long wait = (long)(b.sample_at - mesh_time.now());
+		if (wait <= 0)
+			return;
+		if ((unsigned long)wait < ms)
+			ms = wait;
+	}
+	unsigned long start = millis();
+	while (millis() - start < ms) {
+		unsigned long left = ms - (millis() - start);
+		delay(left < TCP_POLL ? left : TCP_POLL);
+		tcp.ingress();
+	}
+}
+
+/* Ask the parent for its mesh time, see DEWDTime.h. Called once per main-loop iteration.
+     *
+     */
+void time_maintenance() {
+	if (WiFi.gatewayIP()[0] == 0 || !mesh_time.request_due(millis()))
+		return;
+	unsigned long t1 = millis();									// stamped before connecting, the connect is part of the round trip
+	mesh_time.request_sent(t1);
+	String payload = "Q ";
+	payload += t1;
+	tcp.send_by_ip(tcp.make_packet('T', WiFi.localIP(), payload, random(100, 256)), WiFi.gatewayIP());
+}
+
+/* Handle a time-sync message. A request ("Q") from a child is answered with the own mesh time, 
+	a reply ("A") from the parent is a sample for the own clock.
      *
-	 * param payload: String to be broadcast
-	 * param b: broadcast object containing the necessary meta-data
-	 * 
+	 * param s: "T <id> <src_ip> Q <t1>" or "T <id> <src_ip> A <t1> <mesh_ms> <stratum> <error_ms> <hold_ms>"
+	 * param received: millis() when s was received
      */
-void broadcast(String payload, DEWDBroadcast b) {
-	if (DEBUG)
-		Serial.println("Composing broadcast messages...");
+void parse_time(String s, unsigned long received) {
+	int s_id = atoi(s.substring(1, 5).c_str());
+	IPAddress from = string_to_ip(get_ip_string(s.substring(6)));
+	String fields = tcp.parse(s);
+	String dir = pop_word(fields);
 	
-	// This part forwards broadcast to host
-	if (b.src_ip != WiFi.gatewayIP() && WiFi.gatewayIP()[0] != 0) {						// host it not source of broadcast		
-		if (DEBUG)
-			Serial.println("Sending to host...");
+	if (dir == "Q") {
+		String payload = "A ";
+		payload += pop_word(fields);								// child's t1, echoed
+		payload += " ";
+		payload += mesh_time.now();
+		payload += " ";
+		payload += mesh_time.stratum;
+		payload += " ";
+		payload += mesh_time.error_ms;
+		payload += " ";
+		payload += millis() - received;								// the child takes the wait off its round trip
+		tcp.send_by_ip(tcp.make_packet('T', WiFi.softAPIP(), payload, s_id), from);
+	}
+	else if (from == WiFi.gatewayIP()) {
+		unsigned long t1 = strtoul(pop_word(fields).c_str(), NULL, 10);
+		unsigned long t2 = strtoul(pop_word(fields).c_str(), NULL, 10);
+		uint8_t p_stratum = pop_word(fields).toInt();
+		unsigned long p_error = strtoul(pop_word(fields).c_str(), NULL, 10);
+		unsigned long hold = strtoul(fields.c_str(), NULL, 10);		// 0 from a parent that does not report it
 		
-		String tcp_packet = tcp.make_packet('B', WiFi.localIP(), payload, b.id);		// make tcp broadcast-packet with STA-IP as source
-		if (!tcp.send_by_ip(tcp_packet, WiFi.gatewayIP())) {																
-			if (DEBUG)
-				Serial.println("failed");
+		if (mesh_time.on_reply(t1, t2, received, p_stratum, p_error, hold)) {
+			sleep_schedule.resync(mesh_time.now(), millis());		// keep the wake window on the mesh clock
+			if (DEBUG) {
+				console.println("Mesh time synced:");
+				console.println(mesh_time.print_values());
+			}
 		}
-		else {
-			active_broadcasts[active_broadcasts_index].resp_index++;					// increase number of responses expected
-			if (DEBUG)
-					Serial.println("sent");
-		}			
-	}
-	
-	if (DEBUG) {
-		Serial.print("active_broadcasts_index=");
-		Serial.println(active_broadcasts_index);
 	}
+}
+
+/* Tell the parent whether its link to this node is used as tree link
+     *
+	 * return: true if the hello was delivered
+     */
+bool send_parent_hello() {
+	String payload = "U ";
+	payload += mac_string(true);
+	payload += " ";
+	payload += tree.parent_in_tree ? 1 : 0;
+	return tcp.send_by_ip(tcp.make_packet('H', WiFi.localIP(), payload, random(100, 256)), WiFi.gatewayIP());
+}
+
+/* Size of the own tree for the label of a root: the nodes in the live topology view, or the own 
+	children as long as the view is still empty
+     *
+	 * return: nr of nodes, at most 255
+     */
+uint8_t root_load() {
+	int n = topo_sync.view.count > 0 ? topo_sync.view.count : 1 + stations.count();
+	return n < 255 ? n : 255;
+}
+
+/* Announce the own tree label to one or all children
+     *
+	 * param dest: IP of the child, 0.0.0.0 for all children
+     */
+void send_child_hellos(IPAddress dest) {
+	String payload = "D ";
+	payload += mac_string(true);
+	payload += " ";
+	payload += tree.prio;
+	payload += " ";
+	payload += mac_to_string(tree.root);
+	payload += " ";
+	payload += tree.depth;
+	payload += " ";
+	payload += tree.load;
+	String tcp_packet = tcp.make_packet('H', WiFi.softAPIP(), payload, random(100, 256));
 	
-	// This part forwards broadcast to clients
-	struct station_info * station = wifi_softap_get_station_info();
-	struct station_info * next_station;
-	
-	if (station == NULL) {																		// if no clients...
-		if (active_broadcasts[active_broadcasts_index].resp_index == 0)							// and not awaiting any responses...
-			remove_active_broadcasts(active_broadcasts_index);									// finalize broadcast by sending a response and then freeing active broadcasts slot  
-		return;
+	DEWDStation children[MAX_STATIONS];								// a send yields, the table may change meanwhile
+	int n = stations.copy(children);
+	for (int i=0; i<n; i++) {
+		DEWDStation * station = &children[i];
+		if (station->ip[0] != 0 && (dest[0] == 0 || station->ip == dest))
+			tcp.send_by_ip(tcp_packet, station->ip);
 	}
-	int count = 2;																				// last octet of client. Always starts with 2
-	String tcp_packet = tcp.make_packet('B', WiFi.softAPIP(), payload, b.id);					// make tcp broadcast-packet with SoftAP-IP as source
+}
+
+/* Handle a tree hello. A hello from the parent ("D") carries its label, a hello from a child ("U") 
+	tells whether the child uses this link as tree link and is answered with the own label.
+     *
+	 * param s: "H <id> <src_ip> D <sta_mac> <prio> <root_mac> <depth> <root_load>" or "H <id> <src_ip> U <sta_mac> <in_tree>"
+     */
+void parse_hello(String s) {
+	IPAddress from = string_to_ip(get_ip_string(s.substring(6)));
+	String fields = tcp.parse(s);
+	String dir = pop_word(fields);
+	MACAddress sender = string_to_mac(pop_word(fields));
 	
-	while(station)																				// for each station connected to AP ...
-	{ 
-		ip_addr * temp = &station->ip;								
-		IPAddress sta_ip(temp->addr);							
-		
-		IPAddress client_ip = WiFi.softAPIP();
-		client_ip[3] = count;																	// first clients last octet is always 2, second client - 3, third - 4, etc.																	
+	if (dir == "D") {
+		if (from != WiFi.gatewayIP())								// only the current parent's label counts
+			return;
+		uint8_t p_prio = pop_word(fields).toInt();
+		MACAddress p_root = string_to_mac(pop_word(fields));
+		uint8_t p_depth = pop_word(fields).toInt();
+		uint8_t p_load = pop_word(fields).toInt();					// 0 from parents that do not announce it
+		bool was_known = tree.parent_known;
+		bool was_in_tree = tree.parent_in_tree;
+		uint16_t limit_hits = tree.depth_limit_hits;
 		
-		if (DEBUG) {
-			Serial.print("Client ");
-			Serial.print(count - 1);
-			Serial.print(": ");
-			Serial.print(client_ip);
-			Serial.println(" - sending...");
+		bool changed = tree.on_parent_hello(own_mac(), sender, p_prio, p_root, p_depth);
+		if (tree.depth_limit_hits != limit_hits) {
+			console.print("Tree depth limit reached, parent label depth ");
+			console.println(p_depth);
 		}
-
-		if (b.src_ip != client_ip) {															// check that the client is not the source of the broadcast
-			if (!tcp.send_by_ip(tcp_packet, client_ip)) {																
-				if (DEBUG)
-					Serial.println("failed");
+		if (changed) {
+			if (DEBUG) {
+				console.println("Tree label changed:");
+				console.println(tree.print_values());
 			}
-			else {
-				active_broadcasts[active_broadcasts_index].resp_index++;						// expect a response from this client
-				if (DEBUG)
-					Serial.println("sent");
-			}		
-		}
-		else {																					// nothing sent to this client and no response is awaited
-			if (DEBUG)
-				Serial.println("client is the source - nothing sent");
+			send_child_hellos(IPAddress(0, 0, 0, 0));
 		}
-			
-		count++;
-		next_station = STAILQ_NEXT(station, next);
-		station = next_station;
-	}  
-	if (active_broadcasts[active_broadcasts_index].resp_index == 0){							// this is needed if the only client connected to AP 
-		if (DEBUG)																				// was the source of the broadcast
-			Serial.println("No more broadcasts");
-		remove_active_broadcasts(active_broadcasts_index);										// finalize broadcast by sending a responces and then freeing active broadcasts slot
+		tree.load = tree.parent_in_tree && p_load > 0 ? p_load : root_load();	// passed on with the next periodic hello
+		if (!was_known || was_in_tree != tree.parent_in_tree)
+			tree_parent_hello_due = !send_parent_hello();
+	}
+	else {
+		tree.on_child_hello(sender, fields.toInt() != 0);
+		send_child_hellos(from);
+		deliver_mail(sender, from);									// child is awake, hand over what was parked for it
 	}
 }
 
-/* This function does one of 3 things, sequentially going from 1-3:
-		1) broadcast is identified as a duplicate and a wrong-response message is sent (flag 'W')
-		2) current node is an edge node so a response message is sent (flag 'R')
-		3) current node is connected to at least one other ESP that is not the source of broadcast - a new broadcast object is created 
+/* Keep the tree view in line with the STA link and re-announce the own label to the children 
+	every HELLO_FREQ ms. Called once per main-loop iteration.
      *
-	 * param s: Broadcast string to be parsed
-	 *
      */
-void parse_broadcast(String s) {
+void tree_maintenance() {
+	IPAddress gateway = WiFi.gatewayIP();
 	
-	// s might look something like "B 123 192.168.4.1 texttextext"
-	int s_id = atoi(s.substring(1, 5).c_str());
-	IPAddress s_src = string_to_ip(get_ip_string(s.substring(6)));
-	if (DEBUG) {
-		Serial.print("ID is: ");
-		Serial.print(s_id);
-		Serial.print(", SRC_IP is: ");
-		Serial.println(s_src);
+	if (gateway != tree_gateway) {								// uplink lost or moved to another AP
+		tree_gateway = gateway;
+		tree.reset(own_mac(), gateway[0] != 0);
+		if (gateway[0] == 0)										// own clock is the mesh time now
+			mesh_time.become_root();
+		else
+			mesh_time.resync();
+		tree_parent_hello_due = gateway[0] != 0;
+		if (gateway[0] == 0)										// this node is a root now, with an uplink wait for the parents label
+			send_child_hellos(IPAddress(0, 0, 0, 0));
 	}
+	if (tree_parent_hello_due)
+		tree_parent_hello_due = !send_parent_hello();
+	if (!tree.parent_in_tree)
+		tree.load = root_load();
+	parents.advertise(tree.prio, tree.depth, stations.count(), tree.root, tree.load);	// no-op if label and load are unchanged
 	
-	if (active_broadcasts_index > 5) {
-		if (DEBUG)
-			Serial.println("Too many active broadcasts");
-		active_broadcasts_index = 1;										// round-robin
+	if (millis() - tree_hello_ms >= HELLO_FREQ) {
+		tree_hello_ms = millis();
+		tree.prune_children();
+		send_child_hellos(IPAddress(0, 0, 0, 0));
 	}
-	
-	if (active_broadcasts_index != 0) {										// check if duplicate broadcast
-		for (int i=1; i<=active_broadcasts_index; i++) {	
-			if (DEBUG) {
-				Serial.print("active_broadcasts[");
-				Serial.print(i);
-				Serial.print("].id = ");
-				Serial.println(active_broadcasts[i].id);
-			}
-			if (active_broadcasts[i].id == s_id) {
-				if (DEBUG)
-					Serial.println("Duplicate broadcast!");
-				String tcp_packet = tcp.make_packet('W', INADDR_NONE, "", s_id);
-				// send "W <id>" to s_src IP
-				if (!tcp.send_by_ip(tcp_packet, s_src)) {										
-					if (DEBUG)
-						Serial.println("W-message not sent");
-				}
-				return;
-			}
-		}
-	}	
-	// if this is an edge node...
-	if (wifi_softap_get_station_num() == 0) {								
-		if (DEBUG) 
-			Serial.println("Edge node");
-		
-		String payload = mac_string(true) + " " + execute_broadcast(get_payload_string(s.substring(6))) + ";";
-		String tcp_packet = tcp.make_packet('R', INADDR_NONE, payload, s_id);
-		
-		if (!tcp.send_by_ip(tcp_packet, s_src)) {							// send response to broadcast source
-			if (DEBUG)
-				Serial.println("Couldn't reach source IP for broadcast response");
-		}
-		else {
-			if (DEBUG)
-				Serial.println("Response sent");
-		}
-		return;
-	}		
-	// ...otherwise create broadcast object
-	if (DEBUG)
-		Serial.println("Create new DEWDBroadcast object...");
+}
 
-	DEWDBroadcast br(s_src, s_id);											
-	active_broadcasts[++active_broadcasts_index] = br;
-	
-	String mac;
-	if (WiFi.localIP()[0] != 0)
-		mac = mac_string(true);
+/* Pass a topology message up the tree. The root of the tree applies it to its view, and pulls 
+	the subtree of a node whose earlier message got lost.
+     *
+	 * param payload: "<mac> <seq> <kind> <args>", see DEWDTopoSync.h
+     */
+void topology_up(String payload) {
+	if (tree.parent_in_tree && WiFi.gatewayIP()[0] != 0) {
+		tcp.send_by_ip(tcp.make_packet('Y', WiFi.localIP(), payload, random(100, 256)), WiFi.gatewayIP());
+		return;
+	}
+	if (topo_sync.apply(payload, millis()))
+		return;
+	MACAddress node = string_to_mac(pop_word(payload));
+	if (is_own_mac(node))
+		topo_sync.pull();
 	else
-		mac = mac_string(false);
-	
-	active_broadcasts[active_broadcasts_index].resp_message += mac;
-	active_broadcasts[active_broadcasts_index].resp_message += " ";
-	active_broadcasts[active_broadcasts_index].resp_message += execute_broadcast(tcp.parse(s));
-	active_broadcasts[active_broadcasts_index].resp_message += ";";
-	
-	// broadcast message, must be placed here, otherwise br is removed in broadcast() before response is composed
-	if (DEBUG) 
-		Serial.println("Here calling broadcast()...");
-	broadcast(tcp.parse(s), br);
+		send_to_mac(node, "TOPO_PULL");
 }
 
-/* Listen to all ports, identify packet-flags and take appropriate actions
+/* Send an own topology message up the tree
      *
+	 * param kind: 'F', 'D' or 'S'
+	 * param args: record or changes
      */
-void listen_to_ports() {
-	String req;
-	
-	// UDP listener
-	String udp_printout = udp.listen();
-	if(udp_printout.length() > 0) {
-		req = udp_printout;
-		if (DEBUG) {
-			Serial.println("UDP received!");
-			Serial.println(udp_printout);
-		}
+void send_topology(char kind, String args) {
+	String payload = mac_string(true);
+	payload += " ";
+	payload += topo_sync.seq;
+	payload += " ";
+	payload += kind;
+	payload += " ";
+	payload += args;
+	topo_sync.sent++;
+	topo_sync.digest_ms = millis();
+	topology_up(payload);
+}
+
+/* Answer a pull of the root: the own full record goes up at the next check, the pull goes on 
+	to the children in the tree
+     *
+     */
+void topology_pull() {
+	topo_sync.pull();
+	String tcp_packet = tcp.make_packet('Y', WiFi.softAPIP(), mac_string(true) + " 0 G", random(100, 256));
+	DEWDStation children[MAX_STATIONS];								// a send yields, the table may change meanwhile
+	int n = stations.copy(children);
+	for (int i=0; i<n; i++) {
+		DEWDStation * station = &children[i];
+		if (station->ip[0] != 0 && tree.child_in_tree(station->mac))
+			tcp.send_by_ip(tcp_packet, station->ip);
 	}
-	udp.restart_server();										// NEEDED BECAUSE OF RANDOM-PORT PROBLEM
+}
+
+/* Tie the link table's IPs to neighbour MACs and feed it RSSI: the uplink's from the STA interface, 
+	the children's from the scan cache. Runs every LINK_CHECK_FREQ ms.
+     *
+     */
+void link_maintenance() {
+	if (millis() - link_check_ms < LINK_CHECK_FREQ)
+		return;
+	link_check_ms = millis();
 	
-	// TCP listener
-	String tcp_printout = tcp.listen();
-	if(tcp_printout.length() > 0) {
-		req = tcp_printout;										// TCP CAN OVERWRITE UDP REQUEST
-		if (DEBUG) {
-			Serial.println("TCP received!");
-			Serial.println(tcp_printout);
-		}
+	if (WiFi.status() == WL_CONNECTED && WiFi.gatewayIP()[0] != 0) {
+		links.bind(WiFi.gatewayIP(), WiFi.BSSID());
+		links.sample_rssi(WiFi.BSSID(), WiFi.RSSI());
 	}
-  
-	if (tcp_printout.length() + udp_printout.length() < 1) 		// no data received
+	uint8_t mac[6];
+	for (int i=0; i<stations.count(); i++) {
+		DEWDStation * station = stations.get(i);
+		if (station->ip[0] == 0)
+			continue;
+		for (int j=0; j<6; j++)
+			mac[j] = station->mac[j];
+		links.bind(station->ip, mac);
+	}
+	if (scans.valid && scans.scanned_ms != link_scanned_ms) {		// children only show up in scans with their softAP BSSID
+		link_scanned_ms = scans.scanned_ms;
+		for (int i=0; i<scans.count(); i++)
+			links.sample_rssi(scans.get(i)->bssid, scans.get(i)->rssi);
+	}
+}
+
+/* Report changes of the own links up the tree, or a digest if nothing changed for a while
+     *
+     */
+void topology_maintenance() {
+	if (millis() - topo_sync.check_ms < TOPO_CHECK_FREQ)
 		return;
+	topo_sync.check_ms = millis();
+	if (!tree.parent_in_tree || WiFi.gatewayIP()[0] == 0)
+		topo_sync.expire(millis());
+	
+	uint8 mac[6];
+	wifi_get_macaddr(STATION_IF, mac);
+	DEWDTopologyRecord now;
+	own_topology(now, mac);
+	String delta;
+	int change = topo_sync.compare(now, delta);
 	
+	if (change == TOPO_FULL)
+		send_topology('F', DEWDTopology::encode(now));
+	else if (change == TOPO_DELTA)
+		send_topology('D', delta);
+	else if (millis() - topo_sync.digest_ms >= TOPO_DIGEST_FREQ)
+		send_topology('S', "");
+}
+
+/* Handle a topology message: changes of a child's subtree go on up, a pull from the parent goes on down
+     *
+	 * param s: "Y <id> <src_ip> <mac> <seq> <kind> <args>"
+     */
+void parse_topology(String s) {
+	String payload = tcp.parse(s);
+	payload.trim();
+	int kind = payload.indexOf(' ', payload.indexOf(' ') + 1) + 1;
+	if (kind > 0 && payload[kind] == 'G')
+		topology_pull();
+	else
+		topology_up(payload);
+}
+
+/* Identify the flag of a received message and take appropriate actions
+     *
+	 * param req: message as received from the UDP or TCP port
+	 * param received_ms: millis() when it was read from the port, for time-sync samples
+	 * param received_us: micros() of the same moment, the handling latency is measured from it
+     */
+void handle_message(String req, unsigned long received_ms, unsigned long received_us) {
 	char flag = req[0];
 	
 	// turn led ON on EVB board. Does nothing on non-EVB modules
@@ -452,26 +1850,61 @@ void listen_to_ports() {
 	pinMode(5, OUTPUT);										// FILLER CODE
 	digitalWrite(5, 1);
 	if (DEBUG)
-		Serial.println("Connected!");
+		console.println("Connected!");
   }	
   else if (flag == 'B') {									// broadcast message
 	if (DEBUG) 
-		Serial.println("Identified as broadcast...");
+		console.println("Identified as broadcast...");
 	parse_broadcast(req);									// parse it!
   }
   else if (flag == 'U') {									// UDP message
 	if (DEBUG) 
-		Serial.println("Identified as UDP message...");
-	Serial.println(udp.parse(req));							// print it to serial!
+		console.println("Identified as UDP message...");
+	console.println(udp.parse(req));							// print it to serial!
   }
   else if (flag == 'M') {									// TCP message
 	if (DEBUG) 
-		Serial.println("Identified as TCP message...");
-	Serial.println(tcp.parse(req));							// print it to serial!
+		console.println("Identified as TCP message...");
+	console.println(tcp.parse(req));							// print it to serial!
+  }
+  else if (flag == 'Q') {									// route request
+	if (DEBUG) 
+		console.println("Identified as route request...");
+	parse_route_request(req);
+  }
+  else if (flag == 'P') {									// route reply
+	if (DEBUG) 
+		console.println("Identified as route reply...");
+	parse_route_reply(req);
+  }
+  else if (flag == 'D') {									// MAC-addressed unicast
+	if (DEBUG) 
+		console.println("Identified as MAC-addressed unicast...");
+	parse_unicast(req);
+  }
+  else if (flag == 'H') {									// tree hello
+	if (DEBUG) 
+		console.println("Identified as tree hello...");
+	parse_hello(req);
+  }
+  else if (flag == 'X') {									// cancel of a limited query
+	if (DEBUG) 
+		console.println("Identified as broadcast cancel...");
+	parse_cancel(req);
+  }
+  else if (flag == 'Y') {									// topology change, digest or pull
+	if (DEBUG) 
+		console.println("Identified as topology update...");
+	parse_topology(req);
+  }
+  else if (flag == 'T') {									// time sync
+	if (DEBUG) 
+		console.println("Identified as time sync...");
+	parse_time(req, received_ms);
   }
   else if (flag == 'W') {									// wrong response, means source already received broadcast through another route
 	if (DEBUG) 
-		Serial.println("Identified as wrong-response...");
+		console.println("Identified as wrong-response...");
 	
 	int w_id = atoi(req.substring(1, 5).c_str());
 	for (int i=1; i<=active_broadcasts_index; i++) {		// find the broadcast in question...				
@@ -484,32 +1917,86 @@ void listen_to_ports() {
   }
   else if (flag == 'R') {									// broadcast response
 	if (DEBUG) 
-		Serial.println("Identified as response to a broadcast...");
+		console.println("Identified as response to a broadcast...");
 	
 	int w_id = atoi(req.substring(1, 5).c_str());
 	for (int i=0; i<=active_broadcasts_index; i++) {						// find broadcast in question
 		if (active_broadcasts[i].id == w_id) {			
-			active_broadcasts[i].resp_message += req.substring(6);			// add response to that DEWDBroadcasts object 			
-			active_broadcasts[i].resp_index--;								// lower expected responses by 1
-			if (active_broadcasts[i].resp_index == 0){						// if all responses have been received...
-				if (DEBUG) 
-					Serial.println("No more responses, remove broadcast");
-				remove_active_broadcasts(i);								// send responses to broadcasts originator IP and remove this broadcast
-			}
+			String resp = req.substring(6);
+			bool partial = resp[0] == '+';									// answer of a limited query, more to come
+			if (partial)
+				resp = resp.substring(1);
+			else
+				active_broadcasts[i].resp_index--;							// lower expected responses by 1
+			if (DEBUG && active_broadcasts[i].resp_index == 0) 
+				console.println("No more responses, remove broadcast");
+			add_response(i, resp, !partial);								// once all responses have been received, send them to broadcasts originator IP and remove this broadcast
 			break;
 		}
 	}
   }
   else {													// none of the above - do nothing
+	  metrics.drop(flag);
 	  if (DEBUG) {
-		Serial.println("Non-standard message!");
-		Serial.print("Exact message: ");
-		Serial.println(req);
+		console.println("Non-standard message!");
+		console.print("Exact message: ");
+		console.println(req);
 	  }
   }
 
+	metrics.message(flag, micros() - received_us);
 	if (DEBUG)
-		Serial.println();									// pretty formatting in Arduino serial terminal
+		console.println();									// pretty formatting in Arduino serial terminal
+}
+
+/* Run the maintenance tasks, then handle the message from the UDP port and every line that arrived 
+	on the TCP port, up to TCP_BURST per call
+     *
+     */
+void handle_ports() {
+	stations.update();											// resolve DHCP leases of newly associated stations
+	scan_maintenance();											// collect background scan results
+	subnet_maintenance();										// move the softAP off a subnet used by a neighbour
+	route_maintenance();										// send unicasts waiting for route discovery
+	tree_maintenance();											// keep the spanning-tree view up to date
+	topology_maintenance();										// report link changes to the root
+	link_maintenance();											// keep MACs and RSSI of the link table current
+	mailbox_maintenance();										// deliver packets parked for children that are back
+	time_maintenance();											// keep the clock in line with the parent's
+	sample_maintenance();										// take scheduled SENSOR_AT samples
+	duty_cycle();												// sleep outside the shared wake window
+	
+	// UDP listener
+	String udp_printout = udp.listen();
+	udp.restart_server();										// NEEDED BECAUSE OF RANDOM-PORT PROBLEM
+	if(udp_printout.length() > 0) {
+		if (DEBUG) {
+			console.println("UDP received!");
+			console.println(udp_printout);
+		}
+		handle_message(udp_printout, millis(), micros());
+	}
+	
+	// TCP listener, drains what several senders delivered at once
+	for (int n=0; n<TCP_BURST; n++) {
+		String tcp_printout = tcp.listen();
+		if (tcp_printout.length() == 0)
+			break;
+		if (DEBUG) {
+			console.println("TCP received!");
+			console.println(tcp_printout);
+		}
+		handle_message(tcp_printout, tcp.received_ms, tcp.received_us);
+	}
+}
+
+/* Listen to all ports, identify packet-flags and take appropriate actions
+     *
+     */
+void listen_to_ports() {
+	unsigned long start = micros();
+	handle_ports();
+	metrics.record(HIST_LOOP, micros() - start);
 }
   
   /* Decode the string written to the serial COM port, or received through a broadcast 
@@ -519,6 +2006,8 @@ void listen_to_ports() {
      */
 void decode_command(String com) {
   	String ret;
+	String bare = com;												// without the line ending a text-mode command has, framed ones have none
+	bare.trim();
   
 	if (!strcmp(com.substring(0, 6).c_str(), "print ")){
 		if (!strcmp(com.substring(6, 8).c_str(), "-a")) {						// list all APs in range
@@ -526,112 +2015,134 @@ void decode_command(String com) {
 		}
 		else if (!strcmp(com.substring(6, 8).c_str(), "-b")) {					// print all active broadcasts
 			for (int i=1; i <= active_broadcasts_index; i++) {
-				Serial.println(active_broadcasts[i].print_values());
+				console.println(active_broadcasts[i].print_values());
 			}
 		} 
 		else if (!strcmp(com.substring(6, 8).c_str(), "-c")) {					// print IPs of clients connected to this node
-			Serial.println("No stations connected to current AP");
-			Serial.println();
-			int count = 0;
-			struct station_info * station = wifi_softap_get_station_info();
-			struct station_info * next_station;	  
-			if (station == NULL)
-				return;
-			  
-			while(station)
-			{ 
-				ip_addr * temp = &station->ip;
-				IPAddress sta_ip(temp->addr);
-				Serial.print(++count);		
-				Serial.print(".  IP: ");	
-				Serial.print(sta_ip);
-					
-				Serial.print("       MAC: ");		
-				for (int i=0;i<5;i++) {
-					Serial.print(station->bssid[i], HEX);
-					Serial.print(":");
-				}
-				Serial.println(station->bssid[5], HEX);		
-				next_station = STAILQ_NEXT(station, next);
-				station = next_station;
-			}
-			wifi_softap_free_station_info();
+			console.println(stations.print_values());
 		}
 		else if (!strcmp(com.substring(6, 8).c_str(), "-i")) {					// print station, AP and gateway IPs
-			Serial.println();
+			console.println();
 			print_IP();
 		}
+		else if (!strcmp(com.substring(6, 8).c_str(), "-r")) {					// print route cache and unicast statistics
+			console.println(routes.print_values());
+		}
+		else if (!strcmp(com.substring(6, 8).c_str(), "-t")) {					// print spanning-tree view and broadcast statistics
+			console.println(tree.print_values());
+		}
+		else if (!strcmp(com.substring(6, 8).c_str(), "-m")) {					// print mailbox occupancy and drop counters
+			console.println(mailbox.print_values());
+		}
+		else if (!strcmp(com.substring(6, 8).c_str(), "-s")) {					// print mesh time, stratum and error bound
+			console.println(mesh_time.print_values());
+		}
+		else if (!strcmp(com.substring(6, 8).c_str(), "-p")) {					// print message counters and latency histograms
+			console.println(metrics.print_values());
+		}
+		else if (!strcmp(com.substring(6, 8).c_str(), "-l")) {					// print blocking sections and slow loop iterations
+			console.println(stalls.print_values());
+		}
+		else if (!strcmp(com.substring(6, 8).c_str(), "-g")) {					// print the last MAP_TOPOLOGY result
+			console.println(topology.print_values());
+		}
+		else if (!strcmp(com.substring(6, 8).c_str(), "-y")) {					// print the live topology view
+			console.println(topo_sync.print_values());
+		}
+		else if (!strcmp(com.substring(6, 8).c_str(), "-k")) {					// print ETX and RSSI of the neighbour links
+			console.println(links.print_values());
+		}
 		else
-			Serial.println("Valid flags: -a -b -c -i");
+			console.println("Valid flags: -a -b -c -i -r -t -m -s -p -l -g -y -k");
 		ret = "done";
   	}
 	else if (!strcmp(com.substring(0, 5).c_str(), "mesh ")) {
 		if (!strcmp(com.substring(5, 7).c_str(), "-s")) {							// Check if AP with mesh SSID is active
 			if (!check_mesh_ap())
-				Serial.println("No mesh AP");
+				console.println("No mesh AP");
 			else
-				Serial.println("Mesh AP active");
+				console.println("Mesh AP active");
+			console.println(scans.valid ? "(from scan cache)" : "(no scan yet, started in background)");
 		}
 		else if (!strcmp(com.substring(5, 7).c_str(), "-S")) {					// Set up a mesh-node
 			 setup_mesh();
 		}
 		else if (!strcmp(com.substring(5, 7).c_str(), "-a")) {					// Toggle mesh-mode
 			if (MESH_MODE_ACTIVE) {
-				Serial.println("Mesh inactive");
+				console.println("Mesh inactive");
 				MESH_MODE_ACTIVE = false;
 			}
 			else {
-				Serial.println("Mesh active");
+				console.println("Mesh active");
 				MESH_MODE_ACTIVE = true;
 			}
 		}
 		else if (!strcmp(com.substring(5, 7).c_str(), "-c")) {
 			connect_to_mesh();
 		}
+		else if (!strcmp(com.substring(5, 7).c_str(), "-p")) {					// print candidate parents and their cost
+			console.println(parents.print_values());
+		}
+		else if (!strcmp(com.substring(5, 7).c_str(), "-h")) {					// print channel occupancy from the scan cache
+			channel_plan.score(scans.get(0), scans.count());
+			console.println(channel_plan.print_values());
+			scans.request(SCAN_MAX_AGE);
+		}
+		else if (!strcmp(com.substring(5, 7).c_str(), "-n")) {					// print softAP subnet assignment
+			console.println(subnet_plan.print_values());
+		}
+		else if (!strcmp(com.substring(5, 7).c_str(), "-b")) {					// print reconnect backoff state
+			console.println(reconnect.print_values(millis()));
+		}
+		else if (!strcmp(com.substring(5, 7).c_str(), "-g")) {					// gateway root on/off: "mesh -g [0|1]"
+			if (com.length() > 8)
+				set_gateway(com.substring(8).toInt() != 0);
+			console.println(gateway_root ? "Gateway root" : "Mesh node");
+		}
 		else
-			Serial.println("Valid flags: -s -S -a -c");
+			console.println("Valid flags: -s -S -a -c -p -h -n -b -g");
 		ret = "done";
 	}
 	else if (!strcmp(com.substring(0, 4).c_str(), "esp ")) {
 		if (!strcmp(com.substring(4, 6).c_str(), "-s")) {					// Print out modules WiFi-status and interface info
 			const char* ssid = WiFi.SSID().c_str();
     
-			Serial.print("WiFi status: ");
+			console.print("WiFi status: ");
 			switch (WiFi.status()) {
 				case 0:
-					Serial.println("WL_IDLE_STATUS");
+					console.println("WL_IDLE_STATUS");
 					break;
 				case 1:
-					Serial.println("WL_NO_SSID_AVAIL");
+					console.println("WL_NO_SSID_AVAIL");
 					break;
 				case 2:
-					Serial.println("WL_SCAN_COMPLETED");
+					console.println("WL_SCAN_COMPLETED");
 					break;
 				case 3:
-					Serial.println("WL_CONNECTED");
+					console.println("WL_CONNECTED");
 					break;
 				case 4:
-					Serial.println("WL_CONNECT_FAILED");
+					console.println("WL_CONNECT_FAILED");
 					break;
 				case 5:
-					Serial.println("WL_CONNECTION_LOST");
+					console.println("WL_CONNECTION_LOST");
 					break;
 				case 6:
-					Serial.println("WL_DISCONNECTED");
+					console.println("WL_DISCONNECTED");
 					break;
 			}  
 			
-			Serial.print("Connected to: ");
+			console.print("Connected to: ");
 			if (strlen(ssid) < 2)
-				Serial.println("NONE");
+				console.println("NONE");
 			else
-				Serial.println(ssid);
+				console.println(ssid);
 			
-			Serial.print("AP active: ");
+			console.print("AP active: ");
 			if (wifi_get_opmode() > 1)	
-				Serial.println("YES");
+				console.println("YES");
 			else
-				Serial.println("NO");			
+				console.println("NO");			
 		}
 		else if (!strcmp(com.substring(4, 6).c_str(), "-c")) {				// Connect to specified AP
 			WiFi.disconnect();
@@ -643,7 +2154,11 @@ void decode_command(String com) {
 				ret = "done";
 				return;
 			}		
-			Serial.println("Password:");
+			if (console.framed()) {
+				ret = "not available on a framed link";
+				return;
+			}
+			console.println("Password:");
 			Serial.setTimeout(10000);
 			String password = Serial.readStringUntil('\n');
 			Serial.setTimeout(1000);
@@ -691,103 +2206,134 @@ void decode_command(String com) {
 			else if (mode == "AP_STA")
 				WiFi.mode(WIFI_AP_STA);
 			else
-				Serial.println("Error! Mode must be either OFF, STA, AP or AP_STA");
+				console.println("Error! Mode must be either OFF, STA, AP or AP_STA");
 		}
-		else if (!strcmp(com.substring(4, 6).c_str(), "-r")) 				// Restart module
+		else if (!strcmp(com.substring(4, 6).c_str(), "-r")) {				// Restart module
+			rtc.save();
 			system_restart();
+		}
 		else if (!strcmp(com.substring(4, 6).c_str(), "-D")) {			// Enter deep-sleep for a given amount of us
 			long per = com.substring(7).toInt();     	 					// length of sleep in microseconds
-			Serial.print("Deep-sleep for ");
-			Serial.print(per);
-			Serial.println("us");
+			console.print("Deep-sleep for ");
+			console.print(per);
+			console.println("us");
+			rtc.save();
 			system_deep_sleep_set_option(1);									//Calibrate RF when waking up
 			system_deep_sleep(per);
 		}
 		else if (!strcmp(com.substring(4, 6).c_str(), "-W")) {			// Change wifi-sleep mode - 0=NONE, 1=LIGHT, 2=MODEM
 			sleep_type t = static_cast<sleep_type>(com.substring(7).toInt());
 			wifi_set_sleep_type(t);	
-			Serial.print("WiFi-Sleep mode changed to ");
-			Serial.println(wifi_get_sleep_type());
+			console.print("WiFi-Sleep mode changed to ");
+			console.println(wifi_get_sleep_type());
 		}
 		else if (!strcmp(com.substring(4, 6).c_str(), "-p")) {
 			if (DEBUG) {
-				Serial.println("Debug mode disabled");
+				console.println("Debug mode disabled");
 				DEBUG = false;
 			}
 			else {
-				Serial.println("Debug mode enabled");
+				console.println("Debug mode enabled");
 				DEBUG = true;
 			}
 		}
 		else
-			Serial.println("Valid flags: -s -c -d -m -r -D -W -p");
+			console.println("Valid flags: -s -c -d -m -r -D -W -p");
 		ret = "done";
 	}  
-	else if (com == "secret\r\n") {
-		Serial.print("Vdd is: "); 
-		Serial.println(system_get_vdd33());
-		Serial.print("ADC is: "); 
-		Serial.println(system_adc_read());
-		Serial.print("SDK version: ");
-		Serial.println(system_get_sdk_version());
-		Serial.print("Chip ID: ");
-		Serial.println(ESP.getChipId());
-		Serial.print("Connection status: ");
+	else if (bare == "secret") {
+		console.print("Vdd is: "); 
+		console.println(system_get_vdd33());
+		console.print("ADC is: "); 
+		console.println(system_adc_read());
+		console.print("SDK version: ");
+		console.println(system_get_sdk_version());
+		console.print("Chip ID: ");
+		console.println(ESP.getChipId());
+		console.print("Connection status: ");
 		
 		switch (wifi_station_get_connect_status()) {
 			case 0:
-				Serial.println("STATION_IDLE");
+				console.println("STATION_IDLE");
 				break;
 			case 1:
-				Serial.println("STATION_CONNECTING");
+				console.println("STATION_CONNECTING");
 				break;
 			case 2:
-				Serial.println("STATION_WRONG_PASSWORD,");
+				console.println("STATION_WRONG_PASSWORD,");
 				break;
 			case 3:
-				Serial.println("STATION_NO_AP_FOUND");
+				console.println("STATION_NO_AP_FOUND");
 				break;
 			case 4:
-				Serial.println("STATION_CONNECT_FAIL");
+				console.println("STATION_CONNECT_FAIL");
 				break;
 			case 5:
-				Serial.println("STATION_GOT_IP");
+				console.println("STATION_GOT_IP");
 				break;
 		}
 	
-		Serial.print("Active broadcasts: ");
-		Serial.println(active_broadcasts_index);
-		Serial.print("RSSI of AP hosting this module: ");
-		Serial.println(wifi_station_get_rssi());
-		Serial.print("Number of stations connected to ESP AP: ");
-		Serial.println(wifi_softap_get_station_num());
-		Serial.print("Random number: ");
-		Serial.println(gen_random(256));
-		Serial.print("Free space on heap:: ");
-		Serial.println(system_get_free_heap_size());
-		Serial.print("TCP remote IP address: ");
-		Serial.println(ip_to_string(tcp.get_remote_ip()));
-		Serial.print("WIFI PHY mode: ");
+		console.print("Active broadcasts: ");
+		console.println(active_broadcasts_index);
+		console.print("RSSI of AP hosting this module: ");
+		console.println(wifi_station_get_rssi());
+		console.print("Number of stations connected to ESP AP: ");
+		console.println(wifi_softap_get_station_num());
+		console.print("Random number: ");
+		console.println(gen_random(256));
+		console.print("Free space on heap:: ");
+		console.println(system_get_free_heap_size());
+		console.print("Boot to first forwarded packet: ");
+		if (rtc.first_forward_ms == 0)
+			console.print("none yet");
+		else {
+			console.print(rtc.first_forward_ms);
+			console.print(" ms");
+		}
+		console.println(rtc.restored ? " (RTC cache used)" : " (no RTC cache)");
+		console.print("TCP remote IP address: ");
+		console.println(ip_to_string(tcp.get_remote_ip()));
+		console.print("WIFI PHY mode: ");
 		switch (wifi_get_phy_mode()) {
 			case 1:
-				Serial.println("802.11b");
+				console.println("802.11b");
 				break;
 			case 2:
-				Serial.println("802.11g");
+				console.println("802.11g");
 				break;
 			case 3:
-				Serial.println("802.11n");
+				console.println("802.11n");
 				break;
 		}
 		ret = "done";
   	}
+	else if (!strcmp(com.substring(0, 6).c_str(), "sleep ")) {
+		if (!strcmp(com.substring(6, 8).c_str(), "-s"))							// print schedule and query statistics
+			console.println(sleep_schedule.print_values(millis()));
+		else if (!strcmp(com.substring(6, 8).c_str(), "-c")) {					// set schedule on this node only: sleep -c <period_s> <awake_s>
+			String args = com.substring(9);
+			unsigned long period = pop_word(args).toInt();
+			sleep_schedule.set(period * 1000, args.toInt() * 1000, millis());
+			if (mesh_time.synced())
+				sleep_schedule.set_mesh_anchor(mesh_time.now());
+		}
+		else if (!strcmp(com.substring(6, 8).c_str(), "-x")) {					// stop duty cycling on this node
+			sleep_schedule.set(0, 0, millis());
+			for (int i=0; i<deferred_count; i++)
+				deferred_broadcasts[i] = "";
+			deferred_count = 0;
+		}
+		else
+			console.println("Valid flags: -s -c -x");
+		ret = "done";
+	}
 	else if (!strcmp(com.substring(0, 4).c_str(), "udp ")) {
 		if (!strcmp(com.substring(4, 6).c_str(), "-m"))	{							// multicast 
 			String udp_packet = udp.make_packet(com.substring(7));
 			udp.send_multicast(udp_packet);
 			if (DEBUG) {
-				Serial.println(udp_packet);
-				Serial.println("sent");
+				console.println(udp_packet);
+				console.println("sent");
 			}
 		}
 		else if (!strcmp(com.substring(4, 6).c_str(), "-r"))						// restart server
@@ -795,14 +2341,14 @@ void decode_command(String com) {
 		else if (!strcmp(com.substring(4, 6).c_str(), "-c"))						// change multicast port
 			udp.set_multicast(MULTICAST_IP, atoi(com.substring(7).c_str()));
 		else if (!strcmp(com.substring(4, 6).c_str(), "-s"))						// print status values
-			Serial.println(udp.get_info());
+			console.println(udp.get_info());
 		else {																						// send unicast to IP
 			String udp_packet = udp.make_packet(com.substring(7 + com.substring(6).indexOf(' ')));
 			udp.send_unicast(udp_packet, string_to_ip(get_ip_string(com.substring(4)))); //GET PAYLOAD
 			if (DEBUG) {
-				Serial.println("Sending UDP unicast");
-				Serial.println(udp_packet);
-				Serial.println("sent");		
+				console.println("Sending UDP unicast");
+				console.println(udp_packet);
+				console.println("sent");		
 			}
 		}
 		ret = "done";
@@ -810,32 +2356,52 @@ void decode_command(String com) {
 	else if (!strcmp(com.substring(0, 4).c_str(), "tcp ")) {
 		String tcp_packet;
 		if (!strcmp(com.substring(4, 6).c_str(), "-b")) {					// tcp broadcast
-			
-			DEWDBroadcast br(random(100, 256));
 			String command_string = com.substring(7);
 			command_string.replace('\n', '\0');
 			
-			if (WiFi.localIP()[0] != 0)
-				br.src_ip = WiFi.localIP();
+			if (!sleep_schedule.in_window(millis()) && deferred_count >= SLEEP_DEFERRED_MAX)	// the collector backs off
+				console.line(FRAME_RESULT, "BUSY deferred " + String(deferred_count) + "/" + String(SLEEP_DEFERRED_MAX));
+			else if (!sleep_schedule.in_window(millis())) {					// part of the mesh is asleep, wait for the window
+				deferred_broadcasts[deferred_count++] = command_string;
+				console.print("Deferred to next wake window in ");
+				console.print(sleep_schedule.until_window(millis()));
+				console.println(" ms");
+			}
 			else
-				br.src_ip= WiFi.softAPIP();
-			
-			active_broadcasts[++active_broadcasts_index] = br;
-			
-			broadcast(command_string, br);
-			
-			active_broadcasts[active_broadcasts_index].resp_message += mac_string(true);
-			active_broadcasts[active_broadcasts_index].resp_message += " ";
-			active_broadcasts[active_broadcasts_index].resp_message += execute_broadcast(command_string);
-			active_broadcasts[active_broadcasts_index].resp_message += ";"; 
+				start_broadcast(command_string);
+		}
+		else if (!strcmp(com.substring(4, 6).c_str(), "-t")) {					// traced tcp broadcast, every node reports its timing
+			String command_string = com.substring(7);
+			command_string.replace('\n', '\0');
+			start_broadcast("#T " + command_string);
+		}
+		else if (!strcmp(com.substring(4, 6).c_str(), "-a")) {					// limited tcp broadcast: "tcp -a <n> <cmd>" stops after n answers
+			String command_string = com.substring(7);
+			command_string.replace('\n', '\0');
+			int limit = pop_word(command_string).toInt();
+			start_broadcast("#A" + String(limit > 0 ? limit : 1) + " " + command_string);
+		}
+		else if (!strcmp(com.substring(4, 6).c_str(), "-S")) {					// streamed tcp broadcast, answers are printed as they arrive
+			String command_string = com.substring(7);
+			command_string.replace('\n', '\0');
+			start_broadcast("#S " + command_string);
 		}
 		else if (!strcmp(com.substring(4, 6).c_str(), "-s"))										// print tcp status data
-			Serial.println(tcp.get_info());
+			console.println(tcp.get_info());
 		else if (!strcmp(com.substring(4, 6).c_str(), "-B")) {										// clear all active broadcasts
 			active_broadcasts_index = 0;
 		}
 		else if (!strcmp(com.substring(4, 6).c_str(), "-r"))										// restart TCP server
 			tcp.restart_server();
+		else if (!strcmp(com.substring(4, 6).c_str(), "-m")) {										// send to MAC, over multiple hops if needed
+			String text = com.substring(7);
+			MACAddress dest = string_to_mac(pop_word(text));
+			
+			if (send_to_mac(dest, text))
+				console.println("sent");
+			else
+				console.println("failed");
+		}
 		else {																						// send to IP
 			if (WiFi.localIP()[0] != 0)
 				tcp_packet = tcp.make_packet('M', WiFi.localIP(), com.substring(7 + com.substring(6).indexOf(' ')), random(100,256));
@@ -843,22 +2409,58 @@ void decode_command(String com) {
 				tcp_packet = tcp.make_packet('M', WiFi.softAPIP(), com.substring(7 + com.substring(6).indexOf(' ')), random(100,256));
 			
 			if (DEBUG) {
-				Serial.print("Sending tcp to ");
-				Serial.println(get_ip_string(com.substring(4)));
-				Serial.println(tcp_packet);
+				console.print("Sending tcp to ");
+				console.println(get_ip_string(com.substring(4)));
+				console.println(tcp_packet);
 			}
 			
 			if (tcp.send_by_ip(tcp_packet, string_to_ip(get_ip_string(com.substring(4)))))
-				Serial.println("sent");
+				console.println("sent");
+			else
+				console.println("failed");
+		}
+		ret = "done";
+	}
+	else if (!strcmp(com.substring(0, 6).c_str(), "admit ")) {
+		String args = com.substring(9);
+		args.trim();
+		if (!strcmp(com.substring(6, 8).c_str(), "-r")) {					// rate limit per originator: "admit -r <per_minute> [<burst>]"
+			if (args.length() == 0 || args.indexOf(' ') != args.lastIndexOf(' ') || !admission.configure(args))
+				console.println("Usage: admit -r <per_minute> [<burst>]");
+		}
+		else if (!strcmp(com.substring(6, 8).c_str(), "-f")) {				// broadcasts this node may have in flight, 0 for no limit
+			if (isdigit(args[0]))
+				admission.in_flight = args.toInt();
 			else
-				Serial.println("failed");
+				console.println("Usage: admit -f <in_flight>");
+		}
+		else if (!strcmp(com.substring(6, 8).c_str(), "-s"))				// print limits and drop counters
+			console.println(admission.print_values());
+		else
+			console.println("Valid flags: -r -f -s");
+		ret = "done";
+	}
+	else if (!strcmp(com.substring(0, 5).c_str(), "link ")) {
+		if (!strcmp(com.substring(5, 7).c_str(), "-f")) {					// framed link to the host at a higher baud rate
+			long baud = com.substring(8).toInt();
+			if (baud <= 0)
+				baud = 115200;
+			console.start_framed(baud);
 		}
+		else if (!strcmp(com.substring(5, 7).c_str(), "-t"))				// back to text at CONSOLE_BAUD
+			console.stop_framed();
+		else if (!strcmp(com.substring(5, 7).c_str(), "-m"))				// metrics as a typed frame
+			console.line(FRAME_METRICS, metrics.encode());
+		else if (!strcmp(com.substring(5, 7).c_str(), "-s"))				// link statistics
+			console.println(console.print_values());
+		else
+			console.println("Valid flags: -f -t -m -s");
 		ret = "done";
 	}
 	else {
 		ret = com;
 	}
 	if (DEBUG)
-		Serial.println(ret);
+		console.println(ret);
 }
 #endif
\ No newline at end of file
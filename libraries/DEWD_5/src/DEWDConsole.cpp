@@ -0,0 +1,265 @@
+/*
+ DEWDConsole.cpp Body file defining the serial console of a node, in text or framed mode.
+ Created by agent, 2026.
+ 
+ */
+ 
+#include <Arduino.h>
+#include <DEWDConsole.h>
+
+DEWDConsole console;
+
+static uint16_t crc16_update(uint16_t crc, uint8_t b) {
+	crc ^= (uint16_t)b << 8;
+	for (int i=0; i<8; i++)
+		crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+	return crc;
+}
+
+ICACHE_FLASH_ATTR DEWDConsole::DEWDConsole() {
+}
+
+bool DEWDConsole::framed() {
+	return _framed;
+}
+
+/* Switch to framed mode at a new baud rate. The confirmation is still sent as text at the old rate.
+     *
+	 * param new_baud: baud rate of the framed link
+     */
+void ICACHE_FLASH_ATTR DEWDConsole::start_framed(long new_baud) {
+	Serial.print("LINK ");
+	Serial.println(new_baud);
+	Serial.flush();
+	Serial.begin(new_baud);
+	baud = new_baud;
+	_framed = true;
+	_confirmed = false;
+	_switched_ms = millis();
+	_tx_seq = 0;
+	_rx_seq = -1;
+	_rx_len = 0;
+	_line_len = 0;
+}
+
+/* Switch back to text mode at CONSOLE_BAUD
+     *
+     */
+void ICACHE_FLASH_ATTR DEWDConsole::stop_framed() {
+	if (!_framed)
+		return;
+	send_frame(FRAME_LINK, "text");
+	Serial.flush();
+	Serial.begin(CONSOLE_BAUD);
+	baud = CONSOLE_BAUD;
+	_framed = false;
+	_rx_len = 0;
+	_rx_overflow = false;
+}
+
+/* Streaming COBS encoder: blocks of up to 254 non-zero bytes, each preceded by its length + 1
+     *
+     */
+void DEWDConsole::cobs_put(uint8_t b) {
+	if (b != 0)
+		_block[_block_len++] = b;
+	if (b == 0 || _block_len == 254) {
+		Serial.write((uint8_t)(b == 0 ? _block_len + 1 : 0xFF));
+		Serial.write(_block, _block_len);
+		_block_len = 0;
+	}
+}
+
+void DEWDConsole::frame_begin(uint8_t type) {
+	_block_len = 0;
+	_crc = 0xFFFF;
+	frame_byte(type);
+	frame_byte(_tx_seq++);
+}
+
+void DEWDConsole::frame_byte(uint8_t b) {
+	_crc = crc16_update(_crc, b);
+	cobs_put(b);
+}
+
+void DEWDConsole::frame_end() {
+	uint16_t crc = _crc;
+	cobs_put(crc >> 8);
+	cobs_put(crc & 0xFF);
+	Serial.write((uint8_t)(_block_len + 1));						// last block, no implied zero
+	Serial.write(_block, _block_len);
+	Serial.write((uint8_t)0);
+	_block_len = 0;
+	frames_sent++;
+}
+
+/* Send a typed frame. Only in framed mode, see line() for output that works in both modes.
+     *
+     */
+void DEWDConsole::send_frame(uint8_t type, const String & payload) {
+	frame_begin(type);
+	for (unsigned int i=0; i<payload.length(); i++)
+		frame_byte(payload[i]);
+	frame_end();
+}
+
+/* Output a line of a given type: a frame in framed mode, a text line otherwise
+     *
+     */
+void DEWDConsole::line(uint8_t type, const String & text) {
+	if (_framed)
+		send_frame(type, text);
+	else
+		Serial.println(text);
+}
+
+/* Print interface. Console text is collected per line and sent as FRAME_TEXT in framed mode.
+     *
+     */
+size_t DEWDConsole::write(uint8_t c) {
+	if (!_framed)
+		return Serial.write(c);
+	if (c == '\r')
+		return 1;
+	if (c != '\n')
+		_line[_line_len++] = c;
+	if (c == '\n' || _line_len == CONSOLE_LINE_MAX) {
+		frame_begin(FRAME_TEXT);
+		for (int i=0; i<_line_len; i++)
+			frame_byte(_line[i]);
+		frame_end();
+		_line_len = 0;
+	}
+	return 1;
+}
+
+/* Decode the frame in _rx and check it
+     *
+	 * param command: set to the payload of a command or text frame
+	 * return: true if command was set
+     */
+bool ICACHE_FLASH_ATTR DEWDConsole::frame_received(String & command) {
+	uint8_t data[FRAME_MAX_IN];
+	int len = 0;
+	for (int i=0; i<_rx_len; ) {									// COBS decode
+		uint8_t code = _rx[i++];
+		for (int j=1; j<code && i<_rx_len; j++)
+			data[len++] = _rx[i++];
+		if (code != 0xFF && i < _rx_len)
+			data[len++] = 0;
+	}
+	
+	if (len < 4) {
+		crc_errors++;
+		return false;
+	}
+	uint16_t crc = 0xFFFF;
+	for (int i=0; i<len - 2; i++)
+		crc = crc16_update(crc, data[i]);
+	if (crc != ((data[len - 2] << 8) | data[len - 1])) {
+		crc_errors++;
+		return false;
+	}
+	
+	frames_received++;
+	_confirmed = true;
+	if (_rx_seq >= 0 && data[1] != (uint8_t)(_rx_seq + 1))
+		seq_gaps++;
+	_rx_seq = data[1];
+	
+	String payload;
+	for (int i=2; i<len - 2; i++)
+		payload += (char)data[i];
+	if (data[0] == FRAME_LINK && payload == "text") {
+		stop_framed();
+		return false;
+	}
+	if (data[0] != FRAME_COMMAND && data[0] != FRAME_TEXT)
+		return false;
+	command = payload;
+	return true;
+}
+
+/* Read the text console up to the end of a line, without waiting for bytes that have not arrived. 
+	The line keeps its '\n' (and '\r'), as the commands were read with readString() before.
+     *
+	 * param command: set to the command
+	 * return: true if a line is complete, or text has been idle for CONSOLE_TEXT_IDLE ms
+     */
+bool DEWDConsole::text_received(String & command) {
+	bool complete = false;
+	while (!complete && Serial.available()) {
+		uint8_t c = Serial.read();
+		_rx_ms = millis();
+		if (_rx_len < FRAME_MAX_IN - 1)
+			_rx[_rx_len++] = c;
+		else
+			_rx_overflow = true;
+		complete = c == '\n';
+	}
+	if (_rx_len == 0 || (!complete && millis() - _rx_ms < CONSOLE_TEXT_IDLE))
+		return false;
+	if (_rx_overflow)
+		overflows++;
+	_rx[_rx_len] = 0;
+	command = (const char *)_rx;
+	_rx_len = 0;
+	_rx_overflow = false;
+	return true;
+}
+
+/* Read a console command, called once per main-loop iteration
+     *
+	 * param command: set to the command
+	 * return: true if a command was read
+     */
+bool DEWDConsole::read_command(String & command) {
+	if (!_framed)
+		return text_received(command);
+	if (!_confirmed && millis() - _switched_ms > LINK_CONFIRM_TIMEOUT) {
+		Serial.begin(CONSOLE_BAUD);									// host did not follow, back to text
+		baud = CONSOLE_BAUD;
+		_framed = false;
+		_rx_len = 0;
+		_rx_overflow = false;
+		return false;
+	}
+	
+	while (Serial.available()) {
+		uint8_t c = Serial.read();
+		if (c != 0) {
+			if (_rx_len < FRAME_MAX_IN)
+				_rx[_rx_len++] = c;
+			else
+				_rx_overflow = true;
+			continue;
+		}
+		bool ok = false;
+		if (_rx_overflow)
+			overflows++;
+		else if (_rx_len > 0)
+			ok = frame_received(command);
+		_rx_len = 0;
+		_rx_overflow = false;
+		if (ok)
+			return true;
+	}
+	return false;
+}
+
+String ICACHE_FLASH_ATTR DEWDConsole::print_values(void) {
+	String res = _framed ? " framed" : " text";
+	res += " baud=";
+	res += baud;
+	res += " frames_sent=";
+	res += frames_sent;
+	res += " frames_received=";
+	res += frames_received;
+	res += " crc_errors=";
+	res += crc_errors;
+	res += " seq_gaps=";
+	res += seq_gaps;
+	res += " overflows=";
+	res += overflows;
+	return res;
+}
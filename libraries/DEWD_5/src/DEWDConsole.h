@@ -0,0 +1,84 @@
+/*
+ DEWDConsole.h Header file defining the serial console of a node, in text or framed mode.
+ In text mode everything printed goes to Serial as before. In framed mode, used on the root towards the 
+ gateway PC, the link runs at a higher baud rate and carries typed frames: 
+	<type> <seq> <payload> <crc16 hi> <crc16 lo>, COBS encoded and terminated by a 0x00 byte.
+ Console text is sent as FRAME_TEXT frames, one per line, and query results in frames of their own. 
+ The CRC is CRC-16/CCITT over type, seq and payload, seq counts the frames per direction. The link 
+ switches with 'link -f <baud>'. The node falls back to text at CONSOLE_BAUD if no valid frame 
+ arrives from the host within LINK_CONFIRM_TIMEOUT. In text mode every line is a command of its own, 
+ so a host may send several commands back to back; text without a line end is taken as a command 
+ once the line has been idle for CONSOLE_TEXT_IDLE ms.
+ Created by agent, 2026.
+ 
+ */
+ 
+#ifndef DEWDConsole_h
+#define DEWDConsole_h
+
+#include <Print.h>
+#include <WString.h>
+
+	const long CONSOLE_BAUD = 9600;									// text mode, and fall-back of the framed mode
+	const unsigned long LINK_CONFIRM_TIMEOUT = 10000;				// ms the host has to send a valid frame after a switch
+	const int FRAME_MAX_IN = 256;									// largest encoded frame accepted from the host
+	const int CONSOLE_LINE_MAX = 256;								// longer console lines are split over several frames
+	const unsigned long CONSOLE_TEXT_IDLE = 1000;					// ms after which text without '\n' is a command, like the Stream timeout
+
+	enum frame_type {
+		FRAME_TEXT = 1,												// console text, one line per frame
+		FRAME_COMMAND = 2,											// console command from the host
+		FRAME_STARTED = 3,											// broadcast started: "B <id> <src_ip> <command>"
+		FRAME_RESULT = 4,											// broadcast complete: "R <id> <responses>"
+		FRAME_METRICS = 5,											// DEWDMetrics::encode()
+		FRAME_LINK = 6												// link control, "text" switches back to text mode
+	};
+
+class DEWDConsole : public Print
+{
+private:
+	bool _framed = false;
+	bool _confirmed = false;										// a valid frame has been received since the switch
+	unsigned long _switched_ms = 0;
+	uint8_t _tx_seq = 0;
+	int _rx_seq = -1;												// seq of the last frame received, -1 if none
+	uint8_t _line[CONSOLE_LINE_MAX];								// console text waiting for the end of the line
+	int _line_len = 0;
+	uint8_t _rx[FRAME_MAX_IN];										// encoded frame, or text command, being received
+	int _rx_len = 0;
+	unsigned long _rx_ms = 0;										// millis() of the last text byte
+	bool _rx_overflow = false;
+	uint8_t _block[254];											// COBS block being encoded
+	int _block_len = 0;
+	uint16_t _crc = 0;
+	
+	void cobs_put(uint8_t b);
+	void frame_begin(uint8_t type);
+	void frame_byte(uint8_t b);
+	void frame_end();
+	bool frame_received(String & command);
+	bool text_received(String & command);
+
+public:
+	long baud = CONSOLE_BAUD;
+	uint32_t frames_sent = 0;										// statistics, see print_values()
+	uint32_t frames_received = 0;
+	uint32_t crc_errors = 0;
+	uint32_t seq_gaps = 0;
+	uint32_t overflows = 0;
+	
+	DEWDConsole();
+	bool framed();
+	void start_framed(long new_baud);
+	void stop_framed();
+	virtual size_t write(uint8_t c);
+	using Print::write;
+	void send_frame(uint8_t type, const String & payload);
+	void line(uint8_t type, const String & text);
+	bool read_command(String & command);
+	String print_values(void);
+};
+
+extern DEWDConsole console;
+
+#endif
@@ -0,0 +1,175 @@
+/*
+ DEWDLink.cpp Body file defining the link-quality table a node keeps of its neighbours.
+ Created by agent, 2026.
+ 
+ */
+ 
+#include <Arduino.h>
+#include <DEWDLink.h>
+
+DEWDLinkTable links;
+
+static uint16_t link_etx(const DEWDLink & l) {
+	if (l.delivered == 0)
+		return LINK_ETX_MAX;
+	uint32_t etx = (uint32_t)l.attempts * 100 / l.delivered;
+	return etx < LINK_ETX_MAX ? etx : LINK_ETX_MAX;
+}
+
+ICACHE_FLASH_ATTR DEWDLinkTable::DEWDLinkTable() {
+}
+
+int DEWDLinkTable::find_index(IPAddress ip) {
+	for (int i=0; i<_count; i++)
+		if (_links[i].ip == ip)
+			return i;
+	return -1;
+}
+
+/* Record a send to a neighbour
+     *
+	 * param ip: neighbour the packet was sent to
+	 * param ok: true if the connection was established
+	 * param connect_us: time the connect took
+     */
+void DEWDLinkTable::record(IPAddress ip, bool ok, unsigned long connect_us) {
+	int i = find_index(ip);
+	if (i < 0) {
+		if (_count < LINK_MAX)
+			i = _count++;
+		else {														// reuse the link unused longest
+			i = 0;
+			for (int j=1; j<_count; j++)
+				if (millis() - _links[j].used_ms > millis() - _links[i].used_ms)
+					i = j;
+		}
+		_links[i] = DEWDLink();
+		_links[i].ip = ip;
+	}
+	DEWDLink & l = _links[i];
+	
+	unsigned long tx = 1 + connect_us / LINK_RTO_US;
+	if (tx > LINK_MAX_TX)
+		tx = LINK_MAX_TX;
+	if (l.sent + l.failed == 0) {									// first sample sets the averages
+		l.attempts = tx * 256;
+		l.delivered = ok ? 256 : 0;
+	}
+	else {
+		l.attempts = l.attempts - l.attempts / LINK_WEIGHT + tx * 256 / LINK_WEIGHT;
+		l.delivered = l.delivered - l.delivered / LINK_WEIGHT + (ok ? 256 / LINK_WEIGHT : 0);
+	}
+	if (ok) {
+		l.connect_us = l.sent == 0 ? connect_us : l.connect_us - l.connect_us / LINK_WEIGHT + connect_us / LINK_WEIGHT;
+		l.sent++;
+	}
+	else
+		l.failed++;
+	l.retransmits += tx - 1;
+	l.used_ms = millis();
+}
+
+/* Note the MAC of a neighbour, so it can be found by MAC and its RSSI from scans is recorded
+     *
+	 * param mac: softAP or STA MAC of the neighbour, they share the last three octets
+     */
+void DEWDLinkTable::bind(IPAddress ip, const uint8_t * mac) {
+	int i = find_index(ip);
+	if (i >= 0)
+		memcpy(_links[i].suffix, mac + 3, 3);
+}
+
+/* Average a RSSI measurement into the link to a neighbour, if there is one
+     *
+     */
+void DEWDLinkTable::sample_rssi(const uint8_t * mac, int rssi) {
+	for (int i=0; i<_count; i++) {
+		if (memcmp(_links[i].suffix, mac + 3, 3))
+			continue;
+		_links[i].rssi = _links[i].rssi == 0 ? rssi : _links[i].rssi + (rssi - _links[i].rssi) / 4;
+		return;
+	}
+}
+
+/* return: ETX x100 of the link to a neighbour, 100 (a perfect link) while nothing was sent to it
+     */
+uint16_t DEWDLinkTable::etx(IPAddress ip) {
+	int i = find_index(ip);
+	return i < 0 ? 100 : link_etx(_links[i]);
+}
+
+/* return: ETX x100 of the link to a neighbour given by softAP or STA MAC, 100 if unknown
+     */
+uint16_t DEWDLinkTable::etx_mac(const uint8_t * mac) {
+	for (int i=0; i<_count; i++)
+		if (!memcmp(_links[i].suffix, mac + 3, 3))
+			return link_etx(_links[i]);
+	return 100;
+}
+
+/* Links as returned by the LINKS broadcast, format per neighbour: 
+	"<ip> <mac suffix> <etx x100> <rssi> <sent>/<failed>/<retransmits> <connect_ms>,"
+     *
+     */
+String ICACHE_FLASH_ATTR DEWDLinkTable::encode(void) {
+	String res;
+	for (int i=0; i<_count; i++) {
+		DEWDLink & l = _links[i];
+		for (int j=0; j<4; j++) {
+			res += l.ip[j];
+			res += j < 3 ? '.' : ' ';
+		}
+		for (int j=0; j<3; j++) {
+			res += String(l.suffix[j], HEX);
+			res += j < 2 ? ':' : ' ';
+		}
+		res += link_etx(l);
+		res += " ";
+		res += l.rssi;
+		res += " ";
+		res += l.sent;
+		res += "/";
+		res += l.failed;
+		res += "/";
+		res += l.retransmits;
+		res += " ";
+		res += l.connect_us / 1000;
+		res += ",";
+	}
+	return res;
+}
+
+String ICACHE_FLASH_ATTR DEWDLinkTable::print_values(void) {
+	if (_count == 0)
+		return "No links";
+	String res;
+	for (int i=0; i<_count; i++) {
+		DEWDLink & l = _links[i];
+		res += i + 1;
+		res += ".  IP: ";
+		for (int j=0; j<3; j++) {
+			res += l.ip[j];
+			res += '.';
+		}
+		res += l.ip[3];
+		res += "  ETX: ";
+		uint16_t e = link_etx(l);
+		res += e / 100;
+		res += '.';
+		res += e % 100 < 10 ? "0" : "";
+		res += e % 100;
+		res += "  RSSI: ";
+		res += l.rssi;
+		res += "  sent/failed/retx: ";
+		res += l.sent;
+		res += "/";
+		res += l.failed;
+		res += "/";
+		res += l.retransmits;
+		res += "  connect_ms: ";
+		res += l.connect_us / 1000;
+		if (i < _count - 1)
+			res += "\n";
+	}
+	return res;
+}
@@ -0,0 +1,60 @@
+/*
+ DEWDLink.h Header file defining the link-quality table a node keeps of its neighbours.
+ Every TCP send is recorded against the neighbour it went to: a connect that fails counts as an 
+ attempt without delivery, a connect slower than the initial retransmission timeout as more than one 
+ transmission. Exponentially weighted averages of both give the ETX (expected transmissions per 
+ delivered packet) of the link, the RSSI is averaged from the uplink and the scans. Route selection 
+ and parent selection add the ETX to their cost, so a link losing half its packets costs as much 
+ as an extra hop.
+ Created by agent, 2026.
+ 
+ */
+ 
+#ifndef DEWDLink_h
+#define DEWDLink_h
+
+#include <IPAddress.h>
+#include <WString.h>
+
+	const int LINK_MAX = 12;										// neighbours tracked, the one unused longest is reused
+	const unsigned long LINK_RTO_US = 3000000;						// initial TCP retransmission timeout, slower connects were resent
+	const uint8_t LINK_MAX_TX = 8;									// transmissions counted for one send at most
+	const int LINK_WEIGHT = 8;										// a new sample weighs 1/LINK_WEIGHT in the averages
+	const uint16_t LINK_ETX_MAX = 1000;								// ETX x100 of a link without delivery
+	const unsigned long LINK_CHECK_FREQ = 5000;						// ms between updates of MACs and RSSI
+
+struct DEWDLink {
+	IPAddress ip;
+	uint8_t suffix[3];												// last three octets of the neighbour's MAC, zero until known
+	uint16_t attempts;												// average transmissions per send x256
+	uint16_t delivered;												// average deliveries per send x256
+	uint32_t connect_us;											// average connect time of successful sends
+	int8_t rssi;													// average RSSI, 0 until measured
+	uint16_t sent;													// statistics, see encode()
+	uint16_t failed;
+	uint16_t retransmits;
+	unsigned long used_ms;
+};
+
+class DEWDLinkTable
+{
+private:
+	DEWDLink _links[LINK_MAX];
+	int _count = 0;
+	
+	int find_index(IPAddress ip);
+
+public:
+	DEWDLinkTable();
+	void record(IPAddress ip, bool ok, unsigned long connect_us);
+	void bind(IPAddress ip, const uint8_t * mac);
+	void sample_rssi(const uint8_t * mac, int rssi);
+	uint16_t etx(IPAddress ip);
+	uint16_t etx_mac(const uint8_t * mac);
+	String encode(void);
+	String print_values(void);
+};
+
+extern DEWDLinkTable links;
+
+#endif
@@ -0,0 +1,152 @@
+/*
+ DEWDMailbox.cpp Body file defining the store-and-forward mailboxes a parent keeps for its children.
+ Created by agent, 2026.
+ 
+ */
+ 
+#include <Arduino.h>
+#include <DEWDMailbox.h>
+
+ICACHE_FLASH_ATTR DEWDMailbox::DEWDMailbox() {
+	for (int i=0; i<MAILBOX_SLOTS; i++)
+		_mail[i].used = false;
+}
+
+/* Remember an associated child, so that packets for it are parked while it is away
+     *
+     */
+void DEWDMailbox::note_child(MACAddress mac) {
+	int oldest = 0;
+	for (int i=0; i<_child_count; i++) {
+		if (mac == _children[i].mac) {
+			_children[i].seen_ms = millis();
+			return;
+		}
+		if ((long)(_children[i].seen_ms - _children[oldest].seen_ms) < 0)
+			oldest = i;
+	}
+	int i = _child_count < MAX_STATIONS ? _child_count++ : oldest;
+	_children[i].mac = mac;
+	_children[i].seen_ms = millis();
+}
+
+bool DEWDMailbox::is_child(MACAddress mac) {
+	for (int i=0; i<_child_count; i++) {
+		if (mac == _children[i].mac)
+			return true;
+	}
+	return false;
+}
+
+/* Park a packet for a child
+     *
+	 * return: false if the mailbox of the child or the byte budget is full
+     */
+bool ICACHE_FLASH_ATTR DEWDMailbox::put(MACAddress dest, String packet) {
+	int free_slot = -1;
+	
+	expire();
+	if (pending(dest) >= MAILBOX_PER_CHILD || _bytes + packet.length() > MAILBOX_BUDGET) {
+		dropped_full++;
+		return false;
+	}
+	for (int i=0; i<MAILBOX_SLOTS && free_slot < 0; i++) {
+		if (!_mail[i].used)
+			free_slot = i;
+	}
+	if (free_slot < 0) {
+		dropped_full++;
+		return false;
+	}
+	_mail[free_slot].dest = dest;
+	_mail[free_slot].packet = packet;
+	_mail[free_slot].expires = millis() + MAILBOX_TTL;
+	_mail[free_slot].order = _parked++;
+	_mail[free_slot].used = true;
+	_bytes += packet.length();
+	enqueued++;
+	return true;
+}
+
+int DEWDMailbox::pending(MACAddress dest) {
+	int n = 0;
+	for (int i=0; i<MAILBOX_SLOTS; i++) {
+		if (_mail[i].used && dest == _mail[i].dest)
+			n++;
+	}
+	return n;
+}
+
+/* return: slot of the packet parked first for dest, -1 if there is none
+     */
+int DEWDMailbox::oldest(MACAddress dest) {
+	int res = -1;
+	for (int i=0; i<MAILBOX_SLOTS; i++) {
+		if (_mail[i].used && dest == _mail[i].dest && (res < 0 || (int32_t)(_mail[i].order - _mail[res].order) < 0))
+			res = i;
+	}
+	return res;
+}
+
+DEWDMail * DEWDMailbox::get(int i) {
+	if (i < 0 || i >= MAILBOX_SLOTS || !_mail[i].used)
+		return NULL;
+	return &_mail[i];
+}
+
+void DEWDMailbox::drop(int i) {
+	_bytes -= _mail[i].packet.length();
+	_mail[i].packet = "";
+	_mail[i].used = false;
+}
+
+void DEWDMailbox::delivered_mail(int i) {
+	drop(i);
+	delivered++;
+}
+
+/* Drop packets whose time-to-live has run out, and forget children that have been away as long
+     *
+     */
+void ICACHE_FLASH_ATTR DEWDMailbox::expire() {
+	for (int i=0; i<MAILBOX_SLOTS; i++) {
+		if (_mail[i].used && (long)(millis() - _mail[i].expires) >= 0) {
+			drop(i);
+			dropped_ttl++;
+		}
+	}
+	for (int i=0; i<_child_count; ) {
+		if (millis() - _children[i].seen_ms > MAILBOX_TTL)
+			_children[i] = _children[--_child_count];
+		else
+			i++;
+	}
+}
+
+String ICACHE_FLASH_ATTR DEWDMailbox::print_values(void) {
+	int used = 0;
+	for (int i=0; i<MAILBOX_SLOTS; i++) {
+		if (_mail[i].used)
+			used++;
+	}
+	
+	String res = " slots_used=";
+	res += used;
+	res += "/";
+	res += MAILBOX_SLOTS;
+	res += " bytes=";
+	res += _bytes;
+	res += "/";
+	res += MAILBOX_BUDGET;
+	res += " known_children=";
+	res += _child_count;
+	res += "\n enqueued=";
+	res += enqueued;
+	res += " delivered=";
+	res += delivered;
+	res += " dropped_ttl=";
+	res += dropped_ttl;
+	res += " dropped_full=";
+	res += dropped_full;
+	return res;
+}
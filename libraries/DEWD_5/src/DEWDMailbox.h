@@ -0,0 +1,66 @@
+/*
+ DEWDMailbox.h Header file defining the store-and-forward mailboxes a parent keeps for its children.
+ Packets for a child that is asleep or temporarily disassociated are parked, bounded by a slot count 
+ per child, a byte budget and a time-to-live, and delivered in one batch when the child is back. 
+ Only unicast data is parked. Broadcasts are not: a DEEP_SLEEP, RESTART or DUTY_CYCLE delivered 
+ minutes late would act on a mesh that has moved on.
+ Created by agent, 2026.
+ 
+ */
+ 
+#ifndef DEWDMailbox_h
+#define DEWDMailbox_h
+
+#include <MACAddress.h>
+#include <WString.h>
+#include <DEWDStations.h>
+
+	const int MAILBOX_SLOTS = 12;									// packets parked for all children together
+	const int MAILBOX_PER_CHILD = 4;								// packets parked for one child
+	const unsigned int MAILBOX_BUDGET = 2048;						// bytes of parked packets for all children together
+	const unsigned long MAILBOX_TTL = 600000;						// ms a packet is kept, and a departed child is remembered
+	const unsigned long MAILBOX_RETRY = 2000;						// ms between delivery attempts to associated children
+
+struct DEWDMail {
+	MACAddress dest;												// STA MAC of the child
+	String packet;													// complete packet, ready to be sent
+	unsigned long expires;
+	uint32_t order;													// parked as the order-th packet, slots are reused out of order
+	bool used;
+};
+
+struct DEWDKnownChild {
+	MACAddress mac;
+	unsigned long seen_ms;											// millis() when the child was last associated
+};
+
+class DEWDMailbox
+{
+private:
+	DEWDMail _mail[MAILBOX_SLOTS];
+	DEWDKnownChild _children[MAX_STATIONS];							// children that were associated recently, incl. the sleeping ones
+	int _child_count = 0;
+	unsigned int _bytes = 0;
+	uint32_t _parked = 0;											// packets parked so far, orders the slots
+	
+	void drop(int i);
+
+public:
+	uint16_t enqueued = 0;											// statistics, see print_values()
+	uint16_t delivered = 0;
+	uint16_t dropped_ttl = 0;
+	uint16_t dropped_full = 0;
+	
+	DEWDMailbox();
+	void note_child(MACAddress mac);
+	bool is_child(MACAddress mac);
+	bool put(MACAddress dest, String packet);
+	int pending(MACAddress dest);
+	int oldest(MACAddress dest);
+	DEWDMail * get(int i);
+	void delivered_mail(int i);
+	void expire();
+	String print_values(void);
+};
+
+#endif
@@ -0,0 +1,188 @@
+/*
+ DEWDMetrics.cpp Body file defining the on-device counters and latency histograms.
+ Created by agent, 2026.
+ 
+ */
+ 
+#include <Arduino.h>
+#include <DEWDMetrics.h>
+
+DEWDMetrics metrics;
+
+	const char * HIST_NAMES[HIST_COUNT] = {"handle", "send", "connect", "sensor", "loop"};
+
+ICACHE_FLASH_ATTR DEWDMetrics::DEWDMetrics() {
+	reset();
+}
+
+void ICACHE_FLASH_ATTR DEWDMetrics::reset() {
+	memset(received, 0, sizeof(received));
+	memset(histograms, 0, sizeof(histograms));
+	memset(dropped, 0, sizeof(dropped));
+	sent = 0;
+	send_failed = 0;
+}
+
+/* Add a value to a histogram
+     *
+	 * param h: histogram
+	 * param us: value in microseconds
+     */
+void DEWDMetrics::record(metrics_histogram h, uint32_t us) {
+	DEWDHistogram & hist = histograms[h];
+	int b = 0;
+	for (uint32_t v = us >> 7; v != 0 && b < METRICS_BUCKETS - 1; v >>= 1)
+		b++;
+	hist.buckets[b]++;
+	hist.count++;
+	if (us > hist.max_us)
+		hist.max_us = us;
+}
+
+/* Count a handled message and its ingress-to-handled time
+     *
+	 * param flag: flag of the message
+	 * param us: time from the ingress pass that read it until it was handled
+     */
+void DEWDMetrics::message(char flag, uint32_t us) {
+	received[type(flag)]++;
+	record(HIST_HANDLE, us);
+}
+
+/* Count a message that was not handled: a duplicate, an overflow or an unknown message
+     *
+	 * param flag: flag of the message
+     */
+void DEWDMetrics::drop(char flag) {
+	dropped[type(flag)]++;
+}
+
+/* return: index of flag in received and dropped, the last one for unknown flags
+     */
+int DEWDMetrics::type(char flag) {
+	const char * f = strchr(METRICS_FLAGS, flag);
+	return f != NULL && flag != '\0' ? f - METRICS_FLAGS : METRICS_TYPES - 1;
+}
+
+void DEWDMetrics::send_result(bool ok, uint32_t connect_us, uint32_t send_us) {
+	sent++;
+	if (!ok)
+		send_failed++;
+	record(HIST_CONNECT, connect_us);
+	if (ok)
+		record(HIST_SEND, send_us);
+}
+
+/* Compact encoding for the METRICS broadcast:
+	"<uptime_s> <received per flag> <dropped per flag> <sent>/<failed> <histograms>"
+	Per-flag counters are in METRICS_FLAGS order, unknown last, '.'-separated.
+	Histograms are ','-separated in metrics_histogram order, each a '.'-separated list of <bucket>x<count> 
+	for the non-empty buckets, or '-' if empty.
+     *
+	 * return: encoded metrics, i.e. "3600 3.5.0.0.0.0.0.0.0.12.8.0.0.0 1.0.0.0.0.0.0.0.0.0.0.0.0.0 40/2 0x20.1x1,..."
+     */
+String ICACHE_FLASH_ATTR DEWDMetrics::encode(void) {
+	String res;
+	res += millis() / 1000;
+	res += ' ';
+	for (int i=0; i<METRICS_TYPES; i++) {
+		if (i > 0)
+			res += '.';
+		res += received[i];
+	}
+	res += ' ';
+	for (int i=0; i<METRICS_TYPES; i++) {
+		if (i > 0)
+			res += '.';
+		res += dropped[i];
+	}
+	res += ' ';
+	res += sent;
+	res += '/';
+	res += send_failed;
+	res += ' ';
+	for (int h=0; h<HIST_COUNT; h++) {
+		if (h > 0)
+			res += ',';
+		bool empty = true;
+		for (int b=0; b<METRICS_BUCKETS; b++) {
+			if (histograms[h].buckets[b] == 0)
+				continue;
+			if (!empty)
+				res += '.';
+			res += b;
+			res += 'x';
+			res += histograms[h].buckets[b];
+			empty = false;
+		}
+		if (empty)
+			res += '-';
+	}
+	return res;
+}
+
+/* One line per histogram: count, max and the upper bound in us of the bucket holding the median and the 99th percentile
+     *
+     */
+String ICACHE_FLASH_ATTR DEWDMetrics::print_histogram(int h) {
+	DEWDHistogram & hist = histograms[h];
+	String res = "\n ";
+	res += HIST_NAMES[h];
+	res += ": n=";
+	res += hist.count;
+	if (hist.count == 0)
+		return res;
+	
+	uint32_t seen = 0;
+	bool median_done = false;
+	for (int b=0; b<METRICS_BUCKETS; b++) {
+		seen += hist.buckets[b];
+		if (!median_done && seen * 2 >= hist.count) {
+			res += " p50<";
+			res += (uint32_t)128 << b;
+			median_done = true;
+		}
+		if (seen * 100 >= hist.count * 99) {
+			res += " p99<";
+			res += (uint32_t)128 << b;
+			break;
+		}
+	}
+	res += " max=";
+	res += hist.max_us;
+	res += " us";
+	return res;
+}
+
+String ICACHE_FLASH_ATTR DEWDMetrics::print_values(void) {
+	String res = " received:";
+	for (int i=0; i<METRICS_TYPES - 1; i++) {
+		res += ' ';
+		res += METRICS_FLAGS[i];
+		res += '=';
+		res += received[i];
+	}
+	res += " unknown=";
+	res += received[METRICS_TYPES - 1];
+	res += "\n dropped:";
+	for (int i=0; i<METRICS_TYPES - 1; i++) {
+		res += ' ';
+		res += METRICS_FLAGS[i];
+		res += '=';
+		res += dropped[i];
+	}
+	res += " unknown=";
+	res += dropped[METRICS_TYPES - 1];
+	res += "\n sent=";
+	res += sent;
+	res += " send_failed=";
+	res += send_failed;
+	if (sent > 0) {
+		res += " (";
+		res += send_failed * 100 / sent;
+		res += "%)";
+	}
+	for (int h=0; h<HIST_COUNT; h++)
+		res += print_histogram(h);
+	return res;
+}
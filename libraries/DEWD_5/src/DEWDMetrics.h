@@ -0,0 +1,59 @@
+/*
+ DEWDMetrics.h Header file defining the on-device counters and latency histograms.
+ Everything lives in fixed arrays, recording a value is a few integer operations and never allocates.
+ Histograms have log2 buckets in microseconds: bucket 0 holds values below 128 us, bucket k values 
+ from 2^(k+6) us up to 2^(k+7) us, and the last bucket everything above.
+ Created by agent, 2026.
+ 
+ */
+ 
+#ifndef DEWDMetrics_h
+#define DEWDMetrics_h
+
+#include <WString.h>
+
+	const int METRICS_BUCKETS = 16;								// last bucket starts at ~4.2 s
+	const char METRICS_FLAGS[] = "BRWMUCQPDHTYX";					// message types with their own counter, others count as unknown
+	const int METRICS_TYPES = sizeof(METRICS_FLAGS);			// incl. one for unknown flags
+
+	enum metrics_histogram {
+		HIST_HANDLE,											// ingress-to-handled time of a message, incl. its wait in the queue
+		HIST_SEND,												// TCP send incl. connect
+		HIST_CONNECT,											// TCP connect
+		HIST_SENSOR,											// sensor read
+		HIST_LOOP,												// one listen_to_ports() iteration
+		HIST_COUNT
+	};
+
+struct DEWDHistogram {
+	uint32_t buckets[METRICS_BUCKETS];
+	uint32_t count;
+	uint32_t max_us;
+};
+
+class DEWDMetrics
+{
+private:
+	int type(char flag);
+	String print_histogram(int h);
+
+public:
+	uint32_t received[METRICS_TYPES];							// messages handled per flag
+	uint32_t dropped[METRICS_TYPES];							// duplicates, overflows and unknown messages per flag
+	uint32_t sent = 0;											// TCP sends
+	uint32_t send_failed = 0;
+	DEWDHistogram histograms[HIST_COUNT];
+	
+	DEWDMetrics();
+	void reset();
+	void record(metrics_histogram h, uint32_t us);
+	void message(char flag, uint32_t us);
+	void drop(char flag);
+	void send_result(bool ok, uint32_t connect_us, uint32_t send_us);
+	String encode(void);
+	String print_values(void);
+};
+
+extern DEWDMetrics metrics;
+
+#endif
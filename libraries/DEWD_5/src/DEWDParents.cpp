@@ -0,0 +1,227 @@
+/*
+ DEWDParents.cpp Body file defining the table of candidate parents used when joining the mesh.
+ Created by agent, 2026.
+ 
+ */
+ 
+#include <Arduino.h>
+#include <DEWDParents.h>
+#include <DEWDLink.h>
+
+DEWDParentTable parents;
+
+static uint8_t dewd_oui[3] = {0x18, 0xFE, 0x34};					// Espressif OUI, the IE payload starts with DEWD_IE_VERSION
+
+static void ICACHE_FLASH_ATTR advert_received(user_ie_type, const uint8 sa[6], const uint8 m_oui[3], uint8 * ie, uint8 ie_len, sint32 rssi) {
+	if (memcmp(m_oui, dewd_oui, 3) != 0)
+		return;
+	parents.on_advert(sa, ie, ie_len, rssi);
+}
+
+ICACHE_FLASH_ATTR DEWDParentTable::DEWDParentTable() {
+}
+
+/* Start advertising as a root and listen to the adverts of other mesh APs
+     *
+     */
+void ICACHE_FLASH_ATTR DEWDParentTable::begin() {
+	uint8 own[6];
+	wifi_get_macaddr(STATION_IF, own);
+	advertise(0, 0, 0, MACAddress(own), 1);
+	wifi_register_user_ie_manufacturer_recv_cb(advert_received);
+}
+
+/* Put the own tree label and child load into the vendor IE of beacons and probe responses
+     *
+     */
+void ICACHE_FLASH_ATTR DEWDParentTable::advertise(uint8_t prio, uint8_t depth, uint8_t children, MACAddress root, uint8_t load) {
+	if (_ie[0] == DEWD_IE_VERSION && _ie[1] == prio && _ie[2] == depth && _ie[3] == children && root == _ie + 4 && _ie[10] == own_subnet 
+		&& _ie[11] == load)
+		return;														// unchanged
+	_ie[0] = DEWD_IE_VERSION;
+	_ie[1] = prio;
+	_ie[2] = depth;
+	_ie[3] = children;
+	for (int i=0; i<6; i++)
+		_ie[4 + i] = root[i];
+	_ie[10] = own_subnet;
+	_ie[11] = load;
+	wifi_set_user_ie(true, dewd_oui, USER_IE_BEACON, _ie, DEWD_IE_LEN);
+	wifi_set_user_ie(true, dewd_oui, USER_IE_PROBE_RESP, _ie, DEWD_IE_LEN);
+}
+
+DEWDParent * ICACHE_FLASH_ATTR DEWDParentTable::find_or_add(const uint8_t * bssid) {
+	int oldest = 0;
+	for (int i=0; i<_count; i++) {
+		if (memcmp(_parents[i].bssid, bssid, 6) == 0)
+			return &_parents[i];
+		if ((long)(_parents[i].seen_ms - _parents[oldest].seen_ms) < 0)
+			oldest = i;
+	}
+	int i = _count < MAX_PARENTS ? _count++ : oldest;				// table full - reuse the stalest entry
+	memcpy(_parents[i].bssid, bssid, 6);
+	_parents[i].channel = 0;
+	_parents[i].advertised = false;
+	_parents[i].subnet = 0;
+	_parents[i].load = 0;
+	return &_parents[i];
+}
+
+/* Store an advert received in a beacon or probe response. Depending on the SDK version ie either 
+	points to the payload or to the whole vendor IE (element id 221, length, OUI, payload).
+     *
+     */
+void ICACHE_FLASH_ATTR DEWDParentTable::on_advert(const uint8_t * bssid, const uint8_t * ie, uint8_t len, int rssi) {
+	if (len >= DEWD_IE_LEN_V1 + 5 && ie[0] == 221 && memcmp(ie + 2, dewd_oui, 3) == 0) {
+		ie += 5;
+		len -= 5;
+	}
+	if (len < DEWD_IE_LEN_V1 || ie[0] < 1 || ie[0] > DEWD_IE_VERSION)
+		return;
+	
+	DEWDParent * p = find_or_add(bssid);
+	p->advertised = true;
+	p->prio = ie[1];
+	p->depth = ie[2];
+	p->children = ie[3];
+	p->root = ie + 4;
+	p->subnet = ie[0] >= 2 && len >= DEWD_IE_LEN_V2 ? ie[10] : 0;
+	p->load = ie[0] >= 3 && len >= DEWD_IE_LEN ? ie[11] : 0;
+	p->rssi = rssi;
+	p->seen_ms = millis();
+}
+
+void ICACHE_FLASH_ATTR DEWDParentTable::on_scan_result(const uint8_t * bssid, uint8_t channel, int rssi) {
+	DEWDParent * p = find_or_add(bssid);
+	p->channel = channel;
+	p->rssi = rssi;
+	p->seen_ms = millis();
+}
+
+/* Cost of joining a candidate: hops to the root, child load, the size of the root's subtree, weak 
+	signal and a lossy link, if this node has sent over it before, all add to it
+     *
+	 * return: cost, lower is better
+     */
+int ICACHE_FLASH_ATTR DEWDParentTable::cost(DEWDParent * p) {
+	int c = 0;
+	if (p->advertised) {
+		c += (p->depth + 1) * JOIN_COST_HOP;
+		c += p->children * JOIN_COST_CHILD;
+		c += p->load * JOIN_COST_LOAD;
+		if (p->prio != 0)
+			c += JOIN_COST_NO_ROOT;
+	}
+	else
+		c += (JOIN_UNKNOWN_DEPTH + 1) * JOIN_COST_HOP;
+	if (p->rssi < JOIN_RSSI_GOOD)
+		c += JOIN_RSSI_GOOD - p->rssi;
+	c += (links.etx_mac(p->bssid) - 100) * JOIN_COST_HOP / 100;	// every expected retransmission costs a hop
+	return c;
+}
+
+/* Pick the cheapest candidate that was seen in a recent scan. Candidates that are full, too weak, 
+	or advertise this node as their root (they are in its own subtree) are skipped.
+     *
+	 * param own: STA MAC of this node
+	 * return: pointer to the candidate, or NULL if there is none
+     */
+DEWDParent * ICACHE_FLASH_ATTR DEWDParentTable::best(MACAddress own) {
+	DEWDParent * best = NULL;
+	for (int i=0; i<_count; i++) {
+		DEWDParent * p = &_parents[i];
+		if (p->channel == 0 || millis() - p->seen_ms > PARENT_MAX_AGE)
+			continue;
+		if (p->rssi < JOIN_RSSI_MIN)
+			continue;
+		if (p->advertised && (p->children >= JOIN_MAX_CHILDREN || own == p->root))
+			continue;
+		if (best == NULL || cost(p) < cost(best))
+			best = p;
+	}
+	return best;
+}
+
+/* Count the candidates a node could join now: recently seen, advertising a path to a root and 
+	room for another child. A detached node keeps its softAP up, so this grows when the tree does, 
+	unlike the number of mesh APs in a scan.
+     *
+	 * return: number of such candidates
+     */
+int ICACHE_FLASH_ATTR DEWDParentTable::joinable() {
+	int n = 0;
+	for (int i=0; i<_count; i++) {
+		DEWDParent * p = &_parents[i];
+		if (p->advertised && p->prio == 0 && p->children < JOIN_MAX_CHILDREN && millis() - p->seen_ms <= PARENT_MAX_AGE)
+			n++;
+	}
+	return n;
+}
+
+/* Collect the softAP subnets advertised by recently seen mesh APs
+     *
+	 * param out: array of at least MAX_PARENTS entries
+	 * return: number of subnets written to out
+     */
+int ICACHE_FLASH_ATTR DEWDParentTable::subnets(uint8_t * out) {
+	int n = 0;
+	for (int i=0; i<_count; i++) {
+		if (_parents[i].subnet != 0 && millis() - _parents[i].seen_ms <= PARENT_MAX_AGE)
+			out[n++] = _parents[i].subnet;
+	}
+	return n;
+}
+
+/* Find a recently seen mesh AP that advertises a given softAP subnet
+     *
+	 * return: pointer to the candidate, or NULL if there is none
+     */
+DEWDParent * ICACHE_FLASH_ATTR DEWDParentTable::find_subnet(uint8_t subnet) {
+	for (int i=0; i<_count; i++) {
+		if (_parents[i].subnet == subnet && millis() - _parents[i].seen_ms <= PARENT_MAX_AGE)
+			return &_parents[i];
+	}
+	return NULL;
+}
+
+String ICACHE_FLASH_ATTR DEWDParentTable::print_values(void) {
+	String res = " candidates=";
+	res += _count;
+	for (int i=0; i<_count; i++) {
+		DEWDParent * p = &_parents[i];
+		res += "\n	";
+		for (int j=0; j<5; j++) {
+			res += String(p->bssid[j], HEX);
+			res += ':';
+		}
+		res += String(p->bssid[5], HEX);
+		res += " ch=";
+		res += p->channel;
+		res += " rssi=";
+		res += p->rssi;
+		if (p->advertised) {
+			res += " prio=";
+			res += p->prio;
+			res += " depth=";
+			res += p->depth;
+			res += " children=";
+			res += p->children;
+			if (p->subnet != 0) {
+				res += " subnet=";
+				res += p->subnet;
+			}
+			if (p->load != 0) {
+				res += " root_load=";
+				res += p->load;
+			}
+		}
+		else
+			res += " (no advert)";
+		res += " cost=";
+		res += cost(p);
+		res += " age=";
+		res += (millis() - p->seen_ms) / 1000;
+		res += "s";
+	}
+	return res;
+}
@@ -0,0 +1,78 @@
+/*
+ DEWDParents.h Header file defining the table of candidate parents used when joining the mesh.
+ Every mesh AP advertises its tree label and child load in a vendor IE of its beacons and probe 
+ responses. Together with the RSSI and channel from the scan this gives a cost per candidate, and 
+ the node connects to the BSSID and channel of the cheapest one instead of whatever AP the SDK picks. 
+ With several gateway roots the advert also carries the size of the root's subtree, so joining 
+ nodes spread over the roots instead of all piling onto the nearest one.
+ Created by agent, 2026.
+ 
+ */
+ 
+#ifndef DEWDParents_h
+#define DEWDParents_h
+
+#include <MACAddress.h>
+#include <WString.h>
+extern "C" {
+#include "user_interface.h"
+}
+
+	const int MAX_PARENTS = 8;										// nr of candidate parents remembered
+	const unsigned long PARENT_MAX_AGE = 30000;						// candidates not seen for this many ms are not considered
+	
+	const int JOIN_COST_HOP = 10;									// cost of every hop between candidate and root
+	const int JOIN_COST_CHILD = 4;									// cost of every child already attached to the candidate
+	const int JOIN_COST_NO_ROOT = 60;								// extra cost of a candidate on a loop without root
+	const int JOIN_UNKNOWN_DEPTH = 4;								// depth assumed for candidates whose advert was not received
+	const int JOIN_RSSI_GOOD = -55;									// every dB below this costs 1
+	const int JOIN_RSSI_MIN = -85;									// weaker candidates are not considered
+	const int JOIN_MAX_CHILDREN = 4;								// softAP connection limit
+	const int JOIN_COST_LOAD = 1;									// cost of every node already in the candidate root's subtree
+	
+	const uint8_t DEWD_IE_VERSION = 3;
+	const uint8_t DEWD_IE_LEN = 12;									// version, prio, depth, children, root MAC, softAP subnet, root load
+	const uint8_t DEWD_IE_LEN_V2 = 11;								// version 2 adverts carry no root load
+	const uint8_t DEWD_IE_LEN_V1 = 10;								// version 1 adverts carry no subnet
+
+struct DEWDParent {
+	uint8_t bssid[6];												// softAP MAC of the candidate
+	uint8_t channel;												// 0 if the candidate was not seen in a scan
+	int rssi;
+	bool advertised;												// true once the vendor IE of the candidate was received
+	uint8_t prio;													// advertised tree label and load
+	uint8_t depth;
+	uint8_t children;
+	MACAddress root;
+	uint8_t subnet;													// advertised softAP subnet, 192.168.<subnet>.1, 0 if unknown
+	uint8_t load;													// nodes in the subtree of the advertised root, 0 if unknown
+	unsigned long seen_ms;
+};
+
+class DEWDParentTable
+{
+private:
+	DEWDParent _parents[MAX_PARENTS];
+	int _count = 0;
+	uint8_t _ie[DEWD_IE_LEN];
+	
+	DEWDParent * find_or_add(const uint8_t * bssid);
+
+public:
+	uint8_t own_subnet = 0;											// softAP subnet put into the own advert
+	
+	DEWDParentTable();
+	void begin();
+	void advertise(uint8_t prio, uint8_t depth, uint8_t children, MACAddress root, uint8_t load);
+	void on_advert(const uint8_t * bssid, const uint8_t * ie, uint8_t len, int rssi);
+	void on_scan_result(const uint8_t * bssid, uint8_t channel, int rssi);
+	int cost(DEWDParent * p);
+	DEWDParent * best(MACAddress own);
+	int joinable();
+	int subnets(uint8_t * out);
+	DEWDParent * find_subnet(uint8_t subnet);
+	String print_values(void);
+};
+
+extern DEWDParentTable parents;
+#endif
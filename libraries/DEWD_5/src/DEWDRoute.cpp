@@ -0,0 +1,168 @@
+/*
+ DEWDRoute.cpp Body file defining the route cache used for multi-hop MAC-addressed unicast.
+ Created by agent, 2026.
+ 
+ */
+ 
+#include <Arduino.h>
+#include <DEWDRoute.h>
+
+ICACHE_FLASH_ATTR DEWDRouteTable::DEWDRouteTable() {
+	for (int i=0; i<MAX_PENDING; i++)
+		_pending[i].used = false;
+	for (int i=0; i<SEEN_REQUESTS; i++)
+		_seen_id[i] = 0;
+}
+
+int DEWDRouteTable::find_index(MACAddress dest) {
+	for (int i=0; i<_count; i++) {
+		if (dest == _routes[i].dest)
+			return i;
+	}
+	return -1;
+}
+
+/* Look up a valid route. Using a route extends its lifetime.
+     *
+	 * param dest: STA MAC of the destination
+	 * return: pointer to the route, or NULL if there is no route or it has expired
+     */
+DEWDRoute * DEWDRouteTable::find(MACAddress dest) {
+	int i = find_index(dest);
+	if (i < 0 || (long)(millis() - _routes[i].expires) >= 0)
+		return NULL;
+	_routes[i].expires = millis() + ROUTE_LIFETIME;
+	return &_routes[i];
+}
+
+/* Install or refresh a route. An existing valid route is only replaced by a fresher one 
+	(higher sequence nr) or an equally fresh but cheaper one.
+     *
+	 * param cost: sum of the ETX of the links along the route, see route_cost() in DEWDComm.h
+	 * return: true if the table was changed
+     */
+bool ICACHE_FLASH_ATTR DEWDRouteTable::update(MACAddress dest, IPAddress next_hop, uint8_t hops, uint16_t seq, uint16_t cost) {
+	int i = find_index(dest);
+	
+	if (i >= 0 && (long)(millis() - _routes[i].expires) < 0) {
+		int16_t newer = (int16_t)(seq - _routes[i].seq);			// wrap-around safe comparison
+		if (newer < 0 || (newer == 0 && cost >= _routes[i].cost)) {
+			if (_routes[i].next_hop == next_hop)
+				_routes[i].expires = millis() + ROUTE_LIFETIME;
+			return false;
+		}
+	}
+	else if (i < 0) {
+		if (_count < MAX_ROUTES)
+			i = _count++;
+		else {														// table full - replace the route closest to expiry
+			i = 0;
+			for (int j=1; j<_count; j++) {
+				if ((long)(_routes[j].expires - _routes[i].expires) < 0)
+					i = j;
+			}
+		}
+	}
+	_routes[i].dest = dest;
+	_routes[i].next_hop = next_hop;
+	_routes[i].hops = hops;
+	_routes[i].cost = cost;
+	_routes[i].seq = seq;
+	_routes[i].expires = millis() + ROUTE_LIFETIME;
+	return true;
+}
+
+/* Drop every route through a neighbour that could not be reached.
+     *
+     */
+void ICACHE_FLASH_ATTR DEWDRouteTable::remove_next_hop(IPAddress next_hop) {
+	for (int i=0; i<_count; ) {
+		if (_routes[i].next_hop == next_hop)
+			_routes[i] = _routes[--_count];
+		else
+			i++;
+	}
+}
+
+/* Duplicate detection for flooded route requests.
+     *
+	 * return: true if the request has been seen before, otherwise it is remembered and false is returned
+     */
+bool ICACHE_FLASH_ATTR DEWDRouteTable::seen_request(MACAddress orig, uint8_t id) {
+	for (int i=0; i<SEEN_REQUESTS; i++) {
+		if (_seen_id[i] == id && orig == _seen_orig[i])
+			return true;
+	}
+	_seen_orig[_seen_next] = orig;
+	_seen_id[_seen_next] = id;
+	_seen_next = (_seen_next + 1) % SEEN_REQUESTS;
+	return false;
+}
+
+/* Park a unicast until a route to its destination has been discovered.
+     *
+	 * return: false if all pending slots are taken
+     */
+bool ICACHE_FLASH_ATTR DEWDRouteTable::queue(MACAddress dest, String payload, uint8_t id) {
+	for (int i=0; i<MAX_PENDING; i++) {
+		if (!_pending[i].used) {
+			_pending[i].dest = dest;
+			_pending[i].payload = payload;
+			_pending[i].id = id;
+			_pending[i].retries = 0;
+			_pending[i].sent_ms = millis();
+			_pending[i].used = true;
+			return true;
+		}
+	}
+	return false;
+}
+
+DEWDPendingUnicast * DEWDRouteTable::get_pending(int i) {
+	if (i < 0 || i >= MAX_PENDING || !_pending[i].used)
+		return NULL;
+	return &_pending[i];
+}
+
+int DEWDRouteTable::count() {
+	return _count;
+}
+
+String ICACHE_FLASH_ATTR DEWDRouteTable::print_values(void) {
+	String res = " routes=";
+	res += _count;
+	
+	for (int i=0; i<_count; i++) {
+		res += "\n	";
+		for (int j=0; j<5; j++) {
+			res += String(_routes[i].dest[j], HEX);
+			res += ':';
+		}
+		res += String(_routes[i].dest[5], HEX);
+		res += " via ";
+		for (int j=0; j<3; j++) {
+			res += _routes[i].next_hop[j];
+			res += '.';
+		}
+		res += _routes[i].next_hop[3];
+		res += " hops=";
+		res += _routes[i].hops;
+		res += " cost=";
+		res += _routes[i].cost;
+		res += " seq=";
+		res += _routes[i].seq;
+		if ((long)(millis() - _routes[i].expires) >= 0)
+			res += " (expired)";
+	}
+	res += "\n rreq_sent=";
+	res += rreq_sent;
+	res += " rrep_sent=";
+	res += rrep_sent;
+	res += " data_sent=";
+	res += data_sent;
+	res += " data_delivered=";
+	res += data_delivered;
+	res += " data_dropped=";
+	res += data_dropped;
+	return res;
+}
@@ -0,0 +1,77 @@
+/*
+ DEWDRoute.h Header file defining the route cache used for multi-hop MAC-addressed unicast.
+ Routes are discovered on demand in the style of AODV: a route request (flag 'Q') is flooded, 
+ every node it passes sets up a reverse route towards the originator, and the route reply 
+ (flag 'P') travels back along that reverse path setting up the forward route.
+ Created by agent, 2026.
+ 
+ */
+ 
+#ifndef DEWDRoute_h
+#define DEWDRoute_h
+
+#include <MACAddress.h>
+#include <IPAddress.h>
+#include <WString.h>
+
+	const int MAX_ROUTES = 16;										// size of the route cache
+	const int MAX_PENDING = 4;										// unicasts that may wait for route discovery at the same time
+	const int SEEN_REQUESTS = 8;									// route requests remembered for duplicate detection
+	const unsigned long ROUTE_LIFETIME = 60000;						// ms a route stays valid after it was last used or refreshed
+	const unsigned long RREQ_TIMEOUT = 3000;						// ms to wait for a route reply before retrying
+	const int RREQ_RETRIES = 2;										// route requests resent before giving up on a destination
+	const int ROUTE_TTL = 16;										// max nr of hops a unicast is forwarded
+
+struct DEWDRoute {
+	MACAddress dest;												// STA MAC of the destination node
+	IPAddress next_hop;												// neighbour the packet is handed to
+	uint8_t hops;													// distance to dest
+	uint16_t cost;													// sum of the ETX of the links to dest, x100
+	uint16_t seq;													// destination sequence nr, higher is fresher
+	unsigned long expires;											// millis() after which the route is stale
+};
+
+struct DEWDPendingUnicast {
+	MACAddress dest;
+	String payload;
+	uint8_t id;
+	uint8_t retries;
+	unsigned long sent_ms;											// millis() of the last route request for dest
+	bool used;
+};
+
+class DEWDRouteTable
+{
+private:
+	DEWDRoute _routes[MAX_ROUTES];
+	int _count = 0;
+	
+	MACAddress _seen_orig[SEEN_REQUESTS];							// ring of recently seen (originator, id) route requests
+	uint8_t _seen_id[SEEN_REQUESTS];
+	int _seen_next = 0;
+	
+	DEWDPendingUnicast _pending[MAX_PENDING];
+	
+	int find_index(MACAddress dest);
+
+public:
+	uint16_t own_seq = 0;											// this nodes destination sequence nr
+	
+	uint16_t rreq_sent = 0;											// statistics, see print_values()
+	uint16_t rrep_sent = 0;
+	uint16_t data_sent = 0;
+	uint16_t data_delivered = 0;
+	uint16_t data_dropped = 0;
+	
+	DEWDRouteTable();
+	DEWDRoute * find(MACAddress dest);
+	bool update(MACAddress dest, IPAddress next_hop, uint8_t hops, uint16_t seq, uint16_t cost);
+	void remove_next_hop(IPAddress next_hop);
+	bool seen_request(MACAddress orig, uint8_t id);
+	bool queue(MACAddress dest, String payload, uint8_t id);
+	DEWDPendingUnicast * get_pending(int i);
+	int count();
+	String print_values(void);
+};
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ DEWDRtc.cpp Body file defining the link state kept in RTC user memory.
+ Created by agent, 2026.
+ 
+ */
+ 
+#include <Arduino.h>
+#include <DEWDRtc.h>
+extern "C" {
+#include "user_interface.h"
+}
+
+DEWDRtc rtc;
+
+ICACHE_FLASH_ATTR DEWDRtc::DEWDRtc() {
+	memset(&state, 0, sizeof(state));
+}
+
+/* CRC-32 over the state, excluding the crc field itself
+     *
+     */
+uint32_t ICACHE_FLASH_ATTR DEWDRtc::checksum() {
+	const uint8_t * data = reinterpret_cast<const uint8_t*>(&state);
+	uint32_t crc = 0xFFFFFFFF;
+	
+	for (size_t i=0; i<sizeof(state) - sizeof(state.crc); i++) {
+		crc ^= data[i];
+		for (int b=0; b<8; b++)
+			crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+	}
+	return ~crc;
+}
+
+/* Restore the state from RTC memory. Call once at boot, before setup_mesh() and connect_to_mesh().
+     *
+	 * return: true if a valid state was found
+     */
+bool ICACHE_FLASH_ATTR DEWDRtc::load() {
+	system_rtc_mem_read(RTC_OFFSET, &state, sizeof(state));
+	valid = state.magic == RTC_MAGIC && state.crc == checksum();
+	restored = valid;
+	rejoin = valid && state.parent_channel != 0;
+	if (!valid)
+		memset(&state, 0, sizeof(state));
+	return valid;
+}
+
+void ICACHE_FLASH_ATTR DEWDRtc::save() {
+	state.magic = RTC_MAGIC;
+	state.crc = checksum();
+	system_rtc_mem_write(RTC_OFFSET, &state, sizeof(state));
+	valid = true;
+}
+
+/* Remember the current parent after a successful connect
+     *
+     */
+void ICACHE_FLASH_ATTR DEWDRtc::save_link(const uint8_t * bssid, uint8_t channel) {
+	memcpy(state.parent_bssid, bssid, 6);
+	state.parent_channel = channel;
+	save();
+}
+
+/* Drop the cached parent, e.g. because the fast rejoin failed. The next connect scans again.
+     *
+     */
+void ICACHE_FLASH_ATTR DEWDRtc::forget_parent() {
+	state.parent_channel = 0;
+	save();
+}
+
+/* Remember a handled broadcast. Written to RTC memory with the next save().
+     *
+	 * param id: broadcast id
+	 * param origin: STA MAC of the originator
+     */
+void DEWDRtc::note_broadcast(uint8_t id, MACAddress origin) {
+	state.seen_ids[state.seen_next] = id;
+	for (int i=0; i<3; i++)
+		state.seen_origins[state.seen_next][i] = origin[3 + i];
+	state.seen_next = (state.seen_next + 1) % RTC_SEEN_IDS;
+}
+
+/* Whether a broadcast was already handled before the last sleep or reset, so that e.g. 
+	a DEEP_SLEEP broadcast arriving again over another path is not executed twice. The id alone 
+	would reject about one new broadcast in twenty, the originator makes a match certain.
+     *
+	 * param id: broadcast id
+	 * param origin: STA MAC of the originator
+     */
+bool DEWDRtc::seen_before_wake(uint8_t id, MACAddress origin) {
+	if (!restored || millis() > SEEN_ID_GRACE)
+		return false;
+	for (int i=0; i<RTC_SEEN_IDS; i++) {
+		if (state.seen_ids[i] == id && state.seen_origins[i][0] == origin[3] 
+				&& state.seen_origins[i][1] == origin[4] && state.seen_origins[i][2] == origin[5])
+			return true;
+	}
+	return false;
+}
+
+void DEWDRtc::note_forward() {
+	if (first_forward_ms == 0)
+		first_forward_ms = millis();
+}
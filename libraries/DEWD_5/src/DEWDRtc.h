@@ -0,0 +1,62 @@
+/*
+ DEWDRtc.h Header file defining the link state kept in RTC user memory.
+ RTC memory survives deep sleep and software resets, so a node can rejoin its last parent on the 
+ cached BSSID and channel without scanning, and rebuild its softAP on the same subnet and channel so 
+ that its own children find it again. The lease is not cached: the parent may have handed the address 
+ to another node meanwhile, DHCP confirms it. The state is protected by a checksum.
+ Created by agent, 2026.
+ 
+ */
+ 
+#ifndef DEWDRtc_h
+#define DEWDRtc_h
+
+#include <MACAddress.h>
+#include <WString.h>
+
+	const uint8_t RTC_OFFSET = 64;									// first 4-byte block of RTC user memory
+	const uint32_t RTC_MAGIC = 0x44455744;							// "DEWD"
+	const int RTC_SEEN_IDS = 8;										// nr of handled broadcasts kept across sleep
+	const unsigned long SEEN_ID_GRACE = 30000;						// ms after boot during which the kept ids are treated as duplicates
+
+struct DEWDRtcState {
+	uint32_t magic;
+	uint8_t parent_bssid[6];										// last parent, parent_channel = 0 if none
+	uint8_t parent_channel;
+	uint8_t ap_channel;												// own softAP, ap_subnet = 0 if not set up
+	uint8_t ap_subnet;												// 192.168.<ap_subnet>.1
+	uint8_t seen_next;
+	uint8_t seen_ids[RTC_SEEN_IDS];									// handled broadcasts: id and the last 3 octets of the originator's MAC
+	uint8_t seen_origins[RTC_SEEN_IDS][3];
+	uint8_t sleep_scheduled;										// 1 if the node went to sleep on the duty-cycle schedule
+	uint8_t sleep_anchored;											// 1 if sleep_anchor_ms is known
+	uint32_t sleep_period_ms;										// duty-cycle schedule, see DEWDSleep.h
+	uint32_t sleep_awake_ms;
+	uint32_t sleep_anchor_ms;										// mesh time at which a wake window started
+	uint32_t crc;
+};
+
+class DEWDRtc
+{
+private:
+	uint32_t checksum();
+
+public:
+	DEWDRtcState state;
+	bool valid = false;												// true if state was restored from RTC memory
+	bool restored = false;											// true if the last load() found a valid state
+	bool rejoin = false;											// true until the cached parent has been tried once after boot
+	unsigned long first_forward_ms = 0;								// millis() of the first packet forwarded since boot
+	
+	DEWDRtc();
+	bool load();
+	void save();
+	void save_link(const uint8_t * bssid, uint8_t channel);
+	void forget_parent();
+	void note_broadcast(uint8_t id, MACAddress origin);
+	bool seen_before_wake(uint8_t id, MACAddress origin);
+	void note_forward();
+};
+
+extern DEWDRtc rtc;
+#endif
@@ -0,0 +1,154 @@
+/*
+ DEWDScan.cpp Body file defining the WiFi scan cache.
+ Created by agent, 2026.
+ 
+ */
+ 
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <DEWDScan.h>
+
+DEWDScanCache scans;
+
+ICACHE_FLASH_ATTR DEWDScanCache::DEWDScanCache() {
+}
+
+/* Start a background scan, unless one is running already
+     *
+	 * return: true if a scan is running now
+     */
+bool ICACHE_FLASH_ATTR DEWDScanCache::start() {
+	if (_running)
+		return true;
+	WiFi.scanNetworks(true);
+	_running = WiFi.scanComplete() == -1;							// -1: scan running
+	return _running;
+}
+
+/* Poll the background scan. Called once per main-loop iteration.
+     *
+	 * return: true if new results have arrived
+     */
+bool DEWDScanCache::update() {
+	if (!_running)
+		return false;
+	int n = WiFi.scanComplete();
+	if (n == -1)													// still running
+		return false;
+	_running = false;
+	if (n < 0)														// scan failed
+		return false;
+	collect(n);
+	return true;
+}
+
+/* Scan and wait for the results. Only for when there is nothing to forward yet, i.e. the channel choice at boot.
+     *
+     */
+void ICACHE_FLASH_ATTR DEWDScanCache::scan_now() {
+	_running = false;
+	collect(WiFi.scanNetworks());
+}
+
+/* Copy the results of a finished scan, the strongest APs first, and free the SDK's copy
+     *
+	 * param n: number of APs found
+     */
+void ICACHE_FLASH_ATTR DEWDScanCache::collect(int n) {
+	_count = 0;
+	for (int i=0; i<n; i++) {
+		int8_t rssi = WiFi.RSSI(i);
+		int pos = _count;
+		while (pos > 0 && _results[pos - 1].rssi < rssi)			// insertion sort by RSSI
+			pos--;
+		if (pos >= SCAN_MAX_RESULTS)
+			continue;
+		if (_count == SCAN_MAX_RESULTS)
+			_count--;												// weakest one drops out
+		memmove(&_results[pos + 1], &_results[pos], (_count - pos) * sizeof(DEWDScanResult));
+		_count++;
+		
+		DEWDScanResult & r = _results[pos];
+		strncpy(r.ssid, WiFi.SSID(i).c_str(), sizeof(r.ssid) - 1);
+		r.ssid[sizeof(r.ssid) - 1] = '\0';
+		memcpy(r.bssid, WiFi.BSSID(i), 6);
+		r.channel = WiFi.channel(i);
+		r.rssi = rssi;
+	}
+	WiFi.scanDelete();
+	valid = true;
+	scanned_ms = millis();
+	scans++;
+}
+
+/* Start a background scan if the cached results are older than max_age
+     *
+     */
+void ICACHE_FLASH_ATTR DEWDScanCache::request(unsigned long max_age) {
+	if (!fresh(max_age))
+		start();
+}
+
+bool DEWDScanCache::fresh(unsigned long max_age) {
+	return valid && age() <= max_age;
+}
+
+bool DEWDScanCache::running() {
+	return _running;
+}
+
+/* return: ms since the results were taken
+     */
+unsigned long DEWDScanCache::age() {
+	return millis() - scanned_ms;
+}
+
+int DEWDScanCache::count() {
+	return _count;
+}
+
+DEWDScanResult * DEWDScanCache::get(int i) {
+	if (i < 0 || i >= _count)
+		return NULL;
+	return &_results[i];
+}
+
+bool ICACHE_FLASH_ATTR DEWDScanCache::has_ssid(const char * ssid) {
+	for (int i=0; i<_count; i++) {
+		if (!strcmp(_results[i].ssid, ssid))
+			return true;
+	}
+	return false;
+}
+
+String ICACHE_FLASH_ATTR DEWDScanCache::print_values(void) {
+	String res;
+	if (!valid) {
+		res = _running ? " first scan running" : " no scan yet";
+		return res;
+	}
+	res = " ";
+	res += _count;
+	res += " APs, scanned ";
+	res += age() / 1000;
+	res += " s ago";
+	if (_running)
+		res += ", new scan running";
+	for (int i=0; i<_count; i++) {
+		res += "\n ";
+		res += i + 1;
+		res += ". ";
+		res += _results[i].ssid;
+		res += " (";
+		res += _results[i].rssi;
+		res += ") ch=";
+		res += _results[i].channel;
+		res += " ";
+		for (int j=0; j<6; j++) {
+			res += String(_results[i].bssid[j], HEX);
+			if (j < 5)
+				res += ':';
+		}
+	}
+	return res;
+}
@@ -0,0 +1,55 @@
+/*
+ DEWDScan.h Header file defining the WiFi scan cache.
+ Scans run in the background (WiFi.scanNetworks(true)) and their results are kept with the time 
+ they were taken, so queries about the APs in range are answered from the cache instead of blocking 
+ the node for the one to two seconds a scan takes.
+ Created by agent, 2026.
+ 
+ */
+ 
+#ifndef DEWDScan_h
+#define DEWDScan_h
+
+#include <WString.h>
+
+	const int SCAN_MAX_RESULTS = 16;								// APs kept from a scan, the strongest ones
+	const unsigned long SCAN_MAX_AGE = 20000;						// ms a scan result is good for queries
+
+struct DEWDScanResult {
+	char ssid[33];
+	uint8_t bssid[6];
+	uint8_t channel;
+	int8_t rssi;
+};
+
+class DEWDScanCache
+{
+private:
+	DEWDScanResult _results[SCAN_MAX_RESULTS];
+	int _count = 0;
+	bool _running = false;
+	
+	void collect(int n);
+
+public:
+	bool valid = false;												// true once a scan has completed
+	unsigned long scanned_ms = 0;									// millis() when the results were taken
+	uint16_t scans = 0;
+	
+	DEWDScanCache();
+	bool start();
+	bool update();
+	void scan_now();
+	void request(unsigned long max_age);
+	bool fresh(unsigned long max_age);
+	bool running();
+	unsigned long age();
+	int count();
+	DEWDScanResult * get(int i);
+	bool has_ssid(const char * ssid);
+	String print_values(void);
+};
+
+extern DEWDScanCache scans;
+
+#endif
@@ -0,0 +1,147 @@
+/*
+ DEWDSleep.cpp Body file defining the mesh-wide duty-cycling schedule.
+ Created by agent, 2026.
+ 
+ */
+ 
+#include <Arduino.h>
+#include <DEWDSleep.h>
+
+ICACHE_FLASH_ATTR DEWDSleepSchedule::DEWDSleepSchedule() {
+}
+
+/* Start a schedule whose first wake window begins at now
+     *
+	 * param period: length of a cycle in ms, 0 turns duty cycling off
+	 * param awake: length of the wake window in ms
+	 * param now: current time in ms
+     */
+void ICACHE_FLASH_ATTR DEWDSleepSchedule::set(unsigned long period, unsigned long awake, unsigned long now) {
+	if (awake >= period)											// always awake, nothing to schedule
+		period = 0;
+	period_ms = period;
+	awake_ms = awake;
+	anchor_ms = now;
+	mesh_anchored = false;
+	last_resync_ms = 0;
+}
+
+/* Tie the schedule to the mesh clock, it follows from the next resync() on
+     *
+	 * param mesh_anchor: mesh time at which a wake window started or starts
+     */
+void ICACHE_FLASH_ATTR DEWDSleepSchedule::set_mesh_anchor(unsigned long mesh_anchor) {
+	mesh_anchor_ms = mesh_anchor;
+	mesh_anchored = true;
+}
+
+/* Move the local anchor onto the mesh anchor. Call after every mesh clock sync.
+     *
+	 * param mesh_now: current mesh time in ms
+	 * param now: current local time in ms
+     */
+void ICACHE_FLASH_ATTR DEWDSleepSchedule::resync(unsigned long mesh_now, unsigned long now) {
+	if (!active() || !mesh_anchored)
+		return;
+	long since = (long)(mesh_now - mesh_anchor_ms) % (long)period_ms;	// the anchor may lie ahead, phase is taken modulo anyway
+	if (since < 0)
+		since += period_ms;
+	unsigned long anchor = now - since;
+	long shift = (long)(anchor - anchor_ms) % (long)period_ms;
+	if (shift > (long)period_ms / 2)								// report the smaller of the two ways round
+		shift -= period_ms;
+	else if (shift < -(long)period_ms / 2)
+		shift += period_ms;
+	last_resync_ms = shift;
+	anchor_ms = anchor;
+}
+
+bool DEWDSleepSchedule::active() {
+	return period_ms != 0;
+}
+
+bool DEWDSleepSchedule::in_window(unsigned long now) {
+	return !active() || (now - anchor_ms) % period_ms < awake_ms;
+}
+
+/* return: ms until the next wake window starts, 0 while in a window
+     */
+unsigned long DEWDSleepSchedule::until_window(unsigned long now) {
+	if (in_window(now))
+		return 0;
+	return period_ms - (now - anchor_ms) % period_ms;
+}
+
+/* Decide whether a node may go to sleep now
+     *
+	 * param now: current time in ms
+	 * param relay: true if the node has children it forwards to
+	 * param busy: true if the node still waits for responses
+	 * param has_answered: true if the node has answered a broadcast in this window
+	 * return: ms to sleep, 0 to stay awake
+     */
+unsigned long ICACHE_FLASH_ATTR DEWDSleepSchedule::sleep_time(unsigned long now, bool relay, bool busy, bool has_answered) {
+	if (!active())
+		return 0;
+	
+	unsigned long phase = (now - anchor_ms) % period_ms;
+	if (phase < awake_ms) {											// in the window only answered edge nodes sleep
+		if (relay || busy || !has_answered)
+			return 0;
+	}
+	else if (busy && phase < awake_ms + SLEEP_RELAY_HOLD)			// still forwarding, hold on a bit
+		return 0;
+	
+	unsigned long next = period_ms - phase;
+	if (next < SLEEP_WAKE_LEAD + SLEEP_MIN)
+		return 0;
+	return next - SLEEP_WAKE_LEAD;
+}
+
+void ICACHE_FLASH_ATTR DEWDSleepSchedule::query_started() {
+	queries++;
+}
+
+void ICACHE_FLASH_ATTR DEWDSleepSchedule::query_done(unsigned long latency) {
+	answered++;
+	latency_sum_ms += latency;
+	if (latency > latency_max_ms)
+		latency_max_ms = latency;
+}
+
+String ICACHE_FLASH_ATTR DEWDSleepSchedule::print_values(unsigned long now) {
+	String res = " period_ms=";
+	res += period_ms;
+	res += " awake_ms=";
+	res += awake_ms;
+	if (active()) {
+		res += " duty=";
+		res += awake_ms * 100 / period_ms;
+		res += "%";
+		res += in_window(now) ? " (in window)" : " (next window in ";
+		if (!in_window(now)) {
+			res += until_window(now);
+			res += " ms)";
+		}
+	}
+	if (mesh_anchored) {
+		res += " mesh_anchored last_resync_ms=";
+		res += last_resync_ms;
+	}
+	res += "\n queries=";
+	res += queries;
+	res += " answered=";
+	res += answered;
+	if (queries > 0) {
+		res += " success=";
+		res += answered * 100 / queries;
+		res += "%";
+	}
+	if (answered > 0) {
+		res += " latency_avg_ms=";
+		res += latency_sum_ms / answered;
+		res += " latency_max_ms=";
+		res += latency_max_ms;
+	}
+	return res;
+}
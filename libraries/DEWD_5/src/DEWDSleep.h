@@ -0,0 +1,51 @@
+/*
+ DEWDSleep.h Header file defining the mesh-wide duty-cycling schedule.
+ All nodes share a wake window of awake_ms at the start of every period_ms, agreed through a 
+ DUTY_CYCLE broadcast. Outside the window nodes are in deep sleep. Relays stay awake past the end 
+ of the window while they still forward a broadcast, edge nodes go back to sleep as soon as they 
+ have answered. The schedule takes the current time as parameter so it can be driven by any clock. 
+ The window is kept on the local clock, which drifts, most of all across deep sleep. When the mesh 
+ time of a window start is known, every mesh clock sync moves the local anchor back onto it.
+ Created by agent, 2026.
+ 
+ */
+ 
+#ifndef DEWDSleep_h
+#define DEWDSleep_h
+
+#include <WString.h>
+
+	const unsigned long SLEEP_WAKE_LEAD = 1500;						// ms a node wakes before the window, to rejoin the mesh in time
+	const unsigned long SLEEP_RELAY_HOLD = 5000;					// max ms a busy relay stays awake after the window
+	const unsigned long SLEEP_MIN = 1000;							// shorter sleeps are not worth the rejoin
+	const int SLEEP_DEFERRED_MAX = 4;								// broadcasts held back until the next wake window
+
+class DEWDSleepSchedule
+{
+public:
+	unsigned long period_ms = 0;									// 0 if duty cycling is off
+	unsigned long awake_ms = 0;
+	unsigned long anchor_ms = 0;									// local time at which a wake window started
+	unsigned long mesh_anchor_ms = 0;								// mesh time at which a wake window started
+	bool mesh_anchored = false;										// true if mesh_anchor_ms is known
+	long last_resync_ms = 0;										// anchor correction of the last resync, shows the drift
+	
+	uint16_t queries = 0;											// broadcasts originated by this node, see print_values()
+	uint16_t answered = 0;
+	unsigned long latency_sum_ms = 0;
+	unsigned long latency_max_ms = 0;
+	
+	DEWDSleepSchedule();
+	void set(unsigned long period, unsigned long awake, unsigned long now);
+	void set_mesh_anchor(unsigned long mesh_anchor);
+	void resync(unsigned long mesh_now, unsigned long now);
+	bool active();
+	bool in_window(unsigned long now);
+	unsigned long until_window(unsigned long now);
+	unsigned long sleep_time(unsigned long now, bool relay, bool busy, bool has_answered);
+	void query_started();
+	void query_done(unsigned long latency);
+	String print_values(unsigned long now);
+};
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ DEWDStall.cpp Body file defining the main-loop stall profiler.
+ Created by agent, 2026.
+ 
+ */
+ 
+#include <Arduino.h>
+#include <DEWDStall.h>
+
+DEWDStallProfiler stalls;
+
+ICACHE_FLASH_ATTR DEWDStallProfiler::DEWDStallProfiler() {
+	memset(_sections, 0, sizeof(_sections));
+	memset(_ring, 0, sizeof(_ring));
+}
+
+/* return: start time to be given to leave()
+     */
+unsigned long DEWDStallProfiler::enter() {
+	return millis();
+}
+
+/* Record a finished blocking section
+     *
+	 * param name: name of the section, must be a string literal
+	 * param start: value returned by enter()
+     */
+void DEWDStallProfiler::leave(const char * name, unsigned long start) {
+	unsigned long d = millis() - start;
+	if (d >= _loop_worst_ms) {
+		_loop_worst = name;
+		_loop_worst_ms = d;
+	}
+	
+	int slot = -1;
+	for (int i=0; i<STALL_SECTIONS && slot < 0; i++) {
+		if (_sections[i].name != NULL && !strcmp(_sections[i].name, name))
+			slot = i;
+	}
+	if (slot < 0) {												// new section: free slot, or else the one with the lowest max
+		slot = 0;
+		for (int i=0; i<STALL_SECTIONS; i++) {
+			if (_sections[i].name == NULL) {
+				slot = i;
+				break;
+			}
+			if (_sections[i].max_ms < _sections[slot].max_ms)
+				slot = i;
+		}
+		if (_sections[slot].name != NULL && _sections[slot].max_ms > d)
+			return;												// table is full of worse offenders
+		_sections[slot].name = name;
+		_sections[slot].count = 0;
+		_sections[slot].total_ms = 0;
+		_sections[slot].max_ms = 0;
+	}
+	DEWDStallSection * section = &_sections[slot];
+	section->count++;
+	section->total_ms += d;
+	if (d > section->max_ms)
+		section->max_ms = d;
+}
+
+/* End of a main-loop iteration
+     *
+	 * param duration: ms the iteration took, without the loop delay
+     */
+void DEWDStallProfiler::loop_done(unsigned long duration) {
+	loops++;
+	if (duration > loop_max_ms)
+		loop_max_ms = duration;
+	if (duration >= STALL_LOOP_THRESHOLD) {
+		slow_loops++;
+		DEWDSlowLoop & slow = _ring[_ring_next];
+		slow.at_ms = millis();
+		slow.duration_ms = duration;
+		slow.worst = _loop_worst;
+		slow.worst_ms = _loop_worst_ms;
+		_ring_next = (_ring_next + 1) % STALL_RING;
+	}
+	_loop_worst = NULL;
+	_loop_worst_ms = 0;
+}
+
+/* Compact encoding for the STALLS broadcast: "<slow_loops>/<loops> <loop_max_ms> <name>:<count>:<max_ms>:<total_ms>,..."
+     *
+     */
+String ICACHE_FLASH_ATTR DEWDStallProfiler::encode(void) {
+	String res;
+	res += slow_loops;
+	res += '/';
+	res += loops;
+	res += ' ';
+	res += loop_max_ms;
+	res += ' ';
+	bool empty = true;
+	for (int i=0; i<STALL_SECTIONS; i++) {
+		if (_sections[i].name == NULL)
+			continue;
+		if (!empty)
+			res += ',';
+		res += _sections[i].name;
+		res += ':';
+		res += _sections[i].count;
+		res += ':';
+		res += _sections[i].max_ms;
+		res += ':';
+		res += _sections[i].total_ms;
+		empty = false;
+	}
+	if (empty)
+		res += '-';
+	return res;
+}
+
+String ICACHE_FLASH_ATTR DEWDStallProfiler::print_values(void) {
+	String res = " loops=";
+	res += loops;
+	res += " slow_loops=";
+	res += slow_loops;
+	res += " (>= ";
+	res += STALL_LOOP_THRESHOLD;
+	res += " ms) loop_max_ms=";
+	res += loop_max_ms;
+	
+	for (int i=0; i<STALL_SECTIONS; i++) {
+		if (_sections[i].name == NULL)
+			continue;
+		res += "\n ";
+		res += _sections[i].name;
+		res += ": count=";
+		res += _sections[i].count;
+		res += " max_ms=";
+		res += _sections[i].max_ms;
+		res += " avg_ms=";
+		res += _sections[i].total_ms / _sections[i].count;
+	}
+	for (int i=0; i<STALL_RING; i++) {
+		DEWDSlowLoop & slow = _ring[(_ring_next + i) % STALL_RING];		// oldest first
+		if (slow.duration_ms == 0)
+			continue;
+		res += "\n slow loop ";
+		res += (millis() - slow.at_ms) / 1000;
+		res += " s ago: ";
+		res += slow.duration_ms;
+		res += " ms";
+		if (slow.worst != NULL) {
+			res += ", longest section ";
+			res += slow.worst;
+			res += " ";
+			res += slow.worst_ms;
+			res += " ms";
+		}
+	}
+	return res;
+}
@@ -0,0 +1,57 @@
+/*
+ DEWDStall.h Header file defining the main-loop stall profiler.
+ The known blocking sections of the library (scans, connects, sensor reads, ...) are timed with 
+ enter()/leave(). The worst sections are kept by name with count, total and max duration, and main-loop 
+ iterations longer than STALL_LOOP_THRESHOLD are kept in a small ring with the longest section they contained.
+ Created by agent, 2026.
+ 
+ */
+ 
+#ifndef DEWDStall_h
+#define DEWDStall_h
+
+#include <WString.h>
+
+	const int STALL_SECTIONS = 8;								// sections tracked by name, the one with the lowest max is replaced
+	const int STALL_RING = 4;									// slow loop iterations remembered
+	const unsigned long STALL_LOOP_THRESHOLD = 1000;			// ms, a longer main-loop iteration (without the loop delay) is a stall
+
+struct DEWDStallSection {
+	const char * name;											// NULL if the slot is free
+	uint32_t count;
+	unsigned long total_ms;
+	unsigned long max_ms;
+};
+
+struct DEWDSlowLoop {
+	unsigned long at_ms;										// millis() when the iteration ended
+	unsigned long duration_ms;
+	const char * worst;											// longest section in it, NULL if none was timed
+	unsigned long worst_ms;
+};
+
+class DEWDStallProfiler
+{
+private:
+	DEWDStallSection _sections[STALL_SECTIONS];
+	DEWDSlowLoop _ring[STALL_RING];
+	int _ring_next = 0;
+	const char * _loop_worst = NULL;							// longest section of the current iteration
+	unsigned long _loop_worst_ms = 0;
+
+public:
+	uint32_t loops = 0;
+	uint32_t slow_loops = 0;
+	unsigned long loop_max_ms = 0;
+	
+	DEWDStallProfiler();
+	unsigned long enter();
+	void leave(const char * name, unsigned long start);
+	void loop_done(unsigned long duration);
+	String encode(void);
+	String print_values(void);
+};
+
+extern DEWDStallProfiler stalls;
+
+#endif
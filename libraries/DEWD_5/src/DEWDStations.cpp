@@ -0,0 +1,186 @@
+/*
+ DEWDStations.cpp Body file defining the softAP station table.
+ Created by agent, 2026.
+ 
+ */
+ 
+#include <IPAddress.h>
+#include <WString.h>
+#include <DEWDStations.h>
+#include <ESP8266WiFi.h>
+extern "C" {
+#include "user_interface.h"
+}
+
+DEWDStationTable stations;
+
+ICACHE_FLASH_ATTR DEWDStationTable::DEWDStationTable() {
+}
+
+/* Register the softAP event handlers and load the stations that are already associated.
+	Safe to call again, e.g. when the softAP is set up anew: the handlers are registered once.
+     *
+     */
+void ICACHE_FLASH_ATTR DEWDStationTable::begin() {
+	if (!_connected_handler) {
+		_connected_handler = WiFi.onSoftAPModeStationConnected([this](const WiFiEventSoftAPModeStationConnected & e) {
+			on_connect(e.mac, e.aid);
+		});
+		_disconnected_handler = WiFi.onSoftAPModeStationDisconnected([this](const WiFiEventSoftAPModeStationDisconnected & e) {
+			on_disconnect(e.mac);
+		});
+	}
+	
+	_count = 0;
+	struct station_info * station = wifi_softap_get_station_info();
+	while (station) {
+		on_connect(station->bssid, 0);
+		DEWDStation * known = find(MACAddress(station->bssid));
+		if (known != NULL)
+			known->ip = IPAddress(station->ip.addr);
+		station = STAILQ_NEXT(station, next);
+	}
+	wifi_softap_free_station_info();
+}
+
+/* Resolve the leased IPs of newly associated stations. Called once per main-loop iteration; 
+	the SDK station list is only walked while a lease is outstanding.
+     *
+     */
+void DEWDStationTable::update() {
+	if (_lease_pending && millis() - _lease_check_ms >= STATION_LEASE_POLL) {
+		_lease_check_ms = millis();
+		resolve_leases();
+	}
+}
+
+void ICACHE_FLASH_ATTR DEWDStationTable::resolve_leases() {
+	bool missing = false;
+	struct station_info * station = wifi_softap_get_station_info();
+	
+	while (station) {
+		int i = find_index(MACAddress(station->bssid));
+		if (i >= 0)
+			_stations[i].ip = IPAddress(station->ip.addr);
+		station = STAILQ_NEXT(station, next);
+	}
+	wifi_softap_free_station_info();
+	
+	for (int i=0; i<_count; i++) {
+		if (_stations[i].ip[0] == 0)
+			missing = true;
+	}
+	_lease_pending = missing;
+}
+
+void ICACHE_FLASH_ATTR DEWDStationTable::on_connect(const uint8_t * mac, uint8_t aid) {
+	int i = find_index(MACAddress(mac));
+	if (i < 0) {
+		if (_count >= MAX_STATIONS)
+			return;
+		i = _count++;
+	}
+	_stations[i].mac = mac;
+	_stations[i].ip = IPAddress(0, 0, 0, 0);
+	_stations[i].aid = aid;
+	_stations[i].joined_ms = millis();
+	_stations[i].last_ok_ms = 0;
+	_stations[i].sent = 0;
+	_stations[i].failed = 0;
+	_lease_pending = true;
+}
+
+void ICACHE_FLASH_ATTR DEWDStationTable::on_disconnect(const uint8_t * mac) {
+	int i = find_index(MACAddress(mac));
+	if (i < 0)
+		return;
+	_stations[i] = _stations[--_count];								// keep active stations packed
+}
+
+int DEWDStationTable::count() {
+	return _count;
+}
+
+DEWDStation * DEWDStationTable::get(int i) {
+	if (i < 0 || i >= _count)
+		return NULL;
+	return &_stations[i];
+}
+
+/* Copy the stations for a loop that sends to them. A send yields, and a disconnect event during it 
+	compacts the table, so a loop over get(i) would skip a station or send to the wrong one.
+     *
+	 * param out: array of MAX_STATIONS entries
+	 * return: number of stations copied
+     */
+int DEWDStationTable::copy(DEWDStation * out) {
+	for (int i=0; i<_count; i++)
+		out[i] = _stations[i];
+	return _count;
+}
+
+int DEWDStationTable::find_index(MACAddress mac) {
+	for (int i=0; i<_count; i++) {
+		if (mac == _stations[i].mac)
+			return i;
+	}
+	return -1;
+}
+
+DEWDStation * DEWDStationTable::find(MACAddress mac) {
+	int i = find_index(mac);
+	if (i < 0)
+		return NULL;
+	return &_stations[i];
+}
+
+DEWDStation * DEWDStationTable::find(IPAddress ip) {
+	for (int i=0; i<_count; i++) {
+		if (_stations[i].ip == ip)
+			return &_stations[i];
+	}
+	return NULL;
+}
+
+void DEWDStationTable::record_send(IPAddress ip, bool ok) {
+	DEWDStation * station = find(ip);
+	if (station == NULL)
+		return;
+	if (ok) {
+		station->sent++;
+		station->last_ok_ms = millis();
+	}
+	else
+		station->failed++;
+}
+
+String ICACHE_FLASH_ATTR DEWDStationTable::print_values(void) {
+	String res;
+	if (_count == 0)
+		return "No stations connected to current AP";
+	
+	for (int i=0; i<_count; i++) {
+		res += i + 1;
+		res += ".  IP: ";
+		for (int j=0; j<3; j++) {
+			res += _stations[i].ip[j];
+			res += '.';
+		}
+		res += _stations[i].ip[3];
+		res += "       MAC: ";
+		for (int j=0; j<5; j++) {
+			res += String(_stations[i].mac[j], HEX);
+			res += ':';
+		}
+		res += String(_stations[i].mac[5], HEX);
+		res += "  up=";
+		res += (millis() - _stations[i].joined_ms) / 1000;
+		res += "s sent=";
+		res += _stations[i].sent;
+		res += " failed=";
+		res += _stations[i].failed;
+		if (i < _count - 1)
+			res += '\n';
+	}
+	return res;
+}
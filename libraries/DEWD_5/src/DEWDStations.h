@@ -0,0 +1,60 @@
+/*
+ DEWDStations.h Header file defining the softAP station table.
+ The table is maintained from softAP connect/disconnect events, so that broadcast fan-out 
+ and MAC lookups never have to walk the SDK station list for every packet. The SDK station list 
+ is only read while a new station has no lease yet, every STATION_LEASE_POLL ms.
+ Created by agent, 2026.
+ 
+ */
+ 
+#ifndef DEWDStations_h
+#define DEWDStations_h
+
+#include <MACAddress.h>
+#include <IPAddress.h>
+#include <WString.h>
+#include <ESP8266WiFi.h>
+
+	const int MAX_STATIONS = 8;										// max nr of stations an ESP8266 softAP accepts
+	const unsigned long STATION_LEASE_POLL = 200;					// ms between reads of the SDK station list while a lease is pending
+
+struct DEWDStation {
+	MACAddress mac;													// STA interface MAC of the client
+	IPAddress ip;													// address leased by the softAP DHCP server, 0.0.0.0 until known
+	uint8_t aid;													// association id assigned by the softAP
+	unsigned long joined_ms;										// millis() when the client associated
+	unsigned long last_ok_ms;										// millis() of the last successful send to the client
+	uint16_t sent;													// nr of successful sends to the client
+	uint16_t failed;												// nr of failed sends (connect timeouts) to the client
+};
+
+class DEWDStationTable
+{
+private:
+	DEWDStation _stations[MAX_STATIONS];							// active stations are kept packed in [0, _count)
+	int _count = 0;
+	bool _lease_pending = false;									// set by events, cleared once every station has an IP
+	unsigned long _lease_check_ms = 0;
+	WiFiEventHandler _connected_handler;
+	WiFiEventHandler _disconnected_handler;
+	
+	int find_index(MACAddress mac);
+	void resolve_leases();
+
+public:
+	DEWDStationTable();
+	void begin();
+	void update();
+	void on_connect(const uint8_t * mac, uint8_t aid);
+	void on_disconnect(const uint8_t * mac);
+	int count();
+	DEWDStation * get(int i);
+	int copy(DEWDStation * out);
+	DEWDStation * find(MACAddress mac);
+	DEWDStation * find(IPAddress ip);
+	void record_send(IPAddress ip, bool ok);
+	String print_values(void);
+};
+
+extern DEWDStationTable stations;
+#endif
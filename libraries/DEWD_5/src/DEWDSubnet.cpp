@@ -0,0 +1,65 @@
+/*
+ DEWDSubnet.cpp Body file defining the softAP subnet assignment.
+ Created by agent, 2026.
+ 
+ */
+ 
+#include <Arduino.h>
+#include <DEWDSubnet.h>
+
+ICACHE_FLASH_ATTR DEWDSubnetPlan::DEWDSubnetPlan() {
+}
+
+/* Candidate subnet number attempt of a node. The chip ID is mixed with an integer hash, so nodes 
+	with consecutive IDs get unrelated subnets.
+     *
+	 * param id: chip ID of the node
+	 * param attempt: position in the node's candidate sequence
+	 * return: subnet octet between SUBNET_MIN and SUBNET_MAX, never SUBNET_RESERVED
+     */
+uint8_t ICACHE_FLASH_ATTR DEWDSubnetPlan::derive(uint32_t id, uint8_t attempt) {
+	uint32_t h = id ^ (attempt * 0x9E3779B9);
+	h ^= h >> 16;
+	h *= 0x7FEB352D;
+	h ^= h >> 15;
+	h *= 0x846CA68B;
+	h ^= h >> 16;
+	
+	uint8_t subnet = SUBNET_MIN + h % (SUBNET_MAX - SUBNET_MIN);	// one value short, SUBNET_RESERVED maps to SUBNET_MAX
+	return subnet == SUBNET_RESERVED ? SUBNET_MAX : subnet;
+}
+
+/* Take the first candidate, starting at first_attempt, that is not used in the neighbourhood
+     *
+	 * param id: chip ID of the node
+	 * param used: subnets of the parent and the neighbouring mesh APs
+	 * param n: number of entries in used
+	 * param first_attempt: first position to try, the one after the current subnet when renumbering
+	 * return: the chosen subnet, also stored in subnet
+     */
+uint8_t ICACHE_FLASH_ATTR DEWDSubnetPlan::choose(uint32_t id, const uint8_t * used, int n, uint8_t first_attempt) {
+	for (int a=first_attempt; a<first_attempt + SUBNET_MAX_ATTEMPTS; a++) {
+		uint8_t candidate = derive(id, a);
+		bool taken = false;
+		for (int i=0; i<n && !taken; i++)
+			taken = used[i] == candidate;
+		if (!taken) {
+			subnet = candidate;
+			attempt = a;
+			return subnet;
+		}
+	}
+	attempt = first_attempt;										// neighbourhood is crowded, take the first and let the checks go on
+	subnet = derive(id, attempt);
+	return subnet;
+}
+
+String ICACHE_FLASH_ATTR DEWDSubnetPlan::print_values(void) {
+	String res = " subnet=192.168.";
+	res += subnet;
+	res += ".0/24 attempt=";
+	res += attempt;
+	res += " renumbered=";
+	res += renumbered;
+	return res;
+}
@@ -0,0 +1,34 @@
+/*
+ DEWDSubnet.h Header file defining the softAP subnet assignment.
+ Every node serves its children on 192.168.<subnet>.0/24. The subnet is derived from the chip ID, 
+ so it is the same after every reset, and the next candidate of the same sequence is taken while it 
+ is used by the parent or a neighbouring mesh AP. Nodes renumber when a conflict shows up later.
+ Created by agent, 2026.
+ 
+ */
+ 
+#ifndef DEWDSubnet_h
+#define DEWDSubnet_h
+
+#include <WString.h>
+
+	const uint8_t SUBNET_MIN = 2;
+	const uint8_t SUBNET_MAX = 254;
+	const uint8_t SUBNET_RESERVED = 4;								// 192.168.4.1 is the SDK's default softAP, used by unconfigured modules
+	const int SUBNET_MAX_ATTEMPTS = 64;								// candidates tried before giving up on a free subnet
+	const unsigned long SUBNET_CHECK_FREQ = 5000;					// ms between conflict checks
+
+class DEWDSubnetPlan
+{
+public:
+	uint8_t subnet = 0;												// current softAP subnet, 0 if none yet
+	uint8_t attempt = 0;											// position of subnet in the node's candidate sequence
+	uint16_t renumbered = 0;
+	
+	DEWDSubnetPlan();
+	static uint8_t derive(uint32_t id, uint8_t attempt);
+	uint8_t choose(uint32_t id, const uint8_t * used, int n, uint8_t first_attempt);
+	String print_values(void);
+};
+
+#endif
@@ -7,6 +7,10 @@
 #include <IPAddress.h>
 #include <WString.h>
 #include <DEWDTcp.h>
+#include <DEWDStations.h>
+#include <DEWDMetrics.h>
+#include <DEWDStall.h>
+#include <DEWDLink.h>
 #include <ESP8266WiFi.h>
 extern "C" {
 #include "user_interface.h"
@@ -23,6 +27,11 @@ void ICACHE_FLASH_ATTR DEWDTcpClass::start_server() {
 }
 
 void ICACHE_FLASH_ATTR DEWDTcpClass::restart_server() {	
+	for (int i=0; i<TCP_MAX_CLIENTS; i++) {
+		if (_in[i].used)
+			_in[i].client.stop();
+		_in[i].used = false;
+	}
 	_server = WiFiServer(_port);
 	_server.begin();
 }
@@ -50,7 +59,8 @@ String ICACHE_FLASH_ATTR DEWDTcpClass::make_packet(char flag, IPAddress src_ip,
 		ret += payload;
 	}
 	// Make direct message, format: "M <id> <src_ip> <payload>"
-	else if(flag == 'M') {
+	// Route request, route reply, MAC-addressed unicast, tree hello, time sync and topology use the same format with flags 'Q', 'P', 'D', 'H', 'T' and 'Y'
+	else if(flag == 'M' || flag == 'Q' || flag == 'P' || flag == 'D' || flag == 'H' || flag == 'T' || flag == 'Y') {
 		ret += " ";
 		for (int i=0; i<3;i++) {
 			ret += src_ip[i];
@@ -68,75 +78,141 @@ String ICACHE_FLASH_ATTR DEWDTcpClass::make_packet(char flag, IPAddress src_ip,
 }
 
 bool ICACHE_FLASH_ATTR DEWDTcpClass::send_by_ip(String str, IPAddress dest) {    
-  if (_client.connect(dest, _port)) {
-    _client.println(str);
-	return true;
-  }
-  else {
-	  return false;
-  }
+  unsigned long stall = stalls.enter();
+  unsigned long start = micros();
+  bool ok = _out.connect(dest, _port);
+  unsigned long connected = micros();
+  stalls.leave("tcp_connect", stall);
+  
+  if (ok)
+    _out.println(str);
+  stations.record_send(dest, ok);
+  links.record(dest, ok, connected - start);
+  metrics.send_result(ok, connected - start, micros() - start);
+  return ok;
 }
 
 bool ICACHE_FLASH_ATTR DEWDTcpClass::send_by_mac(String str, MACAddress dest) {    
-	uint8_t * macp;
+	uint8_t macp[6];
 
 	// check if dest = station interface
 	wifi_get_macaddr(STATION_IF, macp);
-	MACAddress mac(macp);
-	if (mac == dest) {									
+	if (dest == macp) {									
 		return false;
 	}
   
 	// check if dest = softAP interface
 	wifi_get_macaddr(SOFTAP_IF, macp);
-	mac = MACAddress(macp);
-	if (mac == dest) {									
+	if (dest == macp) {									
 		return false;
 	}
 	
-	// check if host is dest
-	struct station_config host_sta;
-	wifi_station_get_config(&host_sta);
-	if (host_sta.bssid_set != 0)
-		mac = MACAddress(host_sta.bssid);
-	else
-		uint8 current_ap_id = wifi_station_get_current_ap_id();
-	
-	if (mac == dest) {
+	// check if host is dest, BSSID is the host's softAP MAC so only the last three octets match
+	if (WiFi.gatewayIP()[0] != 0 && !memcmp(&dest[3], WiFi.BSSID() + 3, 3)) {
 		if (send_by_ip(str, WiFi.gatewayIP()))					// REPLACE WITH NON-ESP8266WiFi FUNCTION!
 			return true;
 		return false;
 	}
-		
 
 	// check if one of the clients is dest 
-	int count = 0;
-	struct station_info * station = wifi_softap_get_station_info();
-	struct station_info * next_station;
-	
-	if (station == NULL) {
+	DEWDStation * station = stations.find(dest);
+	if (station == NULL || station->ip[0] == 0) {				// not a client, or no DHCP lease yet
 		return false;
 	}
-	  	  
-     while(station) { 			
-		mac = MACAddress(station->bssid);
-		if (mac == dest) {
-			if (send_by_ip(str, (&station->ip)->addr))
-				return true;
-			return false;
+	return send_by_ip(str, station->ip);
+}
+
+/* Move the line of an inbound connection to the queue
+     *
+     */
+void DEWDTcpClass::enqueue(DEWDInbound & in) {
+	int i = (_head + _queued) % TCP_QUEUE;
+	_queue[i] = in.line;
+	_queue_ms[i] = millis();
+	_queue_us[i] = micros();
+	_queue_ip[i] = in.client.remoteIP();
+	_queued++;
+	if (_queued > max_queued)
+		max_queued = _queued;
+	lines++;
+	in.line = "";
+	in.done = true;
+}
+
+/* Accept all waiting connections and read what they have, without waiting for data that has not 
+	arrived yet. Stops when the queue is full or after TCP_INGRESS_BUDGET_US, the rest stays in the 
+	sockets until the next pass. Runs from listen() and, to stamp lines on arrival, during the main-loop delay.
+     *
+     */
+void DEWDTcpClass::ingress() {
+	unsigned long stall = stalls.enter();
+	unsigned long start = micros();
+	int open = 0;
+	
+	for (int i=0; i<TCP_MAX_CLIENTS; i++) {
+		if (_in[i].used) {
+			open++;
+			continue;
+		}
+		WiFiClient c = _server.available();
+		if (!c)
+			break;
+		_in[i].client = c;
+		_in[i].line = "";
+		_in[i].used = true;
+		_in[i].done = false;
+		_in[i].accepted_ms = millis();
+		accepted++;
+		open++;
+	}
+	if (open > max_clients)
+		max_clients = open;
+	
+	for (int i=0; i<TCP_MAX_CLIENTS; i++) {
+		DEWDInbound & in = _in[i];
+		if (!in.used)
+			continue;
+		if (_queued >= TCP_QUEUE || micros() - start > TCP_INGRESS_BUDGET_US) {
+			deferred++;
+			break;
+		}
+		while (!in.done && in.client.available() > 0) {
+			char c = in.client.read();
+			if (c == '\r')
+				enqueue(in);
+			else
+				in.line += c;
 		}
-		next_station = STAILQ_NEXT(station, next);
-		station = next_station;
-    }
-	wifi_softap_free_station_info();
+		bool closed = !in.client.connected() && in.client.available() <= 0;
+		if (!in.done && closed && in.line.length() > 0)		// sender closed without '\r', take what came like readStringUntil()
+			enqueue(in);
+		if (!in.done && !closed && millis() - in.accepted_ms < TCP_READ_TIMEOUT)
+			continue;
+		if (!in.done)
+			timeouts++;
+		in.client.stop();
+		in.used = false;
+	}
+	stalls.leave("tcp_ingress", stall);
 }
 
+/* Take the next received line. An ingress pass runs when the queue is empty.
+     *
+	 * return: the line without '\r', or "" if nothing was received
+     */
 String DEWDTcpClass::listen() {
-	_client = _server.available();
-	if (!_client) 
+	if (_queued == 0)
+		ingress();
+	if (_queued == 0)
 		return "";
 	
-	String ret = _client.readStringUntil('\r');
+	String ret = _queue[_head];
+	_queue[_head] = "";
+	received_ms = _queue_ms[_head];
+	received_us = _queue_us[_head];
+	_remote = _queue_ip[_head];
+	_head = (_head + 1) % TCP_QUEUE;
+	_queued--;
 	return ret;
 }
 
@@ -147,9 +223,27 @@ String ICACHE_FLASH_ATTR DEWDTcpClass::parse(String s) {
 String ICACHE_FLASH_ATTR DEWDTcpClass::get_info() {
 	String ret = " port=";
 	ret += _port;		
+	ret += "\n accepted=";
+	ret += accepted;
+	ret += " lines=";
+	ret += lines;
+	ret += " timeouts=";
+	ret += timeouts;
+	ret += " deferred=";
+	ret += deferred;
+	ret += "\n queued=";
+	ret += _queued;
+	ret += "/";
+	ret += TCP_QUEUE;
+	ret += " max_queued=";
+	ret += max_queued;
+	ret += " max_clients=";
+	ret += max_clients;
+	ret += "/";
+	ret += TCP_MAX_CLIENTS;
 	return ret;
 }
 
 IPAddress ICACHE_FLASH_ATTR DEWDTcpClass::get_remote_ip() {
-	return IPAddress(_client.remoteIP());
+	return _remote;
 }
@@ -1,5 +1,9 @@
 /*
  DEWDTcp.h Header file defining TCP client-server functionality.
+ Outbound sends and inbound connections use separate clients. Every ingress pass accepts all waiting 
+ connections, up to TCP_MAX_CLIENTS, and reads whatever they have without blocking; complete lines 
+ go into a queue that listen() hands out one by one, so the responses of several children answering 
+ at once are all taken in the same main-loop iteration.
  Created by Alexander Pukhanov, 2015.
  
  */
@@ -13,21 +17,57 @@
 #include <ESP8266WiFi.h>
 #include <WiFiServer.h>
 
+	const int TCP_MAX_CLIENTS = 5;									// inbound connections serviced at once, lwIP has 5 TCP PCBs by default
+	const int TCP_QUEUE = 8;										// received lines waiting for listen()
+	const int TCP_BURST = 16;										// lines handled per main-loop iteration, see handle_ports()
+	const unsigned long TCP_INGRESS_BUDGET_US = 20000;				// an ingress pass stops reading after this long
+	const unsigned long TCP_READ_TIMEOUT = 1000;					// ms an inbound connection gets to deliver its line, like the Stream default
+	const unsigned long TCP_POLL = 10;								// ms between ingress passes during the main-loop delay, see mesh_delay()
+
+struct DEWDInbound {
+	WiFiClient client;
+	String line;													// received so far, without '\r'
+	bool used = false;
+	bool done = false;												// the line is complete, close once drained
+	unsigned long accepted_ms = 0;
+};
+
 class DEWDTcpClass
 {
 private:
 
 	uint16 _port = 4040;												// TCP port
-	WiFiClient _client;
+	WiFiClient _out;													// outbound sends only
+	DEWDInbound _in[TCP_MAX_CLIENTS];
 	WiFiServer _server = WiFiServer(_port);
+	
+	String _queue[TCP_QUEUE];
+	unsigned long _queue_ms[TCP_QUEUE];
+	unsigned long _queue_us[TCP_QUEUE];
+	IPAddress _queue_ip[TCP_QUEUE];
+	int _head = 0;
+	int _queued = 0;
+	IPAddress _remote;												// sender of the line listen() returned last
+	
+	void enqueue(DEWDInbound & in);
 
 public:
+	unsigned long received_ms = 0;									// millis() when the line listen() returned last was read
+	unsigned long received_us = 0;									// micros() of the same moment, for the latency histogram
+	uint32_t accepted = 0;											// statistics, see get_info()
+	uint32_t lines = 0;
+	uint32_t timeouts = 0;
+	uint32_t deferred = 0;											// passes that left connections for the next one
+	uint8_t max_queued = 0;
+	uint8_t max_clients = 0;
+	
 	DEWDTcpClass(int port);
 	String make_packet(char flag, IPAddress src_ip, String payload, int id);
 	void start_server();
 	void restart_server();
 	bool send_by_ip(String str, IPAddress dest);
 	bool send_by_mac(String str, MACAddress dest);
+	void ingress();
 	String listen();
 	String parse(String s);
 	String get_info();
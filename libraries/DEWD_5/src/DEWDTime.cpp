@@ -0,0 +1,125 @@
+/*
+ DEWDTime.cpp Body file defining the mesh clock.
+ Created by agent, 2026.
+ 
+ */
+ 
+#include <Arduino.h>
+#include <DEWDTime.h>
+
+ICACHE_FLASH_ATTR DEWDMeshTime::DEWDMeshTime() {
+}
+
+/* return: current mesh time in ms
+     */
+unsigned long DEWDMeshTime::now() {
+	return millis() + offset;
+}
+
+/* return: local millis() at which the mesh clock shows mesh_ms
+     */
+unsigned long DEWDMeshTime::to_local(unsigned long mesh_ms) {
+	return mesh_ms - offset;
+}
+
+bool DEWDMeshTime::synced() {
+	return stratum != TIME_UNSYNCED;
+}
+
+/* This node has no uplink, its clock is the mesh time from now on. The offset is kept, so the 
+	mesh time does not jump when a node loses its parent.
+     *
+     */
+void ICACHE_FLASH_ATTR DEWDMeshTime::become_root() {
+	stratum = 0;
+	error_ms = 0;
+	_samples = TIME_SAMPLES;									// no round to run
+}
+
+/* Start a new round at once, e.g. after moving to another parent. The old offset is used until it ends.
+     *
+     */
+void ICACHE_FLASH_ATTR DEWDMeshTime::resync() {
+	_samples = 0;
+	_best_rtt = 0xFFFFFFFF;
+	_request_ms = millis() - TIME_RETRY;
+	synced_ms = millis() - TIME_SYNC_FREQ;
+}
+
+/* return: true if the next request to the parent should be sent
+     */
+bool DEWDMeshTime::request_due(unsigned long now) {
+	if (_samples >= TIME_SAMPLES) {
+		if (now - synced_ms < TIME_SYNC_FREQ)
+			return false;
+		_samples = 0;											// start a new round
+		_best_rtt = 0xFFFFFFFF;
+	}
+	return now - _request_ms >= TIME_RETRY;
+}
+
+void ICACHE_FLASH_ATTR DEWDMeshTime::request_sent(unsigned long now) {
+	_request_ms = now;
+}
+
+/* Take a sample from the parent's reply
+     *
+	 * param t1: local time the request was sent, echoed by the parent
+	 * param t2: parent's mesh time when it replied
+	 * param t3: local time the reply was received
+	 * param p_stratum: parent's stratum
+	 * param p_error: parent's error bound in ms
+	 * param hold_ms: ms the request waited at the parent before t2, 0 if the parent does not report it
+	 * return: true if a round was completed and the offset updated
+     */
+bool ICACHE_FLASH_ATTR DEWDMeshTime::on_reply(unsigned long t1, unsigned long t2, unsigned long t3, uint8_t p_stratum, unsigned long p_error, unsigned long hold_ms) {
+	if (t1 != _request_ms || p_stratum == TIME_UNSYNCED || _samples >= TIME_SAMPLES)
+		return false;											// stale reply, or parent has no mesh time yet
+	
+	unsigned long rtt = t3 - t1;
+	rtt -= hold_ms < rtt ? hold_ms : rtt;						// the wait at the parent is on the way up only
+	if (rtt < _best_rtt) {
+		_best_rtt = rtt;
+		_best_offset = (long)(t2 - t3) + (long)(rtt / 2);
+		_best_stratum = p_stratum;
+		_best_error = p_error;
+	}
+	_request_ms = t3 - TIME_RETRY;								// next request right away
+	if (++_samples < TIME_SAMPLES)
+		return false;
+	
+	last_step = synced() ? _best_offset - offset : 0;
+	offset = _best_offset;
+	stratum = _best_stratum < TIME_UNSYNCED - 1 ? _best_stratum + 1 : TIME_UNSYNCED - 1;
+	error_ms = _best_error + (_best_rtt + 1) / 2;
+	last_rtt = _best_rtt;
+	synced_ms = t3;
+	rounds++;
+	return true;
+}
+
+String ICACHE_FLASH_ATTR DEWDMeshTime::print_values(void) {
+	String res = " mesh_ms=";
+	res += now();
+	res += " offset=";
+	res += offset;
+	if (!synced()) {
+		res += " (not synced)";
+		return res;
+	}
+	res += " stratum=";
+	res += stratum;
+	res += " error_ms=";
+	res += error_ms;
+	if (stratum > 0) {
+		res += "\n rounds=";
+		res += rounds;
+		res += " last_rtt_ms=";
+		res += last_rtt;
+		res += " last_step_ms=";
+		res += last_step;
+		res += " synced_ago_ms=";
+		res += millis() - synced_ms;
+	}
+	return res;
+}
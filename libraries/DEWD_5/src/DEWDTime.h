@@ -0,0 +1,55 @@
+/*
+ DEWDTime.h Header file defining the mesh clock.
+ The root's millis() is the mesh time. Every node keeps an offset to it, learned from its parent in
+ rounds of request/reply exchanges: the child stamps request and reply with its own clock, the parent 
+ stamps the reply with its mesh time, and half the round-trip time compensates the hop delay. Lines 
+ are stamped when an ingress pass reads them, every TCP_POLL ms during the main-loop delay, and the parent 
+ reports how long the request waited for its loop, which is taken off the round trip. The sample with 
+ the shortest round trip of a round is used, as it has the smallest queueing delays.
+ The error bound adds up half of that round trip for every hop down from the root.
+ Created by agent, 2026.
+ 
+ */
+ 
+#ifndef DEWDTime_h
+#define DEWDTime_h
+
+#include <WString.h>
+
+	const unsigned long TIME_SYNC_FREQ = 60000;					// ms between sync rounds
+	const unsigned long TIME_RETRY = 2000;						// ms between the requests of a round
+	const int TIME_SAMPLES = 4;									// exchanges per round
+	const uint8_t TIME_UNSYNCED = 255;							// stratum of a node that has no mesh time yet
+
+class DEWDMeshTime
+{
+private:
+	unsigned long _request_ms = 0;								// local time of the outstanding request
+	int _samples = 0;											// samples taken in the current round
+	unsigned long _best_rtt = 0xFFFFFFFF;
+	long _best_offset = 0;
+	uint8_t _best_stratum = TIME_UNSYNCED;
+	unsigned long _best_error = 0;
+
+public:
+	long offset = 0;											// mesh time - millis()
+	uint8_t stratum = TIME_UNSYNCED;							// hops from the root, TIME_UNSYNCED if not synced
+	unsigned long error_ms = 0;									// bound on the difference to the root's clock
+	unsigned long synced_ms = 0;								// millis() of the last completed round
+	long last_step = 0;											// offset correction of the last round, shows the drift
+	unsigned long last_rtt = 0;									
+	uint16_t rounds = 0;
+	
+	DEWDMeshTime();
+	unsigned long now();
+	unsigned long to_local(unsigned long mesh_ms);
+	bool synced();
+	void become_root();
+	void resync();
+	bool request_due(unsigned long now);
+	void request_sent(unsigned long now);
+	bool on_reply(unsigned long t1, unsigned long t2, unsigned long t3, uint8_t p_stratum, unsigned long p_error, unsigned long hold_ms);
+	String print_values(void);
+};
+
+#endif
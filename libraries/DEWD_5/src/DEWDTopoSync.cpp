@@ -0,0 +1,208 @@
+/*
+ DEWDTopoSync.cpp Body file defining the live topology view kept by the root of the tree.
+ Created by agent, 2026.
+ 
+ */
+ 
+#include <Arduino.h>
+#include <DEWDTopoSync.h>
+
+DEWDTopoSync topo_sync;
+
+static String suffix_string(const uint8_t * suffix) {
+	String res;
+	for (int i=0; i<TOPO_SUFFIX; i++) {
+		if (i > 0)
+			res += ':';
+		res += String(suffix[i], HEX);
+	}
+	return res;
+}
+
+static bool parse_suffix(const String & s, uint8_t * suffix) {
+	int start = 0;
+	for (int i=0; i<TOPO_SUFFIX; i++) {
+		int end = s.indexOf(':', start);
+		if (end < 0)
+			end = s.length();
+		if (end == start)
+			return false;
+		suffix[i] = strtol(s.substring(start, end).c_str(), NULL, 16);
+		start = end + 1;
+	}
+	return true;
+}
+
+static bool has_child(const DEWDTopologyRecord & r, const uint8_t * suffix) {
+	for (int i=0; i<r.child_count; i++)
+		if (!memcmp(r.children[i], suffix, TOPO_SUFFIX))
+			return true;
+	return false;
+}
+
+ICACHE_FLASH_ATTR DEWDTopoSync::DEWDTopoSync() {
+	memset(&_reported, 0, sizeof(_reported));
+}
+
+/* Compare the own links with the last reported ones and take the current ones as reported
+     *
+	 * param now: own record
+	 * param delta: set to "+<child> -<child>..." for TOPO_DELTA
+	 * return: TOPO_FULL if the parent changed or a pull is due, TOPO_DELTA if children changed, TOPO_SAME otherwise
+     */
+int ICACHE_FLASH_ATTR DEWDTopoSync::compare(const DEWDTopologyRecord & now, String & delta) {
+	int change = TOPO_SAME;
+	if (_full_due || memcmp(now.parent, _reported.parent, TOPO_SUFFIX) || now.depth != _reported.depth)
+		change = TOPO_FULL;
+	else {
+		for (int i=0; i<now.child_count; i++)
+			if (!has_child(_reported, now.children[i])) {
+				delta += delta.length() > 0 ? " +" : "+";
+				delta += suffix_string(now.children[i]);
+			}
+		for (int i=0; i<_reported.child_count; i++)
+			if (!has_child(now, _reported.children[i])) {
+				delta += delta.length() > 0 ? " -" : "-";
+				delta += suffix_string(_reported.children[i]);
+			}
+		if (delta.length() > 0)
+			change = TOPO_DELTA;
+	}
+	
+	if (change != TOPO_SAME) {
+		_reported = now;
+		_full_due = false;
+		seq++;
+	}
+	return change;
+}
+
+/* Send the full record at the next comparison, the root asked for it
+     *
+     */
+void ICACHE_FLASH_ATTR DEWDTopoSync::pull() {
+	_full_due = true;
+}
+
+int DEWDTopoSync::entry(const uint8_t * mac, bool & created) {
+	created = false;
+	for (int i=0; i<view.count; i++)
+		if (!memcmp(view.records[i].mac, mac, 6))
+			return i;
+	if (view.count == TOPO_MAX_NODES)
+		return -1;
+	
+	int i = view.count++;
+	memset(&view.records[i], 0, sizeof(DEWDTopologyRecord));
+	memcpy(view.records[i].mac, mac, 6);
+	_seq[i] = 0;
+	created = true;
+	return i;
+}
+
+void DEWDTopoSync::remove(int i) {
+	view.count--;
+	for (; i<view.count; i++) {
+		view.records[i] = view.records[i + 1];
+		_seq[i] = _seq[i + 1];
+		_heard_ms[i] = _heard_ms[i + 1];
+	}
+}
+
+/* Apply a message of the root's own tree to the view
+     *
+	 * param payload: "<mac> <seq> <kind> <args>"
+	 * param now: current time in ms
+	 * return: false if a message of that node was missed, the caller pulls its subtree
+     */
+bool ICACHE_FLASH_ATTR DEWDTopoSync::apply(const String & payload, unsigned long now) {
+	String fields = payload;
+	fields.trim();
+	int first = fields.indexOf(' ');
+	int second = fields.indexOf(' ', first + 1);
+	if (first < 0 || second < 0)
+		return true;
+	
+	uint8_t mac[6];
+	String mac_text = fields.substring(0, first);
+	int start = 0;
+	for (int i=0; i<6; i++) {
+		int end = mac_text.indexOf(':', start);
+		mac[i] = strtol(mac_text.substring(start, end < 0 ? mac_text.length() : end).c_str(), NULL, 16);
+		start = end + 1;
+	}
+	uint16_t msg_seq = fields.substring(first + 1, second).toInt();
+	char kind = fields[second + 1];
+	String args = fields.substring(second + 3);
+	
+	bool created;
+	int i = entry(mac, created);
+	if (i < 0)
+		return true;
+	_heard_ms[i] = now;
+	applied++;
+	
+	if (kind == 'F') {
+		DEWDTopologyRecord r;
+		if (!DEWDTopology::decode(args, r))
+			return true;
+		view.records[i] = r;
+		_seq[i] = msg_seq;
+		return true;
+	}
+	if (created || msg_seq != (uint16_t)(kind == 'D' ? _seq[i] + 1 : _seq[i])) {
+		gaps++;
+		return false;
+	}
+	if (kind != 'D')
+		return true;
+	
+	_seq[i] = msg_seq;
+	DEWDTopologyRecord & r = view.records[i];
+	while (args.length() > 0) {
+		int end = args.indexOf(' ');
+		String change = end < 0 ? args : args.substring(0, end);
+		args = end < 0 ? "" : args.substring(end + 1);
+		uint8_t suffix[TOPO_SUFFIX];
+		if (change.length() < 2 || !parse_suffix(change.substring(1), suffix))
+			continue;
+		if (change[0] == '+' && !has_child(r, suffix) && r.child_count < TOPO_MAX_CHILDREN)
+			memcpy(r.children[r.child_count++], suffix, TOPO_SUFFIX);
+		else if (change[0] == '-')
+			for (int c=0; c<r.child_count; c++)
+				if (!memcmp(r.children[c], suffix, TOPO_SUFFIX)) {
+					memmove(r.children[c], r.children[c + 1], (r.child_count - c - 1) * TOPO_SUFFIX);
+					r.child_count--;
+					break;
+				}
+	}
+	return true;
+}
+
+/* Remove nodes whose digests stopped arriving
+     *
+     */
+void DEWDTopoSync::expire(unsigned long now) {
+	for (int i=view.count - 1; i>=0; i--)
+		if (now - _heard_ms[i] > TOPO_EXPIRE)
+			remove(i);
+}
+
+String ICACHE_FLASH_ATTR DEWDTopoSync::print_values(void) {
+	String res = " seq=";
+	res += seq;
+	res += " sent=";
+	res += sent;
+	res += " applied=";
+	res += applied;
+	res += " gaps=";
+	res += gaps;
+	view.bytes = 0;
+	for (int i=0; i<view.count; i++)
+		view.bytes += TOPO_HEADER + view.records[i].child_count * TOPO_SUFFIX;
+	if (view.count > 0) {
+		res += "\n";
+		res += view.print_values();
+	}
+	return res;
+}
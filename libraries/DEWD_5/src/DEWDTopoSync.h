@@ -0,0 +1,61 @@
+/*
+ DEWDTopoSync.h Header file defining the live topology view kept by the root of the tree.
+ Instead of a MAP_TOPOLOGY sweep, every node reports changes of its own links up the tree (flag 'Y'), 
+ payload "<mac> <seq> <kind> <args>":
+	F <record>				full record, see DEWDTopology.h, sent first and after a parent change
+	D +<child> -<child>...	children joined and left, by the last three octets of their MAC
+	S						digest, sent when nothing changed for TOPO_DIGEST_FREQ
+	G						pull, sent down the tree, every node in the subtree answers with F
+ seq counts F and D messages of a node. The root detects a missed message by a seq it did not expect 
+ and pulls the subtree of that node. On a stable mesh only the digests remain.
+ Created by agent, 2026.
+ 
+ */
+ 
+#ifndef DEWDTopoSync_h
+#define DEWDTopoSync_h
+
+#include <WString.h>
+#include <DEWDTopology.h>
+
+	const unsigned long TOPO_CHECK_FREQ = 1000;						// ms between comparisons of the own links with the reported ones
+	const unsigned long TOPO_DIGEST_FREQ = 120000;					// ms without change before a digest is sent
+	const unsigned long TOPO_EXPIRE = 3 * TOPO_DIGEST_FREQ;			// nodes not heard of for this long leave the view
+
+	enum topo_change {
+		TOPO_SAME,
+		TOPO_DELTA,
+		TOPO_FULL
+	};
+
+class DEWDTopoSync
+{
+private:
+	DEWDTopologyRecord _reported;									// own links as last reported
+	bool _full_due = true;
+	uint16_t _seq[TOPO_MAX_NODES];									// per view entry, last seq applied
+	unsigned long _heard_ms[TOPO_MAX_NODES];
+	
+	int entry(const uint8_t * mac, bool & created);
+	void remove(int i);
+
+public:
+	uint16_t seq = 0;												// own F and D messages
+	unsigned long check_ms = 0;
+	unsigned long digest_ms = 0;									// last message sent up
+	DEWDTopology view;												// root only
+	uint32_t sent = 0;												// statistics, see print_values()
+	uint32_t applied = 0;
+	uint32_t gaps = 0;
+	
+	DEWDTopoSync();
+	int compare(const DEWDTopologyRecord & now, String & delta);
+	void pull();
+	bool apply(const String & payload, unsigned long now);
+	void expire(unsigned long now);
+	String print_values(void);
+};
+
+extern DEWDTopoSync topo_sync;
+
+#endif
@@ -0,0 +1,175 @@
+/*
+ DEWDTopology.cpp Body file defining the binary topology records of the MAP_TOPOLOGY broadcast.
+ Created by agent, 2026.
+ 
+ */
+ 
+#include <Arduino.h>
+#include <DEWDTopology.h>
+
+DEWDTopology topology;
+
+static const char BASE64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static int base64_value(char c) {
+	const char * p = strchr(BASE64, c);
+	return c != '\0' && p != NULL ? p - BASE64 : -1;
+}
+
+static String hex_octets(const uint8_t * octets, int n) {
+	String res;
+	for (int i=0; i<n; i++) {
+		if (i > 0)
+			res += ':';
+		res += String(octets[i], HEX);
+	}
+	return res;
+}
+
+ICACHE_FLASH_ATTR DEWDTopology::DEWDTopology() {
+}
+
+/* Encode a record, base64 without padding
+     *
+	 * return: the record as text, without the leading '%'
+     */
+String ICACHE_FLASH_ATTR DEWDTopology::encode(const DEWDTopologyRecord & r) {
+	uint8_t raw[TOPO_HEADER + TOPO_MAX_CHILDREN * TOPO_SUFFIX];
+	int n = r.child_count < TOPO_MAX_CHILDREN ? r.child_count : TOPO_MAX_CHILDREN;
+	raw[0] = TOPO_VERSION;
+	memcpy(raw + 1, r.mac, 6);
+	memcpy(raw + 7, r.parent, TOPO_SUFFIX);
+	raw[10] = r.depth;
+	raw[11] = r.rssi;
+	raw[12] = n;
+	memcpy(raw + TOPO_HEADER, r.children, n * TOPO_SUFFIX);
+	int len = TOPO_HEADER + n * TOPO_SUFFIX;
+	
+	String text;
+	uint32_t bits = 0;
+	int count = 0;
+	for (int i=0; i<len; i++) {
+		bits = (bits << 8) | raw[i];
+		count += 8;
+		while (count >= 6) {
+			count -= 6;
+			text += BASE64[(bits >> count) & 0x3F];
+		}
+	}
+	if (count > 0)
+		text += BASE64[(bits << (6 - count)) & 0x3F];
+	return text;
+}
+
+/* Decode a record
+     *
+	 * param text: the record as text, without the leading '%'
+	 * return: true if the record is complete and of a known version
+     */
+bool ICACHE_FLASH_ATTR DEWDTopology::decode(const String & text, DEWDTopologyRecord & r) {
+	uint8_t raw[TOPO_HEADER + TOPO_MAX_CHILDREN * TOPO_SUFFIX];
+	int len = 0;
+	uint32_t bits = 0;
+	int count = 0;
+	for (unsigned int i=0; i<text.length(); i++) {
+		int v = base64_value(text[i]);
+		if (v < 0)
+			return false;
+		bits = (bits << 6) | v;
+		count += 6;
+		if (count >= 8) {
+			count -= 8;
+			if (len == (int)sizeof(raw))
+				return false;
+			raw[len++] = bits >> count;
+		}
+	}
+	
+	if (len < TOPO_HEADER || raw[0] != TOPO_VERSION || raw[12] > TOPO_MAX_CHILDREN 
+		|| len != TOPO_HEADER + raw[12] * TOPO_SUFFIX)
+		return false;
+	memcpy(r.mac, raw + 1, 6);
+	memcpy(r.parent, raw + 7, TOPO_SUFFIX);
+	r.depth = raw[10];
+	r.rssi = raw[11];
+	r.child_count = raw[12];
+	memcpy(r.children, raw + TOPO_HEADER, r.child_count * TOPO_SUFFIX);
+	return true;
+}
+
+/* Decode the topology records of a broadcast response, other entries are skipped
+     *
+	 * param resp: response, "<entry>;<entry>;..."
+	 * return: number of records
+     */
+int ICACHE_FLASH_ATTR DEWDTopology::load(const String & resp) {
+	count = 0;
+	bytes = 0;
+	int start = 0;
+	int end;
+	while ((end = resp.indexOf(';', start)) >= 0 && count < TOPO_MAX_NODES) {
+		if (resp[start] == '%' && decode(resp.substring(start + 1, end), records[count])) {
+			bytes += TOPO_HEADER + records[count].child_count * TOPO_SUFFIX;
+			count++;
+		}
+		start = end + 1;
+	}
+	return count;
+}
+
+/* return: index of the record whose MAC ends in suffix, -1 if none
+     */
+int DEWDTopology::find_suffix(const uint8_t * suffix) {
+	for (int i=0; i<count; i++)
+		if (!memcmp(records[i].mac + 6 - TOPO_SUFFIX, suffix, TOPO_SUFFIX))
+			return i;
+	return -1;
+}
+
+/* return: index of the parent's record, -1 for the gateway or a parent that did not answer
+     */
+int DEWDTopology::parent_index(int i) {
+	return find_suffix(records[i].parent);
+}
+
+/* Print the tree, every node indented by its depth, followed by the children that sent no record
+     *
+     */
+String ICACHE_FLASH_ATTR DEWDTopology::print_values(void) {
+	String res = "Topology: ";
+	res += count;
+	res += " nodes, ";
+	res += bytes;
+	res += " bytes";
+	if (count > 0) {
+		res += " (";
+		res += bytes / count;
+		res += " per node)";
+	}
+	
+	for (int i=0; i<count; i++) {
+		DEWDTopologyRecord & r = records[i];
+		res += "\n";
+		for (int d=0; d<r.depth; d++)
+			res += "  ";
+		res += hex_octets(r.mac, 6);
+		res += " depth=";
+		res += r.depth;
+		res += " rssi=";
+		res += r.rssi;
+		res += " parent=";
+		if (parent_index(i) >= 0)
+			res += hex_octets(records[parent_index(i)].mac, 6);
+		else {
+			res += "..:";
+			res += hex_octets(r.parent, TOPO_SUFFIX);
+		}
+		for (int c=0; c<r.child_count; c++) {
+			if (find_suffix(r.children[c]) >= 0)
+				continue;
+			res += " silent=..:";										// station without a record, not a mesh node or asleep
+			res += hex_octets(r.children[c], TOPO_SUFFIX);
+		}
+	}
+	return res;
+}
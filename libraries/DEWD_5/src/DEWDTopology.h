@@ -0,0 +1,50 @@
+/*
+ DEWDTopology.h Header file defining the binary topology records of the MAP_TOPOLOGY broadcast.
+ Every node answers with one record, base64 encoded as the response entry "%<record>;", so relays 
+ concatenate them like any other response. Record layout:
+	<version> <mac 6> <parent 3> <depth> <rssi> <child count> <child 3>...
+ Parent and children are given by the last three octets of their MAC, which the softAP and the station 
+ interface of a node share. The originator decodes the records and rebuilds the tree from them.
+ Created by agent, 2026.
+ 
+ */
+ 
+#ifndef DEWDTopology_h
+#define DEWDTopology_h
+
+#include <WString.h>
+
+	const uint8_t TOPO_VERSION = 1;
+	const int TOPO_SUFFIX = 3;										// octets of a MAC identifying parent and children
+	const int TOPO_MAX_CHILDREN = 8;								// the softAP accepts at most 8 stations
+	const int TOPO_MAX_NODES = 64;									// records kept by the originator
+	const int TOPO_HEADER = 13;										// record length without the children
+
+struct DEWDTopologyRecord {
+	uint8_t mac[6];
+	uint8_t parent[TOPO_SUFFIX];									// all zero if not connected
+	uint8_t depth;													// hops to the gateway
+	int8_t rssi;													// of the link to the parent
+	uint8_t child_count;
+	uint8_t children[TOPO_MAX_CHILDREN][TOPO_SUFFIX];
+};
+
+class DEWDTopology
+{
+public:
+	DEWDTopologyRecord records[TOPO_MAX_NODES];						// last topology received, in response order
+	int count = 0;
+	int bytes = 0;													// record bytes before base64
+	
+	DEWDTopology();
+	static String encode(const DEWDTopologyRecord & r);
+	static bool decode(const String & text, DEWDTopologyRecord & r);
+	int load(const String & resp);
+	int find_suffix(const uint8_t * suffix);
+	int parent_index(int i);
+	String print_values(void);
+};
+
+extern DEWDTopology topology;
+
+#endif
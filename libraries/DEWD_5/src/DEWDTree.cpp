@@ -0,0 +1,144 @@
+/*
+ DEWDTree.cpp Body file defining the spanning-tree view a node keeps of the mesh.
+ Created by agent, 2026.
+ 
+ */
+ 
+#include <Arduino.h>
+#include <DEWDTree.h>
+
+/* Compare two MAC addresses octet by octet
+     *
+	 * return: <0, 0 or >0 like memcmp
+     */
+static int mac_compare(const MACAddress & a, const MACAddress & b) {
+	for (int i=0; i<6; i++) {
+		if (a[i] != b[i])
+			return a[i] - b[i];
+	}
+	return 0;
+}
+
+ICACHE_FLASH_ATTR DEWDTree::DEWDTree() {
+}
+
+/* Forget the parent, e.g. after the STA link was lost or moved to another AP. 
+	Without uplink the node is a root, with a new uplink it waits for the parents hello.
+     *
+	 * param own: STA MAC of this node
+	 * param has_uplink: true if the STA interface is connected to a mesh AP
+     */
+void ICACHE_FLASH_ATTR DEWDTree::reset(MACAddress own, bool has_uplink) {
+	prio = has_uplink ? TREE_PRIO_LOOP : TREE_PRIO_ROOT;
+	root = own;
+	depth = 0;
+	load = 1;
+	parent_in_tree = false;
+	parent_known = false;
+}
+
+/* Compute the own label from the label the parent announced. The parents label is adopted if it 
+	is better than the label this node would have on its own, otherwise the node keeps its own label. 
+	Only a label that contains this node shows a loop, and only then the parent link is not used: a 
+	loop is broken at its lowest MAC, whose label runs round it, not at a node that merely hangs off it.
+     *
+	 * return: true if the own label or parent link changed and has to be announced
+     */
+bool ICACHE_FLASH_ATTR DEWDTree::on_parent_hello(MACAddress own, MACAddress parent, uint8_t p_prio, MACAddress p_root, uint8_t p_depth) {
+	uint8_t old_prio = prio, old_depth = depth;
+	MACAddress old_root = root;
+	bool old_in_tree = parent_in_tree;
+	
+	parent_known = true;
+	parent_mac = parent;
+	
+	bool too_deep = p_depth + 1 >= TREE_MAX_DEPTH;					// a loop without this node in it counts up the depth
+	bool loop = mac_compare(p_root, own) == 0 || too_deep;
+	if (too_deep)
+		depth_limit_hits++;
+	bool better = p_prio < TREE_PRIO_LOOP || (p_prio == TREE_PRIO_LOOP && mac_compare(p_root, own) < 0);
+	
+	if (!loop && better) {
+		prio = p_prio;
+		root = p_root;
+		depth = p_depth + 1;
+	}
+	else {
+		prio = TREE_PRIO_LOOP;
+		root = own;
+		depth = 0;
+	}
+	parent_in_tree = !loop;
+	return prio != old_prio || depth != old_depth || mac_compare(root, old_root) != 0 || parent_in_tree != old_in_tree;
+}
+
+/* Remember whether a child uses its link to this node as tree link
+     *
+     */
+void ICACHE_FLASH_ATTR DEWDTree::on_child_hello(MACAddress child, bool in_tree) {
+	for (int i=0; i<_excluded_count; i++) {
+		if (child == _excluded[i]) {
+			if (in_tree)
+				_excluded[i] = _excluded[--_excluded_count];
+			return;
+		}
+	}
+	if (!in_tree && _excluded_count < MAX_STATIONS)
+		_excluded[_excluded_count++] = child;
+}
+
+/* Whether broadcasts are sent to the parent. Until the parent has announced itself the 
+	link is used, so that a broadcast is never lost while the tree converges.
+     *
+     */
+bool DEWDTree::use_parent() {
+	return parent_in_tree || !parent_known;
+}
+
+bool DEWDTree::child_in_tree(MACAddress child) {
+	for (int i=0; i<_excluded_count; i++) {
+		if (child == _excluded[i])
+			return false;
+	}
+	return true;
+}
+
+/* Forget excluded children that are no longer associated
+     *
+     */
+void ICACHE_FLASH_ATTR DEWDTree::prune_children() {
+	for (int i=0; i<_excluded_count; ) {
+		if (stations.find(_excluded[i]) == NULL)
+			_excluded[i] = _excluded[--_excluded_count];
+		else
+			i++;
+	}
+}
+
+String ICACHE_FLASH_ATTR DEWDTree::print_values(void) {
+	String res = " prio=";
+	res += prio;
+	res += " root=";
+	for (int i=0; i<5; i++) {
+		res += String(root[i], HEX);
+		res += ':';
+	}
+	res += String(root[5], HEX);
+	res += " depth=";
+	res += depth;
+	res += " root_load=";
+	res += load;
+	res += "\n parent_in_tree=";
+	res += parent_in_tree;
+	res += " parent_known=";
+	res += parent_known;
+	res += " excluded_children=";
+	res += _excluded_count;
+	res += "\n broadcasts_sent=";
+	res += broadcasts_sent;
+	res += " wrong_responses_sent=";
+	res += wrong_responses_sent;
+	res += " depth_limit_hits=";
+	res += depth_limit_hits;
+	return res;
+}
@@ -0,0 +1,57 @@
+/*
+ DEWDTree.h Header file defining the spanning-tree view a node keeps of the mesh.
+ Every node has at most one parent (the AP its STA interface is connected to) and any number of 
+ children (the stations on its softAP). Parents announce a label (priority, root MAC, depth) down 
+ the tree in hello messages (flag 'H'); a node that has no mesh uplink is a root, and in a loop of 
+ nodes connected to each others APs the node with the lowest MAC drops its parent link. Broadcasts 
+ are then only sent along tree links, so they are delivered without loops. A mesh with several 
+ gateway roots is a forest: every node belongs to exactly one root's tree, and the root announces 
+ the size of its tree down with the label.
+ Created by agent, 2026.
+ 
+ */
+ 
+#ifndef DEWDTree_h
+#define DEWDTree_h
+
+#include <MACAddress.h>
+#include <WString.h>
+#include <DEWDStations.h>
+
+	const uint8_t TREE_PRIO_ROOT = 0;								// label priority of a node without mesh uplink
+	const uint8_t TREE_PRIO_LOOP = 1;								// label priority of a loop, broken at its lowest MAC
+	const uint8_t TREE_MAX_DEPTH = 64;								// hop limit, far above any real depth: only a label circling in a loop
+																	// whose root has gone grows this deep
+	const unsigned long HELLO_FREQ = 15000;							// how often parents re-announce their label to children. Value is in ms.
+
+class DEWDTree
+{
+private:
+	MACAddress _excluded[MAX_STATIONS];								// children that do not use their link to this node as tree link
+	int _excluded_count = 0;
+
+public:
+	uint8_t prio = TREE_PRIO_ROOT;									// own label
+	MACAddress root;
+	uint8_t depth = 0;
+	uint8_t load = 1;												// nodes in the subtree of the own root, as the root announced it
+	
+	bool parent_in_tree = false;									// false for roots and for the node that broke a loop
+	bool parent_known = false;										// true once a hello from the current parent has been received
+	MACAddress parent_mac;											// STA MAC of the parent
+	
+	uint16_t broadcasts_sent = 0;									// statistics, see print_values()
+	uint16_t wrong_responses_sent = 0;
+	uint16_t depth_limit_hits = 0;									// parent labels dropped for reaching TREE_MAX_DEPTH
+	
+	DEWDTree();
+	void reset(MACAddress own, bool has_uplink);
+	bool on_parent_hello(MACAddress own, MACAddress parent, uint8_t p_prio, MACAddress p_root, uint8_t p_depth);
+	void on_child_hello(MACAddress child, bool in_tree);
+	bool use_parent();
+	bool child_in_tree(MACAddress child);
+	void prune_children();
+	String print_values(void);
+};
+
+#endif
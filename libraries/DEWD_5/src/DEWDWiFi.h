@@ -10,8 +10,18 @@
 #define DEWDWiFi_h
 
 #include <ESP8266WiFi.h>
+#include <EEPROM.h>
 #include "include/wl_definitions.h"
 #include <DEWDESP.h>
+#include <DEWDStations.h>
+#include <DEWDParents.h>
+#include <DEWDRtc.h>
+#include <DEWDStall.h>
+#include <DEWDScan.h>
+#include <DEWDChannel.h>
+#include <DEWDSubnet.h>
+#include <DEWDConsole.h>
+#include <DEWDBackoff.h>
 
 extern "C" {
 #include "user_interface.h"
@@ -26,13 +36,21 @@ extern "C" {
 	const char MESH_SSID[] = "ESP-MESH1";							// This constant is used to connect to the right network and establish sofAP.
 	const char MESH_PASSWORD[] = "password14";
 	const int STA_TIMEOUT = 6;										// Amount of time before giving up on connecting to AP. Value is in seconds.
-	const int RECONN_FREQ = 15;										// How often to attempt to reconnect to the mesh. Value is in seconds.
+	const int FAST_REJOIN_TIMEOUT = 3;								// Same, for rejoining the parent cached in RTC memory, DHCP included. Value is in seconds.
+	const int RECONN_FREQ = 15;										// How often to check the mesh connection. Value is in seconds. Reconnects are timed by DEWDBackoff.
 	const int RECONN_RST_AFTER = 3;									// Restart module if can't connect after 3 tries.
+	const int ROLE_EEPROM_SIZE = 4;									// bytes of the flash-backed EEPROM used for the node role
+	const uint8_t ROLE_MAGIC = 0xD5;								// marks a written role, erased flash reads 0xFF
 
 	bool DEBUG = false;
 	bool MESH_MODE_ACTIVE = true;
 
 	int failed_reconnects = 0;
+	bool gateway_root = false;										// set by 'mesh -g', kept in flash, see load_role()
+	DEWDBackoff reconnect(RECONN_FREQ * 1000);						// when to check the link and to try reconnecting
+	DEWDChannelPlan channel_plan;									// occupancy per channel from the last softAP setup
+	DEWDSubnetPlan subnet_plan;										// softAP subnet derived from the chip ID
+	unsigned long subnet_check_ms = 0;								// millis() of the last conflict check
 
 /* A check to ensure WiFi connection to an AP has not been lost. 
      *
@@ -51,55 +69,55 @@ bool is_connected() {
      */
 bool is_connected_to_mesh(void) {
 	if (DEBUG) {
-		Serial.println("Checking mesh connection...");
-		Serial.print("WiFi status = ");
+		console.println("Checking mesh connection...");
+		console.print("WiFi status = ");
 		switch (WiFi.status()) {
 			case 0:
-				Serial.println("WL_IDLE_STATUS");
+				console.println("WL_IDLE_STATUS");
 				break;
 			case 1:
-				Serial.println("WL_NO_SSID_AVAIL");
+				console.println("WL_NO_SSID_AVAIL");
 				break;
 			case 2:
-				Serial.println("WL_SCAN_COMPLETED");
+				console.println("WL_SCAN_COMPLETED");
 				break;
 			case 3:
-				Serial.println("WL_CONNECTED");
+				console.println("WL_CONNECTED");
 				break;
 			case 4:
-				Serial.println("WL_CONNECT_FAILED");
+				console.println("WL_CONNECT_FAILED");
 				break;
 			case 5:
-				Serial.println("WL_CONNECTION_LOST");
+				console.println("WL_CONNECTION_LOST");
 				break;
 			case 6:
-				Serial.println("WL_DISCONNECTED");
+				console.println("WL_DISCONNECTED");
 				break;
 		}
-		Serial.print("SSID = ");
-		Serial.println(WiFi.SSID());
-		Serial.print("WiFi connection status = ");
+		console.print("SSID = ");
+		console.println(WiFi.SSID());
+		console.print("WiFi connection status = ");
 		switch (wifi_station_get_connect_status()) {
 			case 0:
-				Serial.println("STATION_IDLE");
+				console.println("STATION_IDLE");
 				break;
 			case 1:
-				Serial.println("STATION_CONNECTING");
+				console.println("STATION_CONNECTING");
 				break;
 			case 2:
-				Serial.println("STATION_WRONG_PASSWORD,");
+				console.println("STATION_WRONG_PASSWORD,");
 				break;
 			case 3:
-				Serial.println("STATION_NO_AP_FOUND");
+				console.println("STATION_NO_AP_FOUND");
 				break;
 			case 4:
-				Serial.println("STATION_CONNECT_FAIL");
+				console.println("STATION_CONNECT_FAIL");
 				break;
 			case 5:
-				Serial.println("STATION_GOT_IP");
+				console.println("STATION_GOT_IP");
 				break;
 		}
-		Serial.println();
+		console.println();
 	}
 	if (!strcmp(WiFi.SSID().c_str(), MESH_SSID)) {
 		if (!is_connected()) {
@@ -115,25 +133,59 @@ bool is_connected_to_mesh(void) {
 	return false;	
 }
 
-/* Check if MESH network is active.
+/* Check if MESH network is active. Answered from the scan cache, a background scan is started if 
+	the cached results are older than SCAN_MAX_AGE. Until the first scan has completed the mesh is assumed to be there.
      *
 	 * return: true if there is an active AP with SSID=MESH_SSID
      */
 bool check_mesh_ap(){
-	int n = WiFi.scanNetworks();
-	for (int i = 0; i < n; i++)
-	{
-		if (!strcmp(WiFi.SSID(i).c_str(), MESH_SSID)) {
-			return true;
-		}
+	scans.request(SCAN_MAX_AGE);
+	return !scans.valid || scans.has_ssid(MESH_SSID);
+}
+
+/* Give the mesh APs of the cached scan to the parent table
+     *
+     */
+void feed_scan_results() {
+	for (int i=0; i<scans.count(); i++) {
+		DEWDScanResult * r = scans.get(i);
+		if (!strcmp(r->ssid, MESH_SSID))
+			parents.on_scan_result(r->bssid, r->channel, r->rssi);
 	}
-	return false;
 }
 
-/* Connect to a network with SSID = MESH_SSID
+/* Collect finished background scans. Called once per main-loop iteration.
+     *
+     */
+void scan_maintenance() {
+	if (scans.update()) {
+		feed_scan_results();
+		reconnect.on_scan(parents.joinable(), millis());
+	}
+}
+
+/* Pick the cheapest parent, see DEWDParentTable::cost(). Candidates come from adverts and cached scans; 
+	missing or stale results start a background scan, the next attempt picks up what it found.
+     *
+	 * return: pointer to the chosen candidate, or NULL if no suitable mesh AP is known (yet)
+     */
+DEWDParent * choose_parent() {
+	scans.request(SCAN_MAX_AGE);
+	
+	uint8 own[6];
+	wifi_get_macaddr(STATION_IF, own);
+	return parents.best(MACAddress(own));
+}
+
+/* Connect to a network with SSID = MESH_SSID. The parent is chosen from scan results and 
+	adverts, and its BSSID and channel are given to the SDK explicitly. Every call that finds the 
+	node disconnected makes one attempt and reports it to DEWDBackoff; the SDK's own reconnects are 
+	off, so they cannot retry in lockstep behind the backoff's back.
      *
      */
 void connect_to_mesh() {  
+	if (gateway_root)											// a gateway root keeps its STA off the mesh
+		return;
 
 	if (wifi_get_opmode() > 1)								// if in AP or STA_AP mode...
 		WiFi.mode(WIFI_AP_STA);								// ...set mode to STA_AP
@@ -143,30 +195,67 @@ void connect_to_mesh() {
   	long start_millis = millis(); 
   	int timeout = 0;
 
+	bool fast = rtc.rejoin;											// cached parent is only tried once, right after boot
+	DEWDParent * parent = NULL;
+	if (!fast && !is_connected_to_mesh()) {
+		parent = choose_parent();
+		if (parent == NULL && !scans.valid)							// no candidate yet, try again once the background scan is in
+			return;
+	}
+	
 	if (DEBUG) {
-		Serial.println();
-		Serial.print("Connecting to ");
-		Serial.print(MESH_SSID);
-		Serial.println("...");
+		console.println();
+		console.print("Connecting to ");
+		console.print(MESH_SSID);
+		console.println("...");
 	}
   
-	if (WiFi.SSID() != MESH_SSID) {
-		WiFi.begin(MESH_SSID, MESH_PASSWORD);		
+	rtc.rejoin = false;
+	if (!is_connected_to_mesh()) {
+		wifi_station_set_reconnect_policy(false);				// reconnects are timed by DEWDBackoff
+		WiFi.config(IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0));	// lease by DHCP
+		if (fast) {													// rejoin parent cached in RTC memory: no scan
+			if (DEBUG)
+				console.println("Fast rejoin from RTC cache");
+			WiFi.begin(MESH_SSID, MESH_PASSWORD, rtc.state.parent_channel, rtc.state.parent_bssid);
+		}
+		else {
+			if (parent != NULL) {
+				if (DEBUG) {
+					console.print("Chosen parent:");
+					console.print(" ch=");
+					console.print(parent->channel);
+					console.print(" rssi=");
+					console.print(parent->rssi);
+					console.print(" cost=");
+					console.println(parents.cost(parent));
+				}
+				WiFi.begin(MESH_SSID, MESH_PASSWORD, parent->channel, parent->bssid);
+			}
+			else
+				WiFi.begin(MESH_SSID, MESH_PASSWORD);		
+		}
+		unsigned long stall = stalls.enter();
 		while (WiFi.status() != WL_CONNECTED) {
 			delay(200);														
 			timeout++;
-			if (timeout >= STA_TIMEOUT*5) {
+			if (timeout >= (fast ? FAST_REJOIN_TIMEOUT : STA_TIMEOUT)*5) {
+				stalls.leave("connect_to_mesh", stall);
 				if (DEBUG) {
-					Serial.print("Request timed out after ");
-					Serial.print(millis()-start_millis);
-					Serial.println(" ms");
-					Serial.println();
+					console.print("Request timed out after ");
+					console.print(millis()-start_millis);
+					console.println(" ms");
+					console.println();
 				}				
+				if (fast)											// cached parent is gone, scan next time
+					rtc.forget_parent();
+				wifi_station_disconnect();							// no SDK retries until the next attempt is due
+				reconnect.attempt_failed(millis());
 				failed_reconnects++;
 				if (failed_reconnects >= RECONN_RST_AFTER) {
 					if (!check_mesh_ap()) {
 						if (DEBUG) {
-							Serial.print("RECONN_RST_AFTER reached - disconnecting...");
+							console.print("RECONN_RST_AFTER reached - disconnecting...");
 						}
 						WiFi.disconnect();
 					}	
@@ -175,17 +264,136 @@ void connect_to_mesh() {
 				return;
 			}			
 		}
+		stalls.leave("connect_to_mesh", stall);
 	}	
 	if (DEBUG) {
-		Serial.print("WiFi connected in: ");   
-		Serial.println(millis()-start_millis);
-		Serial.println("Connected to mesh");
-		Serial.println();
+		console.print("WiFi connected in: ");   
+		console.println(millis()-start_millis);
+		console.println("Connected to mesh");
+		console.println();
+	}
+	if (is_connected()) {
+		reconnect.connected(millis());
+		rtc.state.ap_channel = WiFi.channel();						// the softAP has followed the parent
+		rtc.save_link(WiFi.BSSID(), WiFi.channel());
 	}
 	wifi_station_set_auto_connect(true);
 }
 
-/* Set up an open Access Point with SSID=MESH_SSID at random channel, configure AP addresses, start DHCP (default), and start the TCP server
+/* Check the mesh connection and reconnect when DEWDBackoff says so. A lost link is noticed at once, 
+	the check of the SSID and connect status runs every RECONN_FREQ s. Called once per main-loop iteration.
+     *
+     */
+void reconnect_maintenance() {
+	if (gateway_root) {
+		if (is_connected()) {									// the SDK auto-connected after a reset
+			wifi_station_set_auto_connect(false);
+			WiFi.disconnect();
+		}
+		return;
+	}
+	if (reconnect.lost_ms != 0)
+		scans.request(BACKOFF_SCAN_AGE);						// notice a parent coming back
+	else if (!is_connected())
+		reconnect.lost(millis());
+	if (!reconnect.due(millis()))
+		return;
+	if (is_connected_to_mesh())
+		reconnect.connected(millis());
+	else if (reconnect.lost_ms == 0)
+		reconnect.lost(millis());
+	else
+		connect_to_mesh();
+}
+
+/* Read the node role from flash. Call once at boot, before connect_to_mesh().
+     *
+     */
+void load_role() {
+	EEPROM.begin(ROLE_EEPROM_SIZE);
+	gateway_root = EEPROM.read(0) == ROLE_MAGIC && EEPROM.read(1) == 1;
+	EEPROM.end();
+}
+
+/* Make this node a gateway root or a normal mesh node. A gateway root is attached to a host running 
+	the collector; it leaves the mesh AP it is connected to and only serves its softAP, so the mesh 
+	splits into one tree per gateway. The role is written to flash and survives power cycles.
+     *
+	 * param on: true for a gateway root
+     */
+void set_gateway(bool on) {
+	if (on == gateway_root)
+		return;
+	gateway_root = on;
+	EEPROM.begin(ROLE_EEPROM_SIZE);
+	EEPROM.write(0, ROLE_MAGIC);
+	EEPROM.write(1, on ? 1 : 0);
+	EEPROM.commit();
+	EEPROM.end();
+	rtc.forget_parent();										// no fast rejoin of the old parent
+	if (on) {
+		wifi_station_set_auto_connect(false);
+		WiFi.disconnect();
+	}
+	else
+		reconnect.lost(millis());
+}
+
+/* Collect the subnets the own softAP must not use: the parent's and the ones advertised by neighbouring mesh APs
+     *
+	 * param used: array of at least MAX_PARENTS + 1 entries
+	 * return: number of subnets written to used
+     */
+int used_subnets(uint8_t * used) {
+	int n = parents.subnets(used);
+	if (is_connected())
+		used[n++] = WiFi.gatewayIP()[2];
+	return n;
+}
+
+/* Move the own softAP to another subnet when the parent or a neighbouring mesh AP uses the same one. 
+	Of two neighbours the one with the higher softAP MAC moves, a node always moves away from its parent. 
+	Children are dropped and join again with a lease from the new subnet. Called once per main-loop iteration.
+     *
+     */
+void subnet_maintenance() {
+	if (millis() - subnet_check_ms < SUBNET_CHECK_FREQ || subnet_plan.subnet == 0)
+		return;
+	subnet_check_ms = millis();
+	
+	uint8_t own = subnet_plan.subnet;
+	bool conflict = is_connected() && WiFi.gatewayIP()[2] == own;
+	DEWDParent * neighbour = parents.find_subnet(own);
+	if (neighbour != NULL) {
+		uint8_t ap_mac[6];
+		wifi_get_macaddr(SOFTAP_IF, ap_mac);
+		if (memcmp(ap_mac, neighbour->bssid, 6) > 0)
+			conflict = true;
+	}
+	if (!conflict)
+		return;
+	
+	uint8_t used[MAX_PARENTS + 1];
+	uint8_t subn = subnet_plan.choose(ESP.getChipId(), used, used_subnets(used), subnet_plan.attempt + 1);
+	subnet_plan.renumbered++;
+	if (DEBUG) {
+		console.print("Subnet conflict on 192.168.");
+		console.print(own);
+		console.print(".0 - renumbering to 192.168.");
+		console.print(subn);
+		console.println(".0");
+	}
+	
+	IPAddress ap_ip(192, 168, subn, 1);
+	WiFi.softAPConfig(ap_ip, ap_ip, IPAddress(255, 255, 255, 0));
+	WiFi.softAP(MESH_SSID, MESH_PASSWORD, rtc.state.ap_channel);		// restart the softAP, children lease again
+	parents.own_subnet = subn;
+	rtc.state.ap_subnet = subn;
+	rtc.save();
+}
+
+/* Set up an open Access Point with SSID=MESH_SSID, configure AP addresses, start DHCP (default), and start the TCP server.
+	The channel is the parent's, or for a root the least occupied one, see DEWDChannelPlan.
      *
      */
 void setup_mesh() {  
@@ -195,8 +403,31 @@ void setup_mesh() {
 		
 	WiFi.mode(WIFI_AP_STA);		
 
-	int channel = gen_random(13);										// randomly generate channel number
-	int subn = gen_random(256);											// randomly generate private subnet octet (192.168.x.1)				
+	if (!scans.valid) {													// the channel plan needs a scan, wait for it once at boot
+		unsigned long stall = stalls.enter();
+		scans.scan_now();
+		stalls.leave("scan", stall);
+		feed_scan_results();
+	}
+	DEWDParent * parent = choose_parent();
+	uint8_t parent_channel = 0;
+	if (is_connected())
+		parent_channel = WiFi.channel();
+	else if (parent != NULL)
+		parent_channel = parent->channel;								// the STA will join it and drag the softAP along
+	int channel = channel_plan.choose(scans.get(0), scans.count(), parent_channel);
+	uint8_t used[MAX_PARENTS + 1];
+	int subn = subnet_plan.choose(ESP.getChipId(), used, used_subnets(used), 0);	// private subnet octet (192.168.x.1)
+	
+	if (rtc.restored && rtc.state.ap_subnet != 0) {						// same softAP as before sleep/reset, so children find it again
+		channel = rtc.state.ap_channel;
+		subn = rtc.state.ap_subnet;
+		subnet_plan.subnet = subn;
+	}
+	parents.own_subnet = subn;
+	rtc.state.ap_channel = channel;
+	rtc.state.ap_subnet = subn;
+	rtc.save();
 
 	IPAddress locAP(192,168,subn,1);
 	IPAddress gateAP(192,168,subn,1);
@@ -204,42 +435,24 @@ void setup_mesh() {
 	WiFi.softAPConfig(locAP, gateAP, mask);
 
 	if (DEBUG) {
-		Serial.println();
-		Serial.print("Setting up ");
-		Serial.println(MESH_SSID); 
+		console.println();
+		console.print("Setting up ");
+		console.println(MESH_SSID); 
 	}	
-	WiFi.softAP(MESH_SSID, "password14", channel);
+	WiFi.softAP(MESH_SSID, MESH_PASSWORD, channel);
+	stations.begin();													// track clients from softAP events from now on
+	parents.begin();													// advertise tree label, listen to other mesh APs
 	delay(100);
 }
 
-/* Print all detected APs to serial
+/* Print all detected APs to serial, from the scan cache. A background scan is started if the results are stale.
      * 
      */
 void list_all_ap(){
-  int n = WiFi.scanNetworks();
-  Serial.println("Available APs:");
-  Serial.print(n);
-  Serial.println(" networks found.");
-  Serial.println("");
-  for (int i = 0; i < n; i++)
-  {
-    Serial.print(i+1);
-    Serial.print(". ");
-    Serial.print(WiFi.SSID(i));
-    Serial.print(" (");
-    Serial.print(WiFi.RSSI(i));
-    Serial.print(") ");
-	
-	uint8 * mac = WiFi.BSSID(i);
-	for (int i=0;i<5;i++) {
-		Serial.print(*mac, HEX);
-		Serial.print(":");
-		mac++;
-	}
-	Serial.println(*mac, HEX);
-		
-  }
-  Serial.println();
+  scans.request(SCAN_MAX_AGE);
+  console.println("Available APs:");
+  console.println(scans.print_values());
+  console.println();
 }
 
 /* Print all relevant IP and MAC addresses to serial
@@ -253,34 +466,34 @@ void print_IP() {
   uint8 mac[6];
   wifi_get_macaddr(STATION_IF, mac);		//station MAC 
   
-  Serial.print("Station IP:	");
-  Serial.print(local_ip);
-  Serial.print("	");
+  console.print("Station IP:	");
+  console.print(local_ip);
+  console.print("	");
   for (int i=0;i<5;i++) {
-	Serial.print(mac[i], HEX);
-	Serial.print(":");
+	console.print(mac[i], HEX);
+	console.print(":");
   }
-  Serial.println(mac[5], HEX);
+  console.println(mac[5], HEX);
   
-  Serial.print("Access Point IP:");
-  Serial.print(ap_ip);
-  Serial.print("	");
+  console.print("Access Point IP:");
+  console.print(ap_ip);
+  console.print("	");
   wifi_get_macaddr(SOFTAP_IF, mac);
   for (int i=0;i<5;i++) {
-	Serial.print(mac[i], HEX);
-	Serial.print(":");
+	console.print(mac[i], HEX);
+	console.print(":");
   }
-  Serial.println(mac[5], HEX);
+  console.println(mac[5], HEX);
   
-	Serial.print("Gateway IP:	");
-	Serial.print(gateway_ip); 
-	Serial.print("	");
+	console.print("Gateway IP:	");
+	console.print(gateway_ip); 
+	console.print("	");
 	uint8 * mac_gate = WiFi.BSSID();
 	for (int i=0;i<5;i++) {
-		Serial.print(*mac_gate, HEX);
-		Serial.print(":");
+		console.print(*mac_gate, HEX);
+		console.print(":");
 		mac_gate++;
 	}
-	Serial.println(*mac_gate, HEX);
+	console.println(*mac_gate, HEX);
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,879 @@
+/*
+ dewd_collector.cpp is a host-side collector for the DEWD project. It runs on the Linux PC the root node 
+ is connected to, issues broadcast queries over the root's serial console and stores the responses as 
+ structured rows (node MAC, command, value, timestamps) in a compact binary file. With several gateway 
+ roots (-d given more than once) every query goes to all of them and their answers are merged into 
+ one file, as if the mesh had a single root.
+ Created by agent, 2026.
+ 
+ Build:	g++ -O2 -std=c++11 -o dewd_collector dewd_collector.cpp
+ Usage:	dewd_collector -d /dev/ttyUSB0 [-d /dev/ttyUSB1]... [-b 9600] [-f 921600] [-G] -o data.dwc [-q "SENSOR 0"] [-i 60]
+			-q may be given more than once, all queries are issued every -i seconds (once if -i is 0), 
+			one at a time: the next is sent when the root has replied to the last one
+			-f switches the roots to the framed link at the given baud rate, see DEWDConsole.h
+			-G makes the node on every device a gateway root ('mesh -g 1', kept in the node's flash), so the mesh 
+			splits into one tree per device
+		dewd_collector -r data.dwc			print a file as CSV
+		dewd_collector -T [frames]			throughput self-test of the framed link over a pseudo terminal
+ 
+ The root prints "B <id> <src_ip> <command>" when it starts a broadcast and "R <id> <mac> <value>;<mac> <value>;..." 
+ when the broadcast is complete, every other line is console output and ignored. A streamed query ('tcp -S') 
+ prints its answers as they arrive, "S <id> <answers>/<expected> <mac> <value>;...", followed by an empty R.
+ "BUSY <reason>" and busy entries "!<mac> busy" mean the mesh is rate limiting, the interval is doubled 
+ (up to 16 times) until the queries go through again. MAP_TOPOLOGY records 
+ ("%<base64>" entries) are stored decoded, one row per node. On the framed link the same 
+ lines arrive as FRAME_STARTED and FRAME_RESULT frames, checked by CRC and sequence number. 
+ A node that moves to another root while a query runs may answer through both, only its first answer 
+ per query round is stored.
+ 
+ File format, little endian: the 8-byte magic "DEWDCOL1", followed by records
+	'C' <u16 index> <u16 len> <command>											command definition
+	'V' <u64 host_ms> <u32 mesh_ms> <6 byte mac> <u16 command> <u16 len> <value>	one row, mesh_ms 0 if the node did not report it
+ Command indices are defined by the 'C' record before their first use, and redefined by every run appending to a file.
+ 
+ */
+ 
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+	const char FILE_MAGIC[] = "DEWDCOL1";
+	const size_t MAX_LINE = 65536;									// longer lines are console garbage
+	const int MAX_PENDING = 64;										// queries waiting for their response
+	const int LINK_SWITCH_TIMEOUT = 3000;							// ms the root has to confirm 'link -f'
+	const int COMMAND_PACE = 1500;									// ms to wait for the root's reply before sending the next command anyway
+
+	// frame types, same as DEWDConsole.h
+	const uint8_t FRAME_TEXT = 1;
+	const uint8_t FRAME_COMMAND = 2;
+	const uint8_t FRAME_STARTED = 3;
+	const uint8_t FRAME_RESULT = 4;
+	const uint8_t FRAME_METRICS = 5;
+	const uint8_t FRAME_LINK = 6;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int) {
+	stop_requested = 1;
+}
+
+static uint64_t now_ms() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/* Open a serial port in raw mode
+     *
+	 * param path: device, i.e. /dev/ttyUSB0
+	 * param baud: baud rate
+	 * return: file descriptor, -1 on error
+     */
+static bool set_serial(int fd, int baud) {
+	speed_t speed;
+	switch (baud) {
+		case 9600:		speed = B9600; break;
+		case 19200:		speed = B19200; break;
+		case 38400:		speed = B38400; break;
+		case 57600:		speed = B57600; break;
+		case 115200:	speed = B115200; break;
+		case 230400:	speed = B230400; break;
+		case 460800:	speed = B460800; break;
+		case 921600:	speed = B921600; break;
+		default:
+			fprintf(stderr, "unsupported baud rate %d\n", baud);
+			return false;
+	}
+	
+	struct termios tio;
+	if (tcgetattr(fd, &tio) < 0)
+		return false;
+	cfmakeraw(&tio);
+	cfsetispeed(&tio, speed);
+	cfsetospeed(&tio, speed);
+	tio.c_cflag |= CLOCAL | CREAD;
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+	if (tcsetattr(fd, TCSANOW, &tio) < 0)
+		return false;
+	tcflush(fd, TCIOFLUSH);
+	return true;
+}
+
+static int open_serial(const char * path, int baud) {
+	int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (fd < 0)
+		return -1;
+	if (!set_serial(fd, baud)) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static uint16_t crc16(const uint8_t * data, size_t len) {
+	uint16_t crc = 0xFFFF;											// CRC-16/CCITT-FALSE, as on the node
+	for (size_t i=0; i<len; i++) {
+		crc ^= (uint16_t)data[i] << 8;
+		for (int b=0; b<8; b++)
+			crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
+
+/* Encode a frame: <type> <seq> <payload> <crc16 hi> <crc16 lo>, COBS encoded and terminated by 0x00
+     *
+     */
+static std::string encode_frame(uint8_t type, uint8_t seq, const std::string & payload) {
+	std::string raw;
+	raw.reserve(payload.size() + 4);
+	raw += (char)type;
+	raw += (char)seq;
+	raw += payload;
+	uint16_t crc = crc16((const uint8_t *)raw.data(), raw.size());
+	raw += (char)(crc >> 8);
+	raw += (char)(crc & 0xFF);
+	
+	std::string out;
+	out.reserve(raw.size() + raw.size() / 254 + 2);
+	size_t code_pos = 0;
+	out += '\0';
+	for (size_t i=0; i<raw.size(); i++) {
+		if (raw[i] != 0)
+			out += raw[i];
+		if (raw[i] == 0 || out.size() - code_pos == 255) {
+			out[code_pos] = (char)(out.size() - code_pos);
+			code_pos = out.size();
+			out += '\0';
+		}
+	}
+	out[code_pos] = (char)(out.size() - code_pos);
+	out += '\0';
+	return out;
+}
+
+/* Incremental decoder of the frames sent by the root
+     *
+     */
+class FrameDecoder
+{
+private:
+	std::vector<uint8_t> _encoded;
+	std::vector<uint8_t> _frame;
+	int _seq = -1;
+
+public:
+	uint64_t frames = 0;
+	uint64_t crc_errors = 0;
+	uint64_t seq_gaps = 0;
+	
+	/* Feed one byte
+	     *
+		 * param type, payload, len: set to the frame content when a valid frame is complete
+		 * return: true if a valid frame is complete
+	     */
+	bool feed(uint8_t c, uint8_t & type, const char *& payload, size_t & len) {
+		if (c != 0) {
+			if (_encoded.size() < MAX_LINE)
+				_encoded.push_back(c);
+			return false;
+		}
+		if (_encoded.empty())
+			return false;
+		
+		_frame.clear();
+		for (size_t i=0; i<_encoded.size(); ) {
+			uint8_t code = _encoded[i++];
+			for (int j=1; j<code && i<_encoded.size(); j++)
+				_frame.push_back(_encoded[i++]);
+			if (code != 0xFF && i < _encoded.size())
+				_frame.push_back(0);
+		}
+		_encoded.clear();
+		
+		if (_frame.size() < 4 || crc16(_frame.data(), _frame.size() - 2) 
+			!= ((_frame[_frame.size() - 2] << 8) | _frame[_frame.size() - 1])) {
+			crc_errors++;
+			return false;
+		}
+		if (_seq >= 0 && _frame[1] != (uint8_t)(_seq + 1))
+			seq_gaps++;
+		_seq = _frame[1];
+		frames++;
+		type = _frame[0];
+		payload = (const char *)_frame.data() + 2;
+		len = _frame.size() - 4;
+		return true;
+	}
+};
+
+/* Append-only writer for the row file
+     *
+     */
+class RowWriter
+{
+private:
+	FILE * _file = NULL;
+	std::map<std::string, uint16_t> _commands;
+	
+	void put(const void * data, size_t len) {
+		fwrite(data, 1, len, _file);
+	}
+
+public:
+	uint64_t rows = 0;
+	
+	bool open(const char * path) {
+		_file = fopen(path, "ab");
+		if (_file == NULL)
+			return false;
+		setvbuf(_file, NULL, _IOFBF, 1 << 16);
+		if (ftell(_file) == 0)
+			put(FILE_MAGIC, 8);
+		return true;
+	}
+	
+	uint16_t command(const std::string & cmd) {
+		std::map<std::string, uint16_t>::iterator it = _commands.find(cmd);
+		if (it != _commands.end())
+			return it->second;
+		uint16_t index = _commands.size();
+		uint16_t len = cmd.size();
+		_commands[cmd] = index;
+		put("C", 1);
+		put(&index, 2);
+		put(&len, 2);
+		put(cmd.data(), len);
+		return index;
+	}
+	
+	void row(uint64_t host_ms, uint32_t mesh_ms, const uint8_t * mac, uint16_t cmd, const char * value, size_t len) {
+		uint16_t l = len > 0xFFFF ? 0xFFFF : len;
+		put("V", 1);
+		put(&host_ms, 8);
+		put(&mesh_ms, 4);
+		put(mac, 6);
+		put(&cmd, 2);
+		put(&l, 2);
+		put(value, l);
+		rows++;
+	}
+	
+	void flush() {
+		if (_file != NULL)
+			fflush(_file);
+	}
+	
+	void close() {
+		if (_file != NULL)
+			fclose(_file);
+		_file = NULL;
+	}
+};
+
+/* Parse a MAC address as printed by the nodes, i.e. "5c:cf:7f:1:a2:3"
+     *
+	 * return: true if six octets were found
+     */
+static bool parse_mac(const char * s, size_t len, uint8_t * mac) {
+	int octet = 0;
+	size_t i = 0;
+	while (octet < 6) {
+		unsigned value = 0;
+		size_t digits = 0;
+		for (; i < len && isxdigit((unsigned char)s[i]); i++, digits++)
+			value = value * 16 + (isdigit((unsigned char)s[i]) ? s[i] - '0' : (tolower(s[i]) - 'a' + 10));
+		if (digits == 0 || digits > 2)
+			return false;
+		mac[octet++] = value;
+		if (octet < 6) {
+			if (i >= len || s[i] != ':')
+				return false;
+			i++;
+		}
+	}
+	return i == len;
+}
+
+/* Decode a MAP_TOPOLOGY record, "%<base64>" in a response, see DEWDTopology.h
+     *
+	 * param mac: set to the MAC of the node
+	 * param value: set to "parent=..:<suffix> depth=<n> rssi=<dBm> children=..:<suffix>,..."
+	 * return: true if the record is valid
+     */
+static bool decode_topology(const char * s, size_t len, uint8_t * mac, std::string & value) {
+	static const char BASE64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	std::vector<uint8_t> raw;
+	uint32_t bits = 0;
+	int count = 0;
+	for (size_t i=0; i<len; i++) {
+		const char * p = (const char *)memchr(BASE64, s[i], 64);
+		if (p == NULL)
+			return false;
+		bits = (bits << 6) | (p - BASE64);
+		count += 6;
+		if (count >= 8) {
+			count -= 8;
+			raw.push_back(bits >> count);
+		}
+	}
+	if (raw.size() < 13 || raw[0] != 1 || raw.size() != 13 + (size_t)raw[12] * 3)
+		return false;
+	
+	memcpy(mac, &raw[1], 6);
+	char buf[64];
+	snprintf(buf, sizeof(buf), "parent=..:%02x:%02x:%02x depth=%u rssi=%d children=", raw[7], raw[8], raw[9], 
+		raw[10], (int8_t)raw[11]);
+	value = buf;
+	for (int c=0; c<raw[12]; c++) {
+		snprintf(buf, sizeof(buf), "%s..:%02x:%02x:%02x", c > 0 ? "," : "", raw[13 + c * 3], raw[14 + c * 3], raw[15 + c * 3]);
+		value += buf;
+	}
+	return true;
+}
+
+/* Merge layer for several roots: remembers which nodes have answered which command in the current 
+	query round
+     *
+     */
+class RoundFilter
+{
+private:
+	std::set<std::string> _seen;									// 6 byte MAC + 2 byte command index
+
+public:
+	uint64_t duplicates = 0;
+	
+	void next_round() {
+		_seen.clear();
+	}
+	
+	/* return: true for the first answer of a node to a command in this round
+	     */
+	bool first(const uint8_t * mac, uint16_t cmd) {
+		std::string key((const char *)mac, 6);
+		key.append((const char *)&cmd, 2);
+		if (_seen.insert(key).second)
+			return true;
+		duplicates++;
+		return false;
+	}
+};
+
+/* Query state and line handling of one root
+     *
+     */
+class Collector
+{
+private:
+	RowWriter & _out;
+	RoundFilter & _filter;
+	std::map<int, std::string> _pending;						// broadcast id -> command
+
+	void on_started(const char * line, size_t len) {
+		// "B <id> <src_ip> <command>"
+		char * end;
+		long id = strtol(line + 2, &end, 10);
+		const char * ip = end + 1;
+		const char * cmd = (const char *)memchr(ip, ' ', line + len - ip);
+		if (cmd == NULL)
+			return;
+		if (_pending.size() >= (size_t)MAX_PENDING)
+			_pending.erase(_pending.begin());
+		_pending[id] = std::string(cmd + 1, line + len - cmd - 1);
+	}
+	
+	void on_response(const char * line, size_t len, uint64_t host_ms) {
+		// "R <id> <mac> <value>;<mac> <value>;...", or streamed "S <id> <answers>/<expected> <mac> <value>;..."
+		char * end;
+		long id = strtol(line + 2, &end, 10);
+		bool streamed = line[0] == 'S';
+		if (streamed) {
+			end = (char *)memchr(end + 1, ' ', line + len - end - 1);
+			if (end == NULL)
+				return;
+		}
+		std::map<int, std::string>::iterator it = _pending.find(id);
+		std::string command = it != _pending.end() ? it->second : "?";
+		if (it != _pending.end() && !streamed)							// the final R of a streamed query is empty
+			_pending.erase(it);
+		uint16_t cmd = _out.command(command);
+		uint16_t trace = 0xFFFF;
+		
+		const char * p = end;
+		const char * stop = line + len;
+		while (p < stop) {
+			while (p < stop && *p == ' ')
+				p++;
+			if (p >= stop)
+				break;
+			const char * entry_end = (const char *)memchr(p, ';', stop - p);
+			if (entry_end == NULL)
+				entry_end = stop;
+			const char * entry = p;
+			p = entry_end + 1;
+			
+			if (entry >= entry_end)
+				continue;
+			uint8_t mac[6];
+			if (*entry == '%') {
+				std::string value;
+				if (!decode_topology(entry + 1, entry_end - entry - 1, mac, value)) {
+					malformed++;
+					continue;
+				}
+				if (_filter.first(mac, cmd))
+					_out.row(host_ms, 0, mac, cmd, value.data(), value.size());
+				continue;
+			}
+			if (*entry == '!') {									// relay over the rate limit, see DEWDAdmission.h
+				busy++;
+				backoff_due = true;
+				continue;
+			}
+			bool is_trace = *entry == '~';
+			if (is_trace)
+				entry++;
+			const char * space = (const char *)memchr(entry, ' ', entry_end - entry);
+			if (space == NULL || !parse_mac(entry, space - entry, mac)) {
+				malformed++;
+				continue;
+			}
+			const char * value = space + 1;
+			uint32_t mesh_ms = 0;
+			if (*value == '@')										// SENSOR_AT: "@<mesh_ms> err=<ms> <sensor response>"
+				mesh_ms = strtoul(value + 1, NULL, 10);
+			if (is_trace && trace == 0xFFFF)
+				trace = _out.command(command + " ~trace");
+			if (!is_trace && !_filter.first(mac, cmd))
+				continue;
+			_out.row(host_ms, mesh_ms, mac, is_trace ? trace : cmd, value, entry_end - value);
+		}
+		responses++;
+	}
+
+public:
+	uint64_t responses = 0;
+	uint64_t malformed = 0;
+	uint64_t busy = 0;												// BUSY lines and busy entries
+	bool backoff_due = false;										// the mesh asked for fewer queries
+	
+	Collector(RowWriter & out, RoundFilter & filter) : _out(out), _filter(filter) {
+	}
+	
+	void line(const char * line, size_t len, uint64_t host_ms) {
+		while (len > 0 && (line[len - 1] == '\r' || line[len - 1] == '\0'))
+			len--;
+		if (len > 5 && !memcmp(line, "BUSY ", 5)) {
+			busy++;
+			backoff_due = true;
+		}
+		else if (len > 2 && line[0] == 'B' && line[1] == ' ')
+			on_started(line, len);
+		else if (len > 2 && (line[0] == 'R' || line[0] == 'S') && line[1] == ' ')
+			on_response(line, len, host_ms);
+	}
+};
+
+/* Print a row file as CSV: host_ms,mesh_ms,mac,command,value
+     *
+     */
+static int dump(const char * path) {
+	FILE * f = fopen(path, "rb");
+	if (f == NULL) {
+		perror(path);
+		return 1;
+	}
+	char magic[8];
+	if (fread(magic, 1, 8, f) != 8 || memcmp(magic, FILE_MAGIC, 8) != 0) {
+		fprintf(stderr, "%s: not a collector file\n", path);
+		fclose(f);
+		return 1;
+	}
+	
+	std::vector<std::string> commands;
+	std::string value;
+	printf("host_ms,mesh_ms,mac,command,value\n");
+	int type;
+	while ((type = fgetc(f)) != EOF) {
+		if (type == 'C') {
+			uint16_t index, len;
+			if (fread(&index, 2, 1, f) != 1 || fread(&len, 2, 1, f) != 1)
+				break;
+			std::string cmd(len, '\0');
+			if (len > 0 && fread(&cmd[0], 1, len, f) != len)
+				break;
+			if (commands.size() <= index)
+				commands.resize(index + 1);
+			commands[index] = cmd;
+		}
+		else if (type == 'V') {
+			uint64_t host_ms;
+			uint32_t mesh_ms;
+			uint8_t mac[6];
+			uint16_t cmd, len;
+			if (fread(&host_ms, 8, 1, f) != 1 || fread(&mesh_ms, 4, 1, f) != 1 || fread(mac, 1, 6, f) != 6 
+				|| fread(&cmd, 2, 1, f) != 1 || fread(&len, 2, 1, f) != 1)
+				break;
+			value.assign(len, '\0');
+			if (len > 0 && fread(&value[0], 1, len, f) != len)
+				break;
+			
+			printf("%llu,%u,%02x:%02x:%02x:%02x:%02x:%02x,\"", (unsigned long long)host_ms, mesh_ms, 
+				mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+			const std::string & c = cmd < commands.size() ? commands[cmd] : std::string("?");
+			for (size_t i=0; i<c.size(); i++)
+				fputs(c[i] == '"' ? "\"\"" : std::string(1, c[i]).c_str(), stdout);
+			printf("\",\"");
+			for (size_t i=0; i<value.size(); i++)
+				fputs(value[i] == '"' ? "\"\"" : std::string(1, value[i]).c_str(), stdout);
+			printf("\"\n");
+		}
+		else {
+			fprintf(stderr, "%s: corrupt record\n", path);
+			break;
+		}
+	}
+	fclose(f);
+	return 0;
+}
+
+/* Wait for the root to confirm 'link -f' with "LINK <baud>" and follow it to the new baud rate
+     *
+	 * return: true if the link is framed now
+     */
+static bool switch_to_framed(int fd, int baud) {
+	char cmd[32];
+	snprintf(cmd, sizeof(cmd), "link -f %d\n", baud);
+	if (write(fd, cmd, strlen(cmd)) < 0)
+		return false;
+	
+	char expected[32];
+	snprintf(expected, sizeof(expected), "LINK %d", baud);
+	std::string line;
+	uint64_t deadline = now_ms() + LINK_SWITCH_TIMEOUT;
+	while (now_ms() < deadline) {
+		struct pollfd pfd = {fd, POLLIN, 0};
+		if (poll(&pfd, 1, 100) <= 0)
+			continue;
+		char c;
+		while (read(fd, &c, 1) == 1) {
+			if (c != '\n') {
+				if (c != '\r')
+					line += c;
+				continue;
+			}
+			if (line == expected) {
+				tcdrain(fd);
+				if (!set_serial(fd, baud))
+					return false;
+				std::string confirm = encode_frame(FRAME_LINK, 0, "host");	// any valid frame confirms the link
+				return write(fd, confirm.data(), confirm.size()) == (ssize_t)confirm.size();
+			}
+			line.clear();
+		}
+	}
+	fprintf(stderr, "root did not confirm the framed link\n");
+	return false;
+}
+
+/* Throughput self-test of the framed link: a child process sends result frames over a pseudo terminal 
+	as the root would, every 100th of them corrupted, and the parent decodes them.
+     *
+	 * param count: number of frames
+	 * return: exit code, 0 if every frame was accounted for
+     */
+static int self_test(long count) {
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+		perror("posix_openpt");
+		return 1;
+	}
+	int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+	if (slave < 0 || !set_serial(master, 921600) || !set_serial(slave, 921600)) {
+		perror("pty");
+		return 1;
+	}
+	
+	std::string payload = "R 123 ";
+	for (int i=0; i<8; i++)
+		payload += "5c:cf:7f:1:a2:3 @123456 err=4 17 data from sensor|;";
+	
+	uint64_t start = now_ms();
+	pid_t pid = fork();
+	if (pid == 0) {
+		close(master);
+		std::string buf;
+		for (long i=0; i<count; i++) {
+			std::string frame = encode_frame(FRAME_RESULT, (uint8_t)i, payload);
+			if (i % 100 == 99)
+				frame[frame.size() / 2] ^= 0x5A;					// corrupted on the line
+			buf += frame;
+			if (buf.size() >= 4096 || i == count - 1) {
+				for (size_t off = 0; off < buf.size(); ) {
+					ssize_t n = write(slave, buf.data() + off, buf.size() - off);
+					if (n < 0 && errno != EAGAIN && errno != EINTR)
+						_exit(1);
+					if (n > 0)
+						off += n;
+				}
+				buf.clear();
+			}
+		}
+		tcdrain(slave);
+		_exit(0);
+	}
+	close(slave);
+	
+	FrameDecoder decoder;
+	uint64_t bytes = 0, good = 0;
+	long corrupted = count / 100;
+	char buf[4096];
+	while ((long)(decoder.frames + decoder.crc_errors) < count) {
+		struct pollfd pfd = {master, POLLIN, 0};
+		if (poll(&pfd, 1, 2000) <= 0)
+			break;
+		ssize_t n = read(master, buf, sizeof(buf));
+		if (n <= 0)
+			break;
+		bytes += n;
+		for (ssize_t i=0; i<n; i++) {
+			uint8_t type;
+			const char * data;
+			size_t len;
+			if (decoder.feed(buf[i], type, data, len) && type == FRAME_RESULT && len == payload.size()
+				&& memcmp(data, payload.data(), len) == 0)
+				good++;
+		}
+	}
+	double seconds = (now_ms() - start) / 1000.0;
+	waitpid(pid, NULL, 0);
+	close(master);
+	
+	printf("%llu bytes in %.2f s: %.2f MB/s, %.0f frames/s\n", (unsigned long long)bytes, seconds, 
+		bytes / seconds / 1e6, decoder.frames / seconds);
+	printf("%llu frames intact, %llu crc errors (%ld corrupted), %llu seq gaps\n", (unsigned long long)good,
+		(unsigned long long)decoder.crc_errors, corrupted, (unsigned long long)decoder.seq_gaps);
+	return good == (uint64_t)(count - corrupted) && decoder.crc_errors == (uint64_t)corrupted ? 0 : 1;
+}
+
+/* Serial link to one root
+     *
+     */
+struct Port
+{
+	const char * device;
+	int fd;
+	FrameDecoder decoder;
+	uint8_t tx_seq;
+	std::vector<char> line;
+	Collector collector;
+	std::deque<std::string> outbox;								// commands not sent yet
+	bool awaiting;													// a command was sent and the root has not replied yet
+	uint64_t sent_ms;
+	
+	Port(const char * dev, RowWriter & out, RoundFilter & filter) : device(dev), fd(-1), tx_seq(1), collector(out, filter), 
+		awaiting(false), sent_ms(0) {
+	}
+	
+	void send(const std::string & cmd) {
+		outbox.push_back(cmd);
+	}
+	
+	/* Write the next command once the root has answered the last one (any line or frame counts), 
+		or after COMMAND_PACE ms, so the root's console gets one command at a time
+	     *
+	     */
+	void pump(uint64_t now, bool framed) {
+		if (outbox.empty() || (awaiting && now - sent_ms < (uint64_t)COMMAND_PACE))
+			return;
+		std::string data = framed ? encode_frame(FRAME_COMMAND, tx_seq++, outbox.front()) : outbox.front() + "\n";
+		outbox.pop_front();
+		if (write(fd, data.data(), data.size()) < 0)
+			perror(device);
+		awaiting = true;
+		sent_ms = now;
+	}
+};
+
+static void usage() {
+	fprintf(stderr, "usage: dewd_collector -d <device> [-d <device>]... [-b <baud>] [-f <baud>] [-G] -o <file> [-q <command>]... [-i <interval_s>]\n"
+					"       dewd_collector -r <file>\n"
+					"       dewd_collector -T [frames]\n");
+}
+
+int main(int argc, char ** argv) {
+	std::vector<const char *> devices;
+	const char * output = NULL;
+	int baud = 9600;
+	int framed_baud = 0;
+	int interval = 0;
+	bool gateways = false;
+	std::vector<std::string> queries;
+	
+	int opt;
+	while ((opt = getopt(argc, argv, "d:b:f:Go:q:i:r:T")) != -1) {
+		switch (opt) {
+			case 'd': devices.push_back(optarg); break;
+			case 'b': baud = atoi(optarg); break;
+			case 'f': framed_baud = atoi(optarg); break;
+			case 'G': gateways = true; break;
+			case 'o': output = optarg; break;
+			case 'q': queries.push_back(optarg); break;
+			case 'i': interval = atoi(optarg); break;
+			case 'r': return dump(optarg);
+			case 'T': return self_test(optind < argc ? atol(argv[optind]) : 100000);
+			default: usage(); return 2;
+		}
+	}
+	if (devices.empty() || output == NULL) {
+		usage();
+		return 2;
+	}
+	
+	RowWriter out;
+	RoundFilter filter;
+	std::vector<Port *> ports;
+	for (size_t i=0; i<devices.size(); i++) {
+		Port * port = new Port(devices[i], out, filter);
+		port->fd = open_serial(devices[i], baud);
+		if (port->fd < 0) {
+			perror(devices[i]);
+			return 1;
+		}
+		if (framed_baud > 0 && !switch_to_framed(port->fd, framed_baud))
+			return 1;
+		port->line.reserve(MAX_LINE);
+		if (gateways)												// the node keeps the role in flash
+			port->send("mesh -g 1");
+		ports.push_back(port);
+	}
+	if (!out.open(output)) {
+		perror(output);
+		return 1;
+	}
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	
+	std::vector<struct pollfd> pfds(ports.size());
+	char buf[4096];
+	uint64_t next_query = now_ms();
+	bool queried = false;
+	int backoff = 1;												// interval multiplier while the mesh reports busy
+	
+	while (!stop_requested) {
+		uint64_t now = now_ms();
+		if (!queries.empty() && now >= next_query && (interval > 0 || !queried)) {
+			bool backoff_due = false;
+			for (size_t p=0; p<ports.size(); p++) {
+				for (size_t i=0; i<queries.size(); i++)
+					ports[p]->send("tcp -b " + queries[i]);
+				backoff_due |= ports[p]->collector.backoff_due;
+				ports[p]->collector.backoff_due = false;
+			}
+			filter.next_round();
+			queried = true;
+			if (backoff_due)
+				backoff = backoff < 16 ? backoff * 2 : 16;
+			else if (backoff > 1)
+				backoff /= 2;
+			next_query = now + (uint64_t)interval * 1000 * backoff;
+		}
+		
+		bool sending = false;
+		for (size_t p=0; p<ports.size(); p++) {
+			ports[p]->pump(now, framed_baud > 0);
+			sending |= !ports[p]->outbox.empty();
+			pfds[p].fd = ports[p]->fd;
+			pfds[p].events = POLLIN;
+			pfds[p].revents = 0;
+		}
+		int timeout = 1000;
+		if (interval > 0 && next_query > now && next_query - now < (uint64_t)timeout)
+			timeout = next_query - now;
+		if (sending)
+			timeout = 100;
+		int ready = poll(pfds.data(), pfds.size(), timeout);
+		if (ready < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("poll");
+			break;
+		}
+		if (ready == 0) {
+			out.flush();											// idle, make the rows visible to readers
+			continue;
+		}
+		
+		for (size_t p=0; p<ports.size(); p++) {
+			if (!(pfds[p].revents & POLLIN))
+				continue;
+			Port & port = *ports[p];
+			ssize_t n = read(port.fd, buf, sizeof(buf));
+			if (n <= 0)
+				continue;
+			uint64_t received = now_ms();
+			for (ssize_t i=0; i<n; i++) {
+				if (framed_baud > 0) {
+					uint8_t type;
+					const char * data;
+					size_t len;
+					if (!port.decoder.feed(buf[i], type, data, len))
+						continue;
+					port.awaiting = false;
+					if (type == FRAME_STARTED || type == FRAME_RESULT)
+						port.collector.line(data, len, received);
+					continue;
+				}
+				if (buf[i] != '\n') {
+					if (port.line.size() < MAX_LINE)
+						port.line.push_back(buf[i]);
+					continue;
+				}
+				port.awaiting = false;
+				port.collector.line(port.line.data(), port.line.size(), received);
+				port.line.clear();
+			}
+		}
+	}
+	
+	uint64_t responses = 0, malformed = 0, busy = 0;
+	for (size_t p=0; p<ports.size(); p++) {
+		Port & port = *ports[p];
+		if (framed_baud > 0) {										// leave the root's console usable as text
+			std::string frame = encode_frame(FRAME_LINK, port.tx_seq++, "text");
+			if (write(port.fd, frame.data(), frame.size()) < 0)
+				perror(port.device);
+			tcdrain(port.fd);
+			fprintf(stderr, "%s: %llu frames, %llu crc errors, %llu seq gaps\n", port.device, (unsigned long long)port.decoder.frames,
+				(unsigned long long)port.decoder.crc_errors, (unsigned long long)port.decoder.seq_gaps);
+		}
+		if (ports.size() > 1)
+			fprintf(stderr, "%s: %llu responses\n", port.device, (unsigned long long)port.collector.responses);
+		responses += port.collector.responses;
+		malformed += port.collector.malformed;
+		busy += port.collector.busy;
+		close(port.fd);
+		delete ports[p];
+	}
+	out.close();
+	fprintf(stderr, "%llu responses, %llu rows, %llu malformed entries, %llu busy, %llu duplicates\n", (unsigned long long)responses,
+		(unsigned long long)out.rows, (unsigned long long)malformed, (unsigned long long)busy, (unsigned long long)filter.duplicates);
+	return 0;
+}
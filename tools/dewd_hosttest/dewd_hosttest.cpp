@@ -0,0 +1,1856 @@
+/*
+ dewd_hosttest.cpp runs classes of the DEWD library on a Linux PC, on top of the simulated Arduino core
+ in host/ (simulated clock, seeded random(), a radio that reports what the test sets). Tests check a
+ class against known answers. Simulations model a mesh around the real classes and print the figures
+ the commit log quotes, so they can be reproduced.
+ Created by agent, 2026.
+
+ Build:	g++ -O2 -std=gnu++17 -Ihost -I../../libraries/DEWD_5/src -o dewd_hosttest dewd_hosttest.cpp host/host.cpp ../../libraries/DEWD_5/src/[DM]*.cpp
+ Usage:	dewd_hosttest					run every test, the exit status is 1 if one fails
+		dewd_hosttest <test>...			run the given tests
+		dewd_hosttest -s <simulation> [runs]	run a simulation, averaged over runs seeds
+		dewd_hosttest -l				list tests and simulations
+		Run it in this directory when built as above, the channel test reads the scan tables in scans/.
+
+ */
+
+#include <host.h>
+#include <DEWDAdmission.h>
+#include <DEWDBackoff.h>
+#include <DEWDChannel.h>
+#include <DEWDLink.h>
+#include <DEWDMailbox.h>
+#include <DEWDTcp.h>
+#include <DEWDTime.h>
+#include <DEWDTopology.h>
+#include <DEWDTopoSync.h>
+#include <DEWDTree.h>
+#include <DEWDRoute.h>
+#include <DEWDRtc.h>
+#include <DEWDSleep.h>
+#include <DEWDStations.h>
+#include <DEWDSubnet.h>
+#include <DEWDParents.h>
+#include <algorithm>
+#include <chrono>
+#include <dirent.h>
+#include <fstream>
+#include <cmath>
+#include <deque>
+#include <functional>
+#include <map>
+#include <queue>
+#include <random>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+/* return: median of v, v is sorted
+     */
+static double median(std::vector<double>& v) {
+	std::sort(v.begin(), v.end());
+	return v.empty() ? 0 : v[v.size() / 2];
+}
+
+/* return: p-th percentile of v, v is sorted
+     */
+static double percentile(std::vector<double>& v, int p) {
+	std::sort(v.begin(), v.end());
+	return v.empty() ? 0 : v[std::min(v.size() - 1, v.size() * p / 100)];
+}
+
+static MACAddress mesh_mac(int n) {
+	return MACAddress(0x5c, 0xcf, 0x7f, 0, n >> 8, n & 0xFF);
+}
+
+/* Build a random mesh tree: every node hangs below a random node before it whose softAP has room
+     *
+	 * param parent: index of each node's parent, -1 for node 0, the root
+     */
+static void mesh_tree(std::mt19937& rng, int n, std::vector<int>& parent) {
+	std::vector<int> children(n, 0);
+	parent.assign(n, -1);
+	for (int i = 1; i < n; i++) {
+		do
+			parent[i] = rng() % i;
+		while (children[parent[i]] == MAX_STATIONS);
+		children[parent[i]]++;
+	}
+}
+
+/* return: the parent and children of node i
+     */
+static std::vector<int> mesh_links(const std::vector<int>& parent, int i) {
+	std::vector<int> res;
+	if (parent[i] >= 0)
+		res.push_back(parent[i]);
+	for (size_t j = 0; j < parent.size(); j++)
+		if (parent[j] == i)
+			res.push_back(j);
+	return res;
+}
+
+/* return: hops between nodes a and b of a mesh tree
+     */
+static int mesh_hops(const std::vector<int>& parent, int a, int b) {
+	std::vector<int> up;
+	for (int i = a; i >= 0; i = parent[i])
+		up.push_back(i);
+	for (int hops = 0; b >= 0; b = parent[b], hops++) {
+		std::vector<int>::iterator it = std::find(up.begin(), up.end(), b);
+		if (it != up.end())
+			return hops + (it - up.begin());
+	}
+	return -1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//		DEWDAdmission
+/////////////////////////////////////////////////////////////////////////////////
+
+static void test_admission() {
+	MACAddress a(1, 2, 3, 4, 5, 6), b(1, 2, 3, 4, 5, 7);
+	const unsigned long starts[] = {1000, 0xFFFFFFFFUL - 30000};	// the second one crosses the millis() wrap
+	for (unsigned long start : starts) {
+		DEWDAdmission adm;
+		int ok = 0;
+		for (unsigned long t = 0; t < 60000; t += 100)				// 10/s for a minute: the burst, then the rate
+			ok += adm.admit(a, start + t);
+		CHECK(ok >= ADMIT_BURST + ADMIT_RATE - 1 && ok <= ADMIT_BURST + ADMIT_RATE);
+		CHECK(adm.admit(b, start + 60000));							// every originator has its own bucket
+		CHECK(adm.dropped_rate == 600 - (unsigned)ok);
+		CHECK(adm.admit(a, start + 60000 + 120000));				// a full bucket after a quiet period
+	}
+	
+	DEWDAdmission adm;
+	CHECK(adm.may_start(ADMIT_IN_FLIGHT - 1) && !adm.may_start(ADMIT_IN_FLIGHT));
+	CHECK(adm.configure(""));										// ADMIT without fields only reports
+	CHECK(adm.rate == ADMIT_RATE && adm.burst == ADMIT_BURST && adm.in_flight == ADMIT_IN_FLIGHT);
+	CHECK(adm.configure("60"));										// missing fields are left as they are
+	CHECK(adm.rate == 60 && adm.burst == ADMIT_BURST && adm.in_flight == ADMIT_IN_FLIGHT);
+	CHECK(adm.configure("60 8"));
+	CHECK(adm.rate == 60 && adm.burst == 8 && adm.in_flight == ADMIT_IN_FLIGHT);
+	const char* malformed[] = {"x", "60 x", "60 8 x", "60 8 2 1", "70000", "60 300", " 60", "-1"};
+	for (const char* args : malformed) {
+		CHECK(!adm.configure(args));
+		CHECK(adm.rate == 60 && adm.burst == 8 && adm.in_flight == ADMIT_IN_FLIGHT);
+	}
+	CHECK(adm.configure("0 1 0"));									// rate limiting off on purpose
+	CHECK(adm.rate == 0 && adm.in_flight == 0);
+	for (int i = 0; i < 100; i++)
+		CHECK(adm.admit(a, 5000));
+	CHECK(adm.may_start(50));
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//		DEWDBackoff
+/////////////////////////////////////////////////////////////////////////////////
+
+static void test_backoff() {
+	for (unsigned long seed = 1; seed <= 50; seed++) {
+		host_seed(seed);
+		DEWDBackoff b(15000);
+		b.connected(0);
+		CHECK(!b.due(14999));
+		CHECK(b.due(15000));
+
+		// the first attempt follows within BACKOFF_BASE
+		b.lost(20000);
+		CHECK(b.due(20000 + BACKOFF_BASE));
+		unsigned long now = 20000;
+		while (!b.due(now))
+			now++;
+		CHECK(now - 20000 <= BACKOFF_BASE);
+
+		// every failure doubles the wait, half of it random, up to BACKOFF_CAP
+		for (int k = 0; k < 8; k++) {
+			b.attempt_failed(now);
+			unsigned long wait = std::min(BACKOFF_BASE << k, BACKOFF_CAP);
+			unsigned long next = now;
+			while (!b.due(next))
+				next++;
+			CHECK(next - now >= wait / 2);
+			CHECK(next - now <= wait);
+			now = next;
+		}
+		CHECK(b.attempts == 8);
+
+		// a parent that can be joined appearing in a scan moves the next attempt to within BACKOFF_FAST
+		b.attempt_failed(now);
+		b.on_scan(2, now + 100);
+		CHECK(!b.due(now + 100 + BACKOFF_FAST) || b.due(now + BACKOFF_CAP / 2));
+		b.on_scan(3, now + 200);
+		CHECK(b.fast == 1);
+		CHECK(b.due(now + 200 + BACKOFF_FAST));
+		b.on_scan(3, now + 300);
+		CHECK(b.fast == 1);
+
+		b.connected(now + 5000);
+		CHECK(b.attempts == 0);
+		CHECK(b.recovery_ms == now + 5000 - 20000);
+		CHECK(!b.due(now + 5000 + 14999));
+	}
+}
+
+	const int SIM_NODES = 40;
+	const unsigned long SIM_ROOT_BOOT = 5000;
+	const unsigned long SIM_JOIN = 1500;
+	const unsigned long SIM_FAIL = 6000;
+	const unsigned long SIM_COLLISION = 1000;
+	const int SIM_MAX_CHILDREN = 4;
+	const unsigned long SIM_RECONN_FREQ = 15000;					// fixed schedule before DEWDBackoff
+	const unsigned long SIM_SCAN = 10000;
+	const unsigned long SIM_TICK = 20;
+	const unsigned long SIM_LIMIT = 2000000;
+
+struct SimNode {
+	DEWDBackoff backoff = DEWDBackoff(15000);
+	unsigned long next = 0;											// old schedule
+	unsigned long busy_until = 0;
+	unsigned long scan_at = 0;
+	unsigned long up_at = 0;										// softAP serves from here, 0 while detached
+	int depth = 0;
+	int children = 0;
+	std::vector<unsigned long> starts;								// association attempts on this AP
+};
+
+/* A root restarts and all nodes of a mesh lose their link at once. A node attempts to reconnect
+	either on the old fixed schedule (RECONN_FREQ after an attempt ended, with the link checks of all
+	nodes aligned or at random phases) or when its DEWDBackoff says so, fed with a scan every 10 s 
+	that counts the parents in the tree with room.
+	An AP takes at most SIM_MAX_CHILDREN stations, two attempts on one AP within SIM_COLLISION ms
+	make the later one fail, a failed attempt keeps the node busy for SIM_FAIL ms. A node
+	that joined serves its softAP after SIM_JOIN ms. The node picks the shallowest AP with room,
+	the strongest one among equals.
+     *
+	 * param use_backoff: false for the fixed schedule
+	 * param aligned: start the fixed schedule of all nodes within 0.5 s
+	 * param seed: seed of the model and of random()
+	 * return: ms until every node joined, SIM_LIMIT if some did not
+     */
+static unsigned long reconnect_run(bool use_backoff, bool aligned, unsigned long seed) {
+	std::mt19937 rng(seed);
+	host_seed(seed);
+	std::uniform_real_distribution<double> uni(0, 1);
+	std::vector<SimNode> nodes(SIM_NODES);
+	std::vector<double> rssi(SIM_NODES * SIM_NODES);
+	for (double& r : rssi)
+		r = uni(rng);
+	nodes[0].up_at = SIM_ROOT_BOOT;
+	for (int n = 1; n < SIM_NODES; n++) {
+		nodes[n].next = aligned ? rng() % 500 : rng() % SIM_RECONN_FREQ;
+		nodes[n].scan_at = rng() % SIM_SCAN;
+		nodes[n].backoff.lost(rng() % 500);
+	}
+	int joined = 0;
+	for (unsigned long t = 0; t < SIM_LIMIT; t += SIM_TICK) {
+		for (int n = 1; n < SIM_NODES; n++) {
+			SimNode& node = nodes[n];
+			if (node.up_at != 0 || t < node.busy_until)
+				continue;
+			if (use_backoff && t >= node.scan_at) {
+				int aps = 0;										// as DEWDParentTable::joinable()
+				for (int a = 0; a < SIM_NODES; a++)
+					aps += a != n && nodes[a].up_at != 0 && nodes[a].up_at <= t && nodes[a].children < SIM_MAX_CHILDREN;
+				node.backoff.on_scan(aps, t);
+				node.scan_at += SIM_SCAN;
+			}
+			if (use_backoff ? !node.backoff.due(t) : t < node.next)
+				continue;
+			int best = -1;
+			for (int a = 0; a < SIM_NODES; a++) {
+				if (a == n || nodes[a].up_at == 0 || nodes[a].up_at > t || nodes[a].children >= SIM_MAX_CHILDREN)
+					continue;
+				if (best < 0 || nodes[a].depth < nodes[best].depth || (nodes[a].depth == nodes[best].depth && rssi[n * SIM_NODES + a] > rssi[n * SIM_NODES + best]))
+					best = a;
+			}
+			bool ok = false;
+			if (best >= 0) {
+				ok = true;
+				for (unsigned long s : nodes[best].starts)
+					if (t - s < std::max(SIM_COLLISION, SIM_JOIN))
+						ok = false;
+				nodes[best].starts.push_back(t);
+			}
+			if (ok) {
+				nodes[best].children++;
+				node.depth = nodes[best].depth + 1;
+				node.up_at = t + SIM_JOIN;
+				node.backoff.connected(t + SIM_JOIN);
+				if (++joined == SIM_NODES - 1)
+					return t + SIM_JOIN;
+			} else {
+				node.busy_until = t + SIM_FAIL;
+				node.next = node.busy_until + SIM_RECONN_FREQ;
+				node.backoff.attempt_failed(node.busy_until);
+			}
+		}
+	}
+	return SIM_LIMIT;
+}
+
+static void sim_reconnect(int runs) {
+	printf("%d nodes, root back after %lu s, %d runs\n", SIM_NODES - 1, SIM_ROOT_BOOT / 1000, runs);
+	const char* names[] = {"fixed 15 s, link checks aligned", "fixed 15 s, link checks at random phases", "DEWDBackoff"};
+	for (int policy = 0; policy < 3; policy++) {
+		std::vector<double> all;
+		for (int seed = 1; seed <= runs; seed++)
+			all.push_back(reconnect_run(policy == 2, policy == 0, seed) / 1000.0);
+		printf(" %-42s all joined after median %4.0f s, p90 %4.0f s\n", names[policy], median(all), percentile(all, 90));
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//		DEWDBroadcast
+/////////////////////////////////////////////////////////////////////////////////
+
+	const int QUERY_NODES = 50;
+	const double QUERY_SHARE = 0.2;									// share of the nodes that have an answer, the others answer "No response"
+	const double QUERY_LOOP = 505;									// main-loop period: the 500 ms delay of ESP_mesh_7 and the work
+	const double QUERY_EXEC = 5;									// ms a node takes for its own response
+
+/* A message of a query on its way over a tree link
+     */
+struct QueryMsg {
+	double at;														// ms the receiver handles it, on its next main-loop iteration
+	int seq;
+	char flag;														// 'B', 'R' final response, '+' partial response, 'X' cancel
+	int from, to;
+	int entries, answers;											// response entries it carries, and how many of them are answers
+	bool operator<(const QueryMsg& m) const { return at != m.at ? at > m.at : seq > m.seq; }
+};
+
+struct QueryNode {
+	double phase;													// ms of the first main-loop iteration
+	bool answers;
+	bool active = false;											// holds a slot in active_broadcasts
+	int pending = 0;												// resp_index: final responses still expected
+	int entries = 0, found = 0;										// collected for the full response
+	double link_free = 0;											// arrival of the last message sent to the parent, TCP keeps the order
+};
+
+/* Run one query from the root of a random tree as parse_broadcast(), add_response() and 
+	parse_cancel() in DEWDComm.h handle it. A line takes 3 ms plus an exponential 10 ms on average 
+	and is handled on the receivers next main-loop iteration.
+     *
+	 * param limit: #A<limit>, 0 for none
+	 * param stream: #S
+	 * param first: ms until the first answer reaches the originator
+	 * param done: ms until the originator has all answers or cancelled the rest
+	 * param answers: answers the originator received
+	 * return: messages sent
+     */
+static int query_run(int limit, bool stream, unsigned long seed, double& first, double& done, int& answers) {
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<double> uni(0, 1);
+	std::exponential_distribution<double> net(1 / 10.0);
+	std::vector<int> parent;
+	mesh_tree(rng, QUERY_NODES, parent);
+	std::vector<QueryNode> nodes(QUERY_NODES);
+	for (QueryNode& node : nodes) {
+		node.phase = uni(rng) * QUERY_LOOP;
+		node.answers = uni(rng) < QUERY_SHARE;
+	}
+	bool at_once = limit > 0 || stream;
+	std::priority_queue<QueryMsg> wire;
+	int sent = 0, seq = 0;
+	auto send = [&](double now, char flag, int from, int to, int entries, int found) {
+		double arrive = now + 3 + net(rng);
+		if (to == parent[from])
+			arrive = nodes[from].link_free = std::max(arrive, nodes[from].link_free);
+		double at = nodes[to].phase + ceil((arrive - nodes[to].phase) / QUERY_LOOP) * QUERY_LOOP;
+		wire.push({at, seq++, flag, from, to, entries, found});
+		sent++;
+	};
+	auto children = [&](int i) {
+		std::vector<int> res = mesh_links(parent, i);
+		if (parent[i] >= 0)
+			res.erase(res.begin());
+		return res;
+	};
+	
+	first = done = -1;
+	answers = 0;
+	nodes[0].active = true;
+	nodes[0].pending = children(0).size();
+	for (int c : children(0))										// start_broadcast() forwards before it answers itself
+		send(0, 'B', 0, c, 0, 0);
+	if (nodes[0].answers) {
+		answers = 1;
+		first = at_once ? QUERY_EXEC : -1;
+	}
+	if (limit > 0 && answers >= limit) {
+		done = QUERY_EXEC;
+		for (int c : children(0))
+			send(done, 'X', 0, c, 0, 0);
+	}
+	
+	while (!wire.empty() && done < 0) {
+		QueryMsg m = wire.top();
+		wire.pop();
+		QueryNode& node = nodes[m.to];
+		std::vector<int> below = children(m.to);
+		if (m.flag == 'B') {
+			bool counts = limit == 0 || node.answers;				// a limited query only passes answers up
+			if (below.empty()) {
+				send(m.at + QUERY_EXEC, 'R', m.to, m.from, counts, node.answers);
+				continue;
+			}
+			node.active = true;
+			node.pending = below.size();
+			if (!at_once) {
+				node.entries = 1;
+				node.found = node.answers;
+			}
+			else if (counts)
+				send(m.at + QUERY_EXEC, '+', m.to, m.from, 1, node.answers);
+			for (int c : below)
+				send(m.at + QUERY_EXEC, 'B', m.to, c, 0, 0);
+		}
+		else if (m.flag == 'X') {
+			if (!node.active)
+				continue;
+			node.active = false;
+			for (int c : below)
+				send(m.at, 'X', m.to, c, 0, 0);
+		}
+		else {
+			if (!node.active)										// cancelled, the response is dropped
+				continue;
+			if (m.to == 0) {
+				if (m.answers > 0 && first < 0)
+					first = at_once ? m.at : -1;
+				answers += m.answers;
+				if (limit > 0 && answers >= limit) {
+					done = m.at;
+					for (int c : below)
+						send(m.at, 'X', 0, c, 0, 0);
+					break;
+				}
+			}
+			else if (at_once && m.entries > 0)
+				send(m.at, '+', m.to, parent[m.to], m.entries, m.answers);
+			else {
+				node.entries += m.entries;
+				node.found += m.answers;
+			}
+			if (m.flag == 'R' && --node.pending == 0) {
+				node.active = false;
+				if (m.to == 0)
+					done = m.at;
+				else
+					send(m.at, 'R', m.to, parent[m.to], at_once ? 0 : node.entries, at_once ? 0 : node.found);
+			}
+		}
+	}
+	while (!wire.empty()) {											// cancels and answers still on the way
+		QueryMsg m = wire.top();
+		wire.pop();
+		if (m.flag == 'X' && nodes[m.to].active) {
+			nodes[m.to].active = false;
+			for (int c : children(m.to))
+				send(m.at, 'X', m.to, c, 0, 0);
+		}
+	}
+	if (first < 0 && answers > 0)
+		first = done;												// a full response brings all answers at once
+	return sent;
+}
+
+/* Time to the first answer and messages of a full query against streamed (#S) and limited (#A) ones, 
+	on the same random trees
+     */
+static void sim_query(int runs) {
+	printf("random trees of %d nodes, %.0f %% of them have an answer, %.0f ms main loop, query from the root, %d runs\n", 
+		QUERY_NODES, QUERY_SHARE * 100, QUERY_LOOP, runs);
+	struct { const char* name; int limit; bool stream; } modes[] = {
+		{"full broadcast", 0, false}, {"#S streamed", 0, true}, {"#A1", 1, false}, {"#A5", 5, false},
+	};
+	for (auto& mode : modes) {
+		std::vector<double> first, done;
+		double sent = 0, answers = 0;
+		for (int seed = 1; seed <= runs; seed++) {
+			double f, d;
+			int a;
+			sent += query_run(mode.limit, mode.stream, seed, f, d, a);
+			answers += a;
+			if (f >= 0)
+				first.push_back(f);
+			done.push_back(d);
+		}
+		printf(" %-15s first answer median %5.0f ms, p90 %5.0f ms, done median %5.0f ms, %5.1f messages, %4.1f answers\n", 
+			mode.name, median(first), percentile(first, 90), median(done), sent / runs, answers / runs);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//		DEWDChannelPlan
+/////////////////////////////////////////////////////////////////////////////////
+
+/* Read a scan table in the format of "print -a", see scans/README
+     *
+	 * return: number of APs read into results, -1 if the file cannot be opened
+     */
+static int channel_table(const std::string& path, DEWDScanResult* results, int& expect, int& parent) {
+	std::ifstream in(path);
+	if (!in)
+		return -1;
+	int n = 0;
+	expect = parent = 0;
+	std::string line;
+	while (std::getline(in, line)) {
+		sscanf(line.c_str(), "# expect: %d", &expect);
+		sscanf(line.c_str(), "# parent: %d", &parent);
+		size_t dot = line.find(". "), open = line.rfind(" ("), ch = line.rfind(") ch=");
+		if (dot == std::string::npos || open == std::string::npos || ch == std::string::npos || open < dot || n == SCAN_MAX_RESULTS)
+			continue;
+		DEWDScanResult& r = results[n];
+		memset(&r, 0, sizeof(r));
+		strncpy(r.ssid, line.substr(dot + 2, open - dot - 2).c_str(), sizeof(r.ssid) - 1);
+		int rssi, channel;
+		unsigned int b[6];
+		if (sscanf(line.c_str() + open, " (%d) ch=%d %x:%x:%x:%x:%x:%x", &rssi, &channel, &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]) != 8)
+			continue;
+		r.rssi = rssi;
+		r.channel = channel;
+		for (int i = 0; i < 6; i++)
+			r.bssid[i] = b[i];
+		n++;
+	}
+	return n;
+}
+
+static void test_channel() {
+	std::string dir = __FILE__;
+	dir = dir.substr(0, dir.rfind('/') + 1) + "scans/";
+	DIR* d = opendir(dir.c_str());
+	CHECK(d != NULL);
+	if (d == NULL)
+		return;
+	int tables = 0;
+	while (struct dirent* e = readdir(d)) {
+		std::string name = e->d_name;
+		if (name.size() < 4 || name.substr(name.size() - 4) != ".txt")
+			continue;
+		DEWDScanResult results[SCAN_MAX_RESULTS];
+		int expect, parent;
+		int n = channel_table(dir + name, results, expect, parent);
+		DEWDChannelPlan plan;
+		uint8_t chosen = plan.choose(results, n, parent);
+		if (n < 0 || chosen != expect)
+			printf("  %s: %d APs, chose %d, expected %d\n %s\n", name.c_str(), n, chosen, expect, plan.print_values().c_str());
+		CHECK(n >= 0 && chosen == expect);
+		tables++;
+	}
+	closedir(d);
+	CHECK(tables > 0);
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//		DEWDMailbox
+/////////////////////////////////////////////////////////////////////////////////
+
+static void test_mailbox_order() {
+	host_us = 0;
+	DEWDMailbox box;
+	MACAddress child(0x5c, 0xcf, 0x7f, 0, 0, 2), other(0x5c, 0xcf, 0x7f, 0, 0, 3);
+	CHECK(box.oldest(child) < 0);
+	box.put(child, "1");
+	box.put(other, "x");
+	box.put(child, "2");
+	box.delivered_mail(box.oldest(child));							// "1" goes, its slot is free again
+	box.put(child, "3");											// takes the freed slot in front of "2"
+	String order;
+	for (int i; (i = box.oldest(child)) >= 0; box.delivered_mail(i))
+		order += box.get(i)->packet;
+	CHECK(order == "23");
+	CHECK(box.pending(other) == 1 && box.delivered == 3);
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//		DEWDMeshTime
+/////////////////////////////////////////////////////////////////////////////////
+
+static void test_mesh_time() {
+	DEWDMeshTime mt;
+	unsigned long t1 = 10000;
+	for (int i = 0; i < TIME_SAMPLES; i++) {
+		CHECK(mt.request_due(t1));
+		mt.request_sent(t1);
+		// parent is 50000 ms ahead, 20 ms each way, the request waited 460 ms for the parent's loop
+		bool done = mt.on_reply(t1, t1 + 20 + 460 + 50000, t1 + 500, 0, 3, 460);
+		CHECK(done == (i == TIME_SAMPLES - 1));
+		t1 += 500;
+	}
+	CHECK(mt.offset == 50000);
+	CHECK(mt.stratum == 1 && mt.error_ms == 3 + 20);
+	CHECK(!mt.request_due(t1));
+	CHECK(!mt.on_reply(t1 - 500, 0, t1, 0, 0, 0));				// stale
+}
+
+	const int SKEW_HOPS = 5;										// chain below the root
+	const unsigned long SKEW_DELAY = 500;							// main-loop delay, as in ESP_mesh_7
+	const double SKEW_PPM = 40;										// crystal tolerance, each clock is off by up to this
+	const double SKEW_RUN = 600000;									// ms simulated, samples are taken after the first two minutes
+	const double SKEW_SAMPLE_FREQ = 7000;							// ms between SENSOR_AT instants
+
+struct SkewLine {
+	bool reply;
+	double arrive;													// true time the line reaches the receiver
+	unsigned long t1, t2, error_ms, hold_ms;
+	uint8_t stratum;
+};
+
+struct SkewNode {
+	DEWDMeshTime clock;
+	double drift, start;											// local millis() = start + t * (1 + drift)
+	double next_loop = 0;
+	std::vector<SkewLine> inbox;
+	
+	unsigned long local(double t) { return (unsigned long)(start + t * (1 + drift)); }
+	unsigned long mesh(double t) { return local(t) + clock.offset; }
+	double when_mesh(unsigned long mesh_ms) { return ((double)(mesh_ms - clock.offset) - start) / (1 + drift); }
+};
+
+/* Run the time sync over a chain of SKEW_HOPS nodes below the root on DEWDMeshTime, and take 
+	SENSOR_AT samples every SKEW_SAMPLE_FREQ ms.
+	Every node loops every SKEW_DELAY ms plus 2..8 ms of work. A TCP line takes 3 ms plus an exponential 
+	10 ms on average, 2 % of the connects lose their SYN and take the 3 s retransmission timeout. The 
+	receiver stamps a line when its loop comes round, or with ingress polling at most TCP_POLL ms after it 
+	arrived. Each node samples at most 2 ms after its clock reaches the agreed mesh time.
+     *
+	 * param poll: read lines during the main-loop delay and report the hold at the parent
+	 * param seed: seed of the model
+	 * param skew: |sample time - root's sample time| in ms, appended per hop
+	 * param bound: error_ms of the node at the sample, appended per hop
+     */
+static void skew_run(bool poll, unsigned long seed, std::vector<std::vector<double>>& skew, std::vector<std::vector<double>>& bound) {
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<double> uni(0, 1);
+	std::exponential_distribution<double> net(1 / 10.0);
+	auto transit = [&]() { return 3 + net(rng) + (uni(rng) < 0.02 ? LINK_RTO_US / 1000.0 : 0); };
+	
+	std::vector<SkewNode> nodes(SKEW_HOPS + 1);
+	for (SkewNode& node : nodes) {
+		node.drift = (uni(rng) * 2 - 1) * SKEW_PPM / 1e6;
+		node.start = 100000 + uni(rng) * 1e6;
+		node.next_loop = uni(rng) * SKEW_DELAY;
+	}
+	nodes[0].clock.become_root();
+	
+	for (double sample_t = 120000; sample_t < SKEW_RUN; sample_t += SKEW_SAMPLE_FREQ) {
+		while (true) {
+			int n = 0;
+			for (int i = 1; i <= SKEW_HOPS; i++)
+				if (nodes[i].next_loop < nodes[n].next_loop)
+					n = i;
+			SkewNode& node = nodes[n];
+			double t = node.next_loop;
+			if (t >= sample_t)
+				break;
+			
+			if (n > 0 && node.clock.request_due(node.local(t))) {		// time_maintenance()
+				SkewLine q = {false, t + transit(), node.local(t), 0, 0, 0, 0};
+				node.clock.request_sent(q.t1);
+				nodes[n - 1].inbox.push_back(q);
+			}
+			for (size_t i = 0; i < node.inbox.size(); ) {			// TCP listener
+				SkewLine line = node.inbox[i];
+				if (line.arrive > t) {
+					i++;
+					continue;
+				}
+				node.inbox.erase(node.inbox.begin() + i);
+				double stamped = poll ? std::min(t, line.arrive + uni(rng) * TCP_POLL) : t;
+				if (line.reply)
+					node.clock.on_reply(line.t1, line.t2, node.local(stamped), line.stratum, line.error_ms, line.hold_ms);
+				else {
+					SkewLine a = {true, t + transit(), line.t1, node.mesh(t), node.clock.error_ms, 
+						poll ? node.local(t) - node.local(stamped) : 0, node.clock.stratum};
+					nodes[n + 1].inbox.push_back(a);
+				}
+			}
+			node.next_loop = t + 2 + uni(rng) * 6 + SKEW_DELAY;
+		}
+		
+		unsigned long at = nodes[0].mesh(sample_t) + 3000;			// SENSOR_AT +3
+		double root_t = nodes[0].when_mesh(at) + uni(rng) * 2;
+		for (int n = 1; n <= SKEW_HOPS; n++) {
+			if (!nodes[n].clock.synced())
+				continue;
+			skew[n - 1].push_back(fabs(nodes[n].when_mesh(at) + uni(rng) * 2 - root_t));
+			bound[n - 1].push_back(nodes[n].clock.error_ms);
+		}
+	}
+}
+
+static void sim_skew(int runs) {
+	printf("chain of %d hops, %lu ms main-loop delay, clocks within %.0f ppm, %d runs, SENSOR_AT every %.0f s\n", 
+		SKEW_HOPS, SKEW_DELAY, SKEW_PPM, runs, SKEW_SAMPLE_FREQ / 1000);
+	for (int poll = 0; poll < 2; poll++) {
+		std::vector<std::vector<double>> skew(SKEW_HOPS), bound(SKEW_HOPS);
+		for (int seed = 1; seed <= runs; seed++)
+			skew_run(poll, seed, skew, bound);
+		printf(" %s\n", poll ? "lines read every TCP_POLL ms, hold reported by the parent" : "lines read once per loop");
+		for (int h = 0; h < SKEW_HOPS; h++) {
+			int within = 0;
+			for (size_t i = 0; i < skew[h].size(); i++)
+				within += skew[h][i] <= bound[h][i] + 2;
+			double within_pct = 100.0 * within / std::max<size_t>(1, skew[h].size());
+			printf("  hop %d: skew to the root median %4.0f ms, p95 %4.0f ms, max %5.0f ms, error_ms median %4.0f, skew within it %5.1f %%\n", 
+				h + 1, median(skew[h]), percentile(skew[h], 95), percentile(skew[h], 100), median(bound[h]), within_pct);
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//		DEWDParentTable
+/////////////////////////////////////////////////////////////////////////////////
+
+	const int JOIN_SIM_NODES = 40;
+	const double JOIN_SIM_AREA = 80;								// m, side of the square the nodes are placed in, the root in its middle
+	const double JOIN_SIM_SHADOW = 4;								// dB, standard deviation of the shadowing of a link
+
+/* Join JOIN_SIM_NODES nodes one after the other in random order, each to a node that has joined 
+	before it, is in range and has room. RSSI follows a log-distance model, -40 dBm at 1 m, path 
+	loss exponent 3, plus a shadowing that is fixed per link. The first roots nodes are gateway roots, 
+	one in the middle of the square or two or three on a circle around it.
+     *
+	 * param policy: JOIN_COST the cheapest candidate of DEWDParentTable::best(), JOIN_NO_LOAD the same with 
+		adverts that carry no root load, JOIN_STRONGEST the strongest mesh AP as the SDK picks it, JOIN_RANDOM a random one
+	 * param level: depth of each node, -1 if it could not join
+	 * param root: root of each node's tree, -1 if it could not join
+	 * return: nodes that could not join
+     */
+enum JoinPolicy { JOIN_COST, JOIN_STRONGEST, JOIN_RANDOM, JOIN_NO_LOAD };
+
+static int join_run(JoinPolicy policy, int roots, unsigned long seed, std::vector<int>& level, std::vector<int>& root) {
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<double> uni(0, JOIN_SIM_AREA);
+	std::normal_distribution<double> shadow(0, JOIN_SIM_SHADOW);
+	std::vector<double> x(JOIN_SIM_NODES), y(JOIN_SIM_NODES);
+	for (int i = 0; i < JOIN_SIM_NODES; i++) {
+		double angle = 2 * M_PI * i / roots, r = roots > 1 ? JOIN_SIM_AREA / 4 : 0;
+		x[i] = i < roots ? JOIN_SIM_AREA / 2 + r * cos(angle) : uni(rng);
+		y[i] = i < roots ? JOIN_SIM_AREA / 2 + r * sin(angle) : uni(rng);
+	}
+	std::vector<int> rssi(JOIN_SIM_NODES * JOIN_SIM_NODES);
+	for (int i = 0; i < JOIN_SIM_NODES; i++)
+		for (int j = 0; j < i; j++) {
+			double d = std::max(1.0, hypot(x[i] - x[j], y[i] - y[j]));
+			rssi[i * JOIN_SIM_NODES + j] = rssi[j * JOIN_SIM_NODES + i] = lround(-40 - 30 * log10(d) + shadow(rng));
+		}
+	
+	std::vector<int> children(JOIN_SIM_NODES, 0), order;
+	level.assign(JOIN_SIM_NODES, -1);
+	root.assign(JOIN_SIM_NODES, -1);
+	for (int i = 0; i < roots; i++)
+		level[i] = 0, root[i] = i;
+	for (int i = roots; i < JOIN_SIM_NODES; i++)
+		order.push_back(i);
+	std::shuffle(order.begin(), order.end(), rng);
+	for (bool progress = true; progress; ) {
+		progress = false;
+		for (int n : order) {
+			if (level[n] >= 0)
+				continue;
+			std::vector<int> aps;									// joined, in range and with room, weakest first
+			for (int a = 0; a < JOIN_SIM_NODES; a++)
+				if (level[a] >= 0 && rssi[n * JOIN_SIM_NODES + a] >= JOIN_RSSI_MIN && children[a] < JOIN_MAX_CHILDREN)
+					aps.push_back(a);
+			std::sort(aps.begin(), aps.end(), [&](int a, int b) { return rssi[n * JOIN_SIM_NODES + a] < rssi[n * JOIN_SIM_NODES + b]; });
+			if (aps.empty())
+				continue;
+			int p = -1;
+			if (policy == JOIN_COST || policy == JOIN_NO_LOAD) {
+				DEWDParentTable table;								// the stalest entry makes room: the strongest MAX_PARENTS stay
+				for (int a : aps) {
+					host_us += 1000;
+					MACAddress bssid = mesh_mac(a + 1), root_mac = mesh_mac(root[a] + 1);
+					uint8_t load = std::min<long>(255, std::count(root.begin(), root.end(), root[a]));
+					uint8_t ie[DEWD_IE_LEN] = {DEWD_IE_VERSION, TREE_PRIO_ROOT, (uint8_t)level[a], (uint8_t)children[a]};
+					for (int k = 0; k < 6; k++)
+						ie[4 + k] = root_mac[k];
+					ie[11] = policy == JOIN_COST && roots > 1 ? load : 0;		// a single root's load is the same for every candidate
+					table.on_scan_result(&bssid[0], 1, rssi[n * JOIN_SIM_NODES + a]);
+					table.on_advert(&bssid[0], ie, DEWD_IE_LEN, rssi[n * JOIN_SIM_NODES + a]);
+				}
+				DEWDParent* best = table.best(mesh_mac(n + 1));
+				p = best == NULL ? -1 : best->bssid[5] - 1;
+			}
+			else
+				p = policy == JOIN_STRONGEST ? aps.back() : aps[rng() % aps.size()];
+			if (p < 0)
+				continue;
+			level[n] = level[p] + 1;
+			root[n] = root[p];
+			children[p]++;
+			progress = true;
+		}
+	}
+	return std::count(level.begin(), level.end(), -1);
+}
+
+/* Depth of the tree a joining node builds with the cost of DEWDParentTable against the strongest and a random mesh AP
+     */
+static void sim_join(int runs) {
+	printf("%d nodes in %.0f x %.0f m, root in the middle, %.0f dB shadowing, %d runs\n", JOIN_SIM_NODES, JOIN_SIM_AREA, JOIN_SIM_AREA, JOIN_SIM_SHADOW, runs);
+	const char* names[] = {"DEWDParentTable cost", "strongest mesh AP", "random mesh AP"};
+	for (JoinPolicy policy : {JOIN_COST, JOIN_STRONGEST, JOIN_RANDOM}) {
+		std::vector<double> depth, max_depth;
+		int detached = 0;
+		for (int seed = 1; seed <= runs; seed++) {
+			std::vector<int> level, root;
+			detached += join_run(policy, 1, seed, level, root);
+			int max_level = 0;
+			for (int i = 1; i < JOIN_SIM_NODES; i++)
+				if (level[i] >= 0) {
+					depth.push_back(level[i]);
+					max_level = std::max(max_level, level[i]);
+				}
+			max_depth.push_back(max_level);
+		}
+		double mean = 0;
+		for (double d : depth)
+			mean += d;
+		double max_mean = 0;
+		for (double d : max_depth)
+			max_mean += d;
+		printf(" %-22s depth mean %4.2f, p90 %2.0f, max per run mean %4.1f, worst %2.0f, %.1f %% of the nodes detached\n", names[policy], 
+			mean / std::max<size_t>(1, depth.size()), percentile(depth, 90), max_mean / runs, percentile(max_depth, 100), 
+			100.0 * detached / runs / (JOIN_SIM_NODES - 1));
+	}
+}
+
+/* Throughput of the mesh with one to three gateway roots. Every node sends the same rate of reports 
+	to its root, a report takes one transmission per hop. The roots are on different channels, see 
+	DEWDChannelPlan, and each has its own host link, so every tree has the airtime of one channel: the 
+	tree with the most transmissions per round of reports limits the rate of every node.
+     */
+static void sim_gateways(int runs) {
+	printf("%d nodes in %.0f x %.0f m, %.0f dB shadowing, every node reports at the same rate, %d runs\n", 
+		JOIN_SIM_NODES, JOIN_SIM_AREA, JOIN_SIM_AREA, JOIN_SIM_SHADOW, runs);
+	printf(" throughput relative to one root with the DEWDParentTable cost\n");
+	const char* names[] = {"DEWDParentTable cost", "strongest mesh AP", "random mesh AP", "cost, no root load"};
+	double base = 0;
+	for (int roots = 1; roots <= 3; roots++)
+		for (JoinPolicy policy : {JOIN_COST, JOIN_NO_LOAD, JOIN_STRONGEST}) {
+			if (roots == 1 && policy == JOIN_NO_LOAD)
+				continue;
+			double rate = 0, biggest = 0, depth = 0;
+			for (int seed = 1; seed <= runs; seed++) {
+				std::vector<int> level, root;
+				join_run(policy, roots, seed, level, root);
+				std::vector<int> hops(roots, 0), size(roots, 0);
+				for (int i = roots; i < JOIN_SIM_NODES; i++)
+					if (root[i] >= 0) {
+						hops[root[i]] += level[i];
+						size[root[i]]++;
+						depth += level[i];
+					}
+				rate += 1.0 / std::max(1, *std::max_element(hops.begin(), hops.end()));
+				biggest += *std::max_element(size.begin(), size.end());
+			}
+			if (base == 0)
+				base = rate;
+			printf(" %d root%s %-22s %4.2f x, largest tree %4.1f nodes, depth mean %4.2f\n", roots, roots > 1 ? "s" : " ", names[policy], 
+				rate / base, biggest / runs, depth / runs / (JOIN_SIM_NODES - roots));
+		}
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//		DEWDRoute
+/////////////////////////////////////////////////////////////////////////////////
+
+	const int UNICASTS = 100;										// unicasts per run, between random pairs of nodes
+	const unsigned long UNICAST_FREQ = 1000;						// ms between two unicasts
+
+static MACAddress route_mac(int i) {
+	return MACAddress(0x5c, 0xcf, 0x7f, 1, i >> 8, i & 0xFF);
+}
+
+static IPAddress route_ip(int i) {
+	return IPAddress(10, 0, i >> 8, i & 0xFF);
+}
+
+/* A route request or reply on its way over one link
+     */
+struct RouteSimMsg {
+	char flag;
+	int from, to;
+	int orig, dest;													// as in the payload: a request searches dest for orig, a reply answers it
+	uint16_t seq;
+	int hops;
+	uint16_t cost;
+	uint8_t id;
+};
+
+/* The neighbour node i hands a packet for dest to, as forward_by_mac() in DEWDComm.h picks it
+     *
+	 * return: index of the next hop, -1 if there is no route
+     */
+static int route_next_hop(std::vector<DEWDRouteTable>& nodes, const std::vector<int>& parent, int i, int dest) {
+	if (parent[i] == dest || parent[dest] == i)						// the host or a client
+		return dest;
+	DEWDRoute* route = nodes[i].find(route_mac(dest));
+	return route == NULL ? -1 : route->next_hop[2] << 8 | route->next_hop[3];
+}
+
+/* Run one route discovery of orig for dest as discover_route(), parse_route_request() and 
+	parse_route_reply() in DEWDComm.h do it, every link with an ETX of 100
+     *
+	 * param sent: messages sent, per flag
+     */
+static void route_discover(std::vector<DEWDRouteTable>& nodes, const std::vector<int>& parent, int orig, int dest, std::mt19937& rng, std::map<char, int>& sent) {
+	std::deque<RouteSimMsg> wire;
+	uint8_t id = 100 + rng() % 156;
+	nodes[orig].own_seq++;
+	nodes[orig].seen_request(route_mac(orig), id);
+	for (int n : mesh_links(parent, orig))
+		wire.push_back({'Q', orig, n, orig, dest, nodes[orig].own_seq, 0, 0, id});
+	
+	while (!wire.empty()) {
+		RouteSimMsg m = wire.front();
+		wire.pop_front();
+		sent[m.flag]++;
+		DEWDRouteTable& node = nodes[m.to];
+		int hops = m.hops + 1;
+		uint16_t cost = m.cost + 100;
+		
+		if (m.flag == 'P') {
+			node.update(route_mac(m.dest), route_ip(m.from), hops, m.seq, cost);
+			int next = m.to == m.orig ? -1 : route_next_hop(nodes, parent, m.to, m.orig);
+			if (next >= 0)
+				wire.push_back({'P', m.to, next, m.orig, m.dest, m.seq, hops, cost, m.id});
+			continue;
+		}
+		if (m.to == m.orig || node.seen_request(route_mac(m.orig), m.id))
+			continue;
+		node.update(route_mac(m.orig), route_ip(m.from), hops, m.seq, cost);
+		DEWDRoute* route;
+		if (m.to == m.dest) {
+			node.own_seq++;
+			wire.push_back({'P', m.to, m.from, m.orig, m.dest, node.own_seq, 0, 0, m.id});
+		}
+		else if (parent[m.dest] == m.to)							// a client answers for itself
+			wire.push_back({'P', m.to, m.from, m.orig, m.dest, 0, 1, 100, m.id});
+		else if ((route = node.find(route_mac(m.dest))) != NULL)
+			wire.push_back({'P', m.to, m.from, m.orig, m.dest, route->seq, route->hops, route->cost, m.id});
+		else {
+			for (int n : mesh_links(parent, m.to))
+				if (n != m.from)
+					wire.push_back({'Q', m.to, n, m.orig, m.dest, m.seq, hops, cost, m.id});
+		}
+	}
+}
+
+/* Send a unicast hop by hop as parse_unicast() does, after route discovery where the origin has no route
+     *
+	 * return: true if it was delivered
+     */
+static bool route_unicast(std::vector<DEWDRouteTable>& nodes, const std::vector<int>& parent, int orig, int dest, std::mt19937& rng, std::map<char, int>& sent) {
+	for (int tries = 0; route_next_hop(nodes, parent, orig, dest) < 0; tries++) {
+		if (tries > RREQ_RETRIES)
+			return false;
+		route_discover(nodes, parent, orig, dest, rng, sent);
+	}
+	int at = orig;
+	for (int ttl = ROUTE_TTL; at != dest; ttl--) {
+		int next = route_next_hop(nodes, parent, at, dest);
+		if (next < 0 || ttl <= 0)
+			return false;
+		sent['D']++;
+		at = next;
+	}
+	return true;
+}
+
+/* Messages per delivered unicast with on-demand routes against a flood of every unicast over the tree.
+	UNICASTS unicasts between random pairs, one every UNICAST_FREQ ms, every node with its own 
+	DEWDRouteTable. Requests are answered by the destination, its host and cached routes.
+     */
+static void sim_unicast(int runs) {
+	printf("random trees, %d unicasts between random pairs, one every %lu ms, %d runs\n", UNICASTS, UNICAST_FREQ, runs);
+	for (int n : {20, 50}) {
+		std::map<char, int> sent;
+		int delivered = 0, path = 0, cold = 0;
+		for (int run = 1; run <= runs; run++) {
+			std::mt19937 rng(run);
+			std::vector<int> parent;
+			mesh_tree(rng, n, parent);
+			std::vector<DEWDRouteTable> nodes(n);
+			host_us = 0;
+			for (int u = 0; u < UNICASTS; u++) {
+				int orig = rng() % n, dest = rng() % (n - 1);
+				dest += dest >= orig;
+				cold += route_next_hop(nodes, parent, orig, dest) < 0;
+				if (route_unicast(nodes, parent, orig, dest, rng, sent)) {
+					delivered++;
+					path += mesh_hops(parent, orig, dest);
+				}
+				host_us += UNICAST_FREQ * 1000ULL;
+			}
+		}
+		double per = std::max(1, delivered);
+		printf(" %d nodes: %.1f %% delivered, %.1f %% needed a route request, path %.1f hops\n", 
+			n, 100.0 * delivered / runs / UNICASTS, 100.0 * cold / runs / UNICASTS, path / per);
+		printf("  routed   %5.1f messages per unicast (Q %.1f, P %.1f, D %.1f)\n", 
+			(sent['Q'] + sent['P'] + sent['D']) / per, sent['Q'] / per, sent['P'] / per, sent['D'] / per);
+		printf("  flooded  %5d messages per unicast, one per tree link\n", n - 1);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//		DEWDRtc
+/////////////////////////////////////////////////////////////////////////////////
+
+static void test_rtc_seen() {
+	uint8_t a[6] = {0x5c, 0xcf, 0x7f, 0x01, 0x02, 0x03};
+	uint8_t b[6] = {0x5c, 0xcf, 0x7f, 0x01, 0x02, 0x04};
+	host_us = 0;
+	DEWDRtc r;
+	for (int id = 100; id < 100 + RTC_SEEN_IDS; id++)
+		r.note_broadcast(id, MACAddress(a));
+	r.save();
+	DEWDRtc woken;													// after a deep sleep
+	CHECK(woken.load());
+	CHECK(woken.seen_before_wake(100, MACAddress(a)));
+	CHECK(woken.seen_before_wake(100 + RTC_SEEN_IDS - 1, MACAddress(a)));
+	CHECK(!woken.seen_before_wake(100, MACAddress(b)));			// same id from another originator is a new broadcast
+	CHECK(!woken.seen_before_wake(100 + RTC_SEEN_IDS, MACAddress(a)));
+	host_us = (SEEN_ID_GRACE + 1) * 1000ULL;
+	CHECK(!woken.seen_before_wake(100, MACAddress(a)));
+	host_us = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//		DEWDSleepSchedule
+/////////////////////////////////////////////////////////////////////////////////
+
+static void test_sleep_schedule() {
+	const unsigned long period = 60000, awake = 10000;
+	const unsigned long anchors[] = {12345, 0xFFFFF000UL};			// the second one crosses the millis() wrap
+	for (unsigned long anchor : anchors) {
+		DEWDSleepSchedule s;
+		s.set(period, awake, anchor);
+		for (unsigned long d = 0; d < 20 * period; d += 250) {
+			unsigned long now = anchor + d;
+			unsigned long phase = d % period;
+			CHECK(s.in_window(now) == (phase < awake));
+			CHECK(s.until_window(now) == (phase < awake ? 0 : period - phase));
+			if (phase < awake) {									// in the window only answered edge nodes sleep
+				CHECK(s.sleep_time(now, true, false, true) == 0);
+				CHECK(s.sleep_time(now, false, true, true) == 0);
+				CHECK(s.sleep_time(now, false, false, false) == 0);
+			}
+			else if (phase < awake + SLEEP_RELAY_HOLD)				// a busy relay holds on
+				CHECK(s.sleep_time(now, true, true, true) == 0);
+			unsigned long t = s.sleep_time(now, false, false, true);
+			if (t != 0) {											// wakes SLEEP_WAKE_LEAD before the next window
+				CHECK(t >= SLEEP_MIN);
+				CHECK(now + t + SLEEP_WAKE_LEAD == anchor + (d / period + 1) * period);
+			}
+			else if (phase >= awake)
+				CHECK(period - phase < SLEEP_WAKE_LEAD + SLEEP_MIN);
+		}
+	}
+	DEWDSleepSchedule s;
+	s.set(period, period, 0);										// always awake
+	CHECK(!s.active());
+	CHECK(s.sleep_time(5000, false, false, true) == 0);
+}
+
+/* An edge node sleeps through 500 cycles. Its deep-sleep timer runs drift off, every boot estimates 
+	the window from the wake-up time as restore_duty_cycle() does, and after the rejoin the mesh clock 
+	sync (off by up to 20 ms) resyncs the schedule if resync is set.
+     *
+	 * return: nr of cycles in which the node woke after its wake window had opened
+     */
+static int sleep_cycles(double drift, bool resync) {
+	const unsigned long period = 60000, awake = 10000;
+	const unsigned long mesh_anchor = 1000000;						// root's millis() when DUTY_CYCLE was sent
+	const unsigned long rejoin = 2000, answer = 3000;				// local ms after boot
+	std::mt19937 rng(7);
+	unsigned long long boot = mesh_anchor + period - SLEEP_WAKE_LEAD;	// true time of the first boot
+	int late = 0;
+	for (int cycle = 0; cycle < 500; cycle++) {
+		unsigned long long window = mesh_anchor + ((boot - mesh_anchor) / period + 1) * period;
+		if (window - boot > period / 2)								// woke late, this window opened already
+			window -= period;
+		if (boot > window)
+			late++;
+		DEWDSleepSchedule s;
+		s.set(period, awake, SLEEP_WAKE_LEAD - period);				// millis() is 0 at boot
+		s.set_mesh_anchor(mesh_anchor);
+		if (resync)
+			s.resync(boot + rejoin + rng() % 41 - 20, rejoin);
+		unsigned long now = answer + s.until_window(answer);		// answers once the window is open
+		unsigned long t = s.sleep_time(now, false, false, true);
+		while (t == 0)
+			t = s.sleep_time(++now, false, false, true);
+		boot += now + (unsigned long long)llround(t * (1 + drift));
+	}
+	return late;
+}
+
+static void test_sleep_drift() {
+	const double drifts[] = {-0.02, -0.005, 0.005, 0.02};
+	for (double drift : drifts) {
+		CHECK(sleep_cycles(drift, true) == 0);
+		CHECK(sleep_cycles(drift, false) > 100);					// without it the wake-up walks around the period
+	}
+	DEWDSleepSchedule s;											// the anchor may lie ahead of the mesh time
+	s.set(60000, 10000, 0);
+	s.set_mesh_anchor(500000);
+	s.resync(500000 - 61000, 7000);
+	CHECK(s.anchor_ms == 7000UL - 59000UL);
+	CHECK(s.last_resync_ms == 8000);
+	CHECK(s.in_window(s.anchor_ms + 60000 + 9999) && !s.in_window(s.anchor_ms + 60000 + 10000));
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//		DEWDStationTable
+/////////////////////////////////////////////////////////////////////////////////
+
+static void test_stations() {
+	host_us = 0;
+	host_wifi = HostWiFi();
+	DEWDStationTable table;
+	table.begin();
+	table.begin();													// setup_mesh() runs again after a renumbering
+	CHECK(host_wifi.handlers == 2);
+	
+	WiFiEventSoftAPModeStationConnected e = {{0x5c, 0xcf, 0x7f, 0, 0, 2}, 1};
+	host_wifi.station_connected(e);
+	CHECK(table.count() == 1 && table.get(0)->ip[0] == 0);
+	station_info info = {};
+	memcpy(info.bssid, e.mac, 6);
+	info.ip.addr = IPAddress(192, 168, 20, 2);
+	host_wifi.stations.push_back(info);								// DHCP has leased an address
+	host_us = (STATION_LEASE_POLL - 1) * 1000ULL;
+	table.update();
+	CHECK(table.get(0)->ip[0] == 0);								// not polled yet
+	host_us = STATION_LEASE_POLL * 1000ULL;
+	table.update();
+	CHECK(table.get(0)->ip == IPAddress(192, 168, 20, 2));
+	CHECK(table.find(MACAddress(e.mac)) == table.get(0));
+	
+	WiFiEventSoftAPModeStationDisconnected d = {{0x5c, 0xcf, 0x7f, 0, 0, 2}, 1};
+	host_wifi.station_disconnected(d);
+	CHECK(table.count() == 0);
+	host_wifi = HostWiFi();
+	host_us = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//		DEWDSubnetPlan
+/////////////////////////////////////////////////////////////////////////////////
+
+static void test_subnet() {
+	std::mt19937 rng(3);
+	for (int i = 0; i < 10000; i++) {
+		uint32_t id = rng() & 0xFFFFFF;
+		for (uint8_t a = 0; a < 4; a++) {
+			uint8_t s = DEWDSubnetPlan::derive(id, a);
+			CHECK(s >= SUBNET_MIN && s <= SUBNET_MAX && s != SUBNET_RESERVED);
+			CHECK(s == DEWDSubnetPlan::derive(id, a));				// the same after every reset
+		}
+	}
+	DEWDSubnetPlan plan;
+	uint8_t used[3] = {DEWDSubnetPlan::derive(42, 0), DEWDSubnetPlan::derive(42, 1), 7};
+	CHECK(plan.choose(42, used, 3, 0) == DEWDSubnetPlan::derive(42, 2) && plan.attempt == 2);
+	CHECK(plan.choose(42, used, 0, 0) == DEWDSubnetPlan::derive(42, 0) && plan.attempt == 0);
+}
+
+	const int SUBNET_SIM_NODES = 300;
+	const double SUBNET_SIM_NEIGHBOURS = 5;							// mesh APs in range of a node, on average
+
+struct SubnetSimNode {
+	double x, y;
+	uint32_t id;													// chip ID, the softAP MAC follows it
+	int parent;
+	bool joined;													// false if out of range of the tree
+	DEWDSubnetPlan plan;
+	std::vector<int> near;
+};
+
+/* Subnets of the parent and the nearest neighbours that are up, as used_subnets() collects them
+     *
+     */
+static int subnet_sim_used(std::vector<SubnetSimNode>& nodes, int n, uint8_t* used) {
+	int count = 0;
+	if (nodes[n].parent >= 0)
+		used[count++] = nodes[nodes[n].parent].plan.subnet;
+	for (int m : nodes[n].near)
+		if (nodes[m].joined && m != nodes[n].parent && count < MAX_PARENTS + 1)
+			used[count++] = nodes[m].plan.subnet;
+	return count;
+}
+
+/* return: a random subnet between SUBNET_MIN and SUBNET_MAX, not SUBNET_RESERVED and not in used
+     */
+static uint8_t subnet_sim_random(std::mt19937& rng, const uint8_t* used, int n) {
+	for (;;) {
+		uint8_t s = SUBNET_MIN + rng() % (SUBNET_MAX - SUBNET_MIN + 1);
+		if (s != SUBNET_RESERVED && std::find(used, used + n, s) == used + n)
+			return s;
+	}
+}
+
+/* Grow the tree from the root, every node picks its subnet when it joins: derived and checked 
+	against its neighbours as setup_mesh() does, or at random.
+     *
+	 * return: nodes whose subnet is used by their parent or a neighbour in range
+     */
+static int subnet_sim_join(std::vector<SubnetSimNode>& nodes, bool derived, std::mt19937& rng) {
+	int n_nodes = nodes.size();
+	std::vector<int> frontier;
+	for (SubnetSimNode& node : nodes) {
+		node.joined = false;
+		node.parent = -1;
+	}
+	nodes[0].joined = true;
+	nodes[0].plan.choose(nodes[0].id, 0, 0, 0);
+	if (!derived)
+		nodes[0].plan.subnet = subnet_sim_random(rng, 0, 0);
+	for (int m : nodes[0].near)
+		frontier.push_back(m);
+	while (!frontier.empty()) {										// the next node to join is in range of one that is up
+		int k = rng() % frontier.size();
+		int n = frontier[k];
+		frontier[k] = frontier.back();
+		frontier.pop_back();
+		if (nodes[n].joined)
+			continue;
+		int parent = -1;
+		for (int m : nodes[n].near)
+			if (nodes[m].joined && (parent < 0 || hypot(nodes[m].x - nodes[n].x, nodes[m].y - nodes[n].y) < hypot(nodes[parent].x - nodes[n].x, nodes[parent].y - nodes[n].y)))
+				parent = m;
+		nodes[n].parent = parent;
+		uint8_t used[MAX_PARENTS + 1];
+		int count = subnet_sim_used(nodes, n, used);
+		if (derived)
+			nodes[n].plan.choose(nodes[n].id, used, count, 0);
+		else
+			nodes[n].plan.subnet = subnet_sim_random(rng, 0, 0);
+		nodes[n].joined = true;
+		for (int m : nodes[n].near)
+			if (!nodes[m].joined)
+				frontier.push_back(m);
+	}
+	int conflicts = 0;
+	for (int n = 0; n < n_nodes; n++) {
+		bool conflict = false;
+		for (int m : nodes[n].near)
+			conflict |= nodes[m].joined && nodes[m].plan.subnet == nodes[n].plan.subnet;
+		conflicts += nodes[n].joined && conflict;
+	}
+	return conflicts;
+}
+
+/* Run the conflict checks of subnet_maintenance() until no node moves: a node always moves away 
+	from its parent's subnet, of two neighbours the one with the higher MAC moves.
+     *
+	 * return: nr of renumberings
+     */
+static int subnet_sim_settle(std::vector<SubnetSimNode>& nodes, bool derived, std::mt19937& rng) {
+	int n_nodes = nodes.size();
+	int renumbered = 0;
+	for (int round = 0; round < 100; round++) {
+		std::vector<int> moving;
+		for (int n = 1; n < n_nodes; n++) {
+			if (!nodes[n].joined)
+				continue;
+			bool conflict = nodes[nodes[n].parent].plan.subnet == nodes[n].plan.subnet;
+			for (int m : nodes[n].near)
+				conflict |= nodes[m].joined && nodes[m].plan.subnet == nodes[n].plan.subnet && nodes[n].id > nodes[m].id;
+			if (conflict)
+				moving.push_back(n);
+		}
+		if (moving.empty())
+			break;
+		for (int n : moving) {										// all checks of a round see the same state
+			uint8_t used[MAX_PARENTS + 1];
+			int count = subnet_sim_used(nodes, n, used);
+			if (derived)
+				nodes[n].plan.choose(nodes[n].id, used, count, nodes[n].plan.attempt + 1);
+			else
+				nodes[n].plan.subnet = subnet_sim_random(rng, used, count);
+			renumbered++;
+		}
+	}
+	return renumbered;
+}
+
+/* A few hundred nodes are placed at random with SUBNET_SIM_NEIGHBOURS mesh APs in range on average, 
+	and join the mesh from the root outwards. For a random and the derived subnet choice prints the 
+	nodes in conflict after the join, the renumberings needed to clear them, and how many nodes 
+	have another subnet after the whole mesh restarted (children and routes must then relearn it).
+     */
+static void sim_subnet(int runs) {
+	printf("%d nodes, %.0f mesh APs in range on average, %d runs, mean per run\n", SUBNET_SIM_NODES, SUBNET_SIM_NEIGHBOURS, runs);
+	for (int derived = 0; derived < 2; derived++) {
+		double joined = 0, conflicts = 0, renumbered = 0, changed = 0;
+		for (int run = 1; run <= runs; run++) {
+			std::mt19937 rng(run);
+			std::uniform_real_distribution<double> uni(0, 1);
+			std::vector<SubnetSimNode> nodes(SUBNET_SIM_NODES);
+			double range = sqrt(SUBNET_SIM_NEIGHBOURS / (M_PI * SUBNET_SIM_NODES));
+			for (SubnetSimNode& node : nodes) {
+				node.x = uni(rng);
+				node.y = uni(rng);
+				node.id = rng() & 0xFFFFFF;
+			}
+			nodes[0].x = nodes[0].y = 0.5;
+			for (int n = 0; n < SUBNET_SIM_NODES; n++)
+				for (int m = 0; m < SUBNET_SIM_NODES; m++)
+					if (m != n && hypot(nodes[m].x - nodes[n].x, nodes[m].y - nodes[n].y) < range)
+						nodes[n].near.push_back(m);
+			conflicts += subnet_sim_join(nodes, derived, rng);
+			renumbered += subnet_sim_settle(nodes, derived, rng);
+			std::vector<uint8_t> before;
+			for (SubnetSimNode& node : nodes)
+				before.push_back(node.plan.subnet);
+			subnet_sim_join(nodes, derived, rng);					// the whole mesh restarts
+			subnet_sim_settle(nodes, derived, rng);
+			for (int n = 0; n < SUBNET_SIM_NODES; n++) {
+				joined += nodes[n].joined;
+				changed += nodes[n].joined && nodes[n].plan.subnet != before[n];
+			}
+		}
+		printf(" %-8s joined %5.1f, in conflict after joining %4.1f, renumberings %4.1f, changed by a restart %5.1f\n", 
+			derived ? "derived" : "random", joined / runs, conflicts / runs, renumbered / runs, changed / runs);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//		DEWDTcpClass
+/////////////////////////////////////////////////////////////////////////////////
+
+static std::shared_ptr<HostConn> tcp_conn(const char* data, int ip, bool open) {
+	std::shared_ptr<HostConn> c = std::make_shared<HostConn>();
+	c->data = data;
+	c->ip = IPAddress(10, 0, 0, ip);
+	c->open = open;
+	host_backlog.push_back(c);
+	return c;
+}
+
+/* The lines one main-loop iteration takes, as handle_ports() does
+     */
+static int tcp_iteration(DEWDTcpClass& tcp, std::vector<String>& lines) {
+	int n = 0;
+	for (; n < TCP_BURST; n++) {
+		String line = tcp.listen();
+		if (line.length() == 0)
+			break;
+		lines.push_back(line);
+	}
+	host_us += 500000;											// the sketch's main-loop delay
+	return n;
+}
+
+static void test_tcp_burst() {
+	host_us = 1000000;
+	host_backlog.clear();
+	DEWDTcpClass tcp(4040);
+	std::vector<String> lines;
+	
+	// 12 children answer at once, one sender is slow, one closes without '\r', one never sends
+	for (int i = 0; i < 12; i++) {
+		char line[64];
+		snprintf(line, sizeof(line), "R %d 5c:cf:7f:0:0:%d %d;\r\n", 100 + i, i, i);
+		tcp_conn(line, i + 2, true);
+	}
+	std::shared_ptr<HostConn> slow = tcp_conn("R 200 partial", 50, true);
+	tcp_conn("M 201 10.0.0.51 closed-no-cr", 51, false);
+	tcp_conn("", 52, true);
+	
+	CHECK(tcp_iteration(tcp, lines) == 13);						// all but the slow and the silent one
+	CHECK(lines[0] == "R 100 5c:cf:7f:0:0:0 0;" && lines[12] == "M 201 10.0.0.51 closed-no-cr");
+	CHECK(tcp.max_clients == TCP_MAX_CLIENTS);						// taken in passes of TCP_MAX_CLIENTS connections
+	slow->data += "-rest;\r\n";
+	CHECK(tcp_iteration(tcp, lines) == 1 && lines[13] == "R 200 partial-rest;");
+	CHECK(tcp.get_remote_ip() == IPAddress(10, 0, 0, 50));
+	tcp_iteration(tcp, lines);
+	CHECK(tcp_iteration(tcp, lines) == 0);
+	CHECK(tcp.accepted == 15 && tcp.lines == 14 && tcp.timeouts == 1);	// the silent one is dropped after TCP_READ_TIMEOUT
+	host_backlog.clear();
+	host_us = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//		DEWDTopology
+/////////////////////////////////////////////////////////////////////////////////
+
+static String topo_mac(const uint8_t* mac) {
+	String res;
+	for (int i = 0; i < 6; i++) {
+		if (i > 0)
+			res += ':';
+		res += String(mac[i], HEX);
+	}
+	return res;
+}
+
+/* Build a random tree, every node hangs below one of the nodes before it, and the MAP_TOPOLOGY 
+	response and the MAP_NETWORK text the nodes would send, both in pre-order
+     *
+	 * param parent: index of each node's parent, -1 for the root
+     */
+static void topo_tree(std::mt19937& rng, int n, std::vector<DEWDTopologyRecord>& records, std::vector<int>& parent, String& response, String& text) {
+	records.assign(n, DEWDTopologyRecord());
+	parent.assign(n, -1);
+	for (int i = 0; i < n; i++) {
+		DEWDTopologyRecord& r = records[i];
+		memset(&r, 0, sizeof(r));
+		uint8_t mac[6] = {0x5c, 0xcf, 0x7f, (uint8_t)rng(), (uint8_t)rng(), (uint8_t)(i + 1)};
+		memcpy(r.mac, mac, 6);
+		r.rssi = -40 - rng() % 50;
+		r.depth = 1;
+		if (i == 0)
+			continue;
+		do
+			parent[i] = rng() % i;
+		while (records[parent[i]].child_count == TOPO_MAX_CHILDREN);
+		DEWDTopologyRecord& p = records[parent[i]];
+		memcpy(r.parent, p.mac + 6 - TOPO_SUFFIX, TOPO_SUFFIX);
+		r.depth = p.depth + 1;
+		memcpy(p.children[p.child_count++], r.mac + 6 - TOPO_SUFFIX, TOPO_SUFFIX);
+	}
+	
+	response = text = "";
+	std::function<void(int)> walk = [&](int i) {
+		response += "%";
+		response += DEWDTopology::encode(records[i]);
+		response += ";";
+		text += topo_mac(records[i].mac);
+		text += " | H: ";
+		text += i > 0 ? topo_mac(records[parent[i]].mac) : String("ab:ab:ab:ab:ab:ab");
+		text += "| D: ";
+		text += records[i].depth;
+		text += "| C: ";
+		if (records[i].child_count == 0)
+			text += "none|";
+		for (int j = 0; j < n; j++)
+			if (parent[j] == i) {
+				text += topo_mac(records[j].mac);
+				text += '|';
+			}
+		text += ";";
+		for (int j = 0; j < n; j++)
+			if (parent[j] == i)
+				walk(j);
+	};
+	walk(0);
+}
+
+static void test_topology() {
+	std::mt19937 rng(1);
+	std::vector<DEWDTopologyRecord> records;
+	std::vector<int> parent;
+	String response, text;
+	topo_tree(rng, 50, records, parent, response, text);
+	
+	DEWDTopology view;
+	CHECK(view.load(response) == 50);
+	int bytes = 0;
+	for (DEWDTopologyRecord& r : records)
+		bytes += TOPO_HEADER + r.child_count * TOPO_SUFFIX;
+	CHECK(view.bytes == bytes);
+	int parents_ok = 0;
+	for (int i = 0; i < view.count; i++) {
+		int orig = -1;
+		for (int k = 0; k < 50; k++)
+			if (!memcmp(records[k].mac, view.records[i].mac, 6))
+				orig = k;
+		int p = view.parent_index(i);
+		if (orig >= 0 && (parent[orig] < 0 ? p < 0 : p >= 0 && !memcmp(view.records[p].mac, records[parent[orig]].mac, 6)))
+			parents_ok++;
+	}
+	CHECK(parents_ok == 50);
+	CHECK(view.load("%not base64;%;") == 0);
+}
+
+	const double TOPO_RATE = 100;									// bytes per ms a TCP line is sent with, about 0.8 Mbit/s
+
+/* Split a response into its entries and give each node the chars of its own, both are in pre-order
+     *
+	 * return: chars of each node's entry, incl. the ';'
+     */
+static std::vector<int> topo_entry_chars(const std::vector<int>& parent, const String& response) {
+	std::vector<int> order, res(parent.size(), 0);
+	std::function<void(int)> walk = [&](int i) {
+		order.push_back(i);
+		for (size_t j = 0; j < parent.size(); j++)
+			if (parent[j] == i)
+				walk(j);
+	};
+	walk(0);
+	int start = 0;
+	for (int i : order) {
+		int end = response.indexOf(';', start);
+		res[i] = end + 1 - start;
+		start = end + 1;
+	}
+	return res;
+}
+
+/* Time a sweep of the tree takes: the broadcast goes down, every node answers with its own entry and 
+	those of its subtree once all children have answered. A line takes 3 ms plus an exponential 10 ms 
+	plus its length at TOPO_RATE, and is handled on the receivers next main-loop iteration, see sim_query().
+     *
+	 * param chars: chars of each node's own entry
+	 * param wire: chars sent over all hops, added to
+	 * return: ms until the root has the whole answer
+     */
+static double topo_sweep(const std::vector<int>& parent, const std::vector<int>& chars, unsigned long seed, double& wire) {
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<double> uni(0, 1);
+	std::exponential_distribution<double> net(1 / 10.0);
+	std::vector<double> phase(parent.size());
+	for (double& p : phase)
+		p = uni(rng) * QUERY_LOOP;
+	auto handled = [&](int i, double arrive) { return phase[i] + ceil((arrive - phase[i]) / QUERY_LOOP) * QUERY_LOOP; };
+	
+	std::function<double(int, double, int&)> answer = [&](int i, double arrive, int& sub) {
+		double t = handled(i, arrive), ready = t + QUERY_EXEC;
+		sub = chars[i];
+		for (size_t c = 0; c < parent.size(); c++) {
+			if (parent[c] != i)
+				continue;
+			int sub_c;
+			double back = answer(c, t + QUERY_EXEC + 3 + net(rng), sub_c);
+			ready = std::max(ready, handled(i, back));
+			sub += sub_c;
+		}
+		if (i > 0)
+			wire += sub;
+		return ready + 3 + net(rng) + sub / TOPO_RATE;
+	};
+	int all;
+	return answer(0, 0, all) - 3;									// the root prints it, nothing is sent
+}
+
+/* Size of a MAP_TOPOLOGY answer against the MAP_NETWORK text of the same tree, the time a sweep of 
+	the tree takes with either, and the time the originator takes to decode it on this PC
+     */
+static void sim_topology(int runs) {
+	const int nodes = 50;
+	double bytes = 0, chars = 0, text_chars = 0, load_us = 0, wire = 0, text_wire = 0;
+	std::vector<double> sweep, text_sweep;
+	for (int run = 1; run <= runs; run++) {
+		std::mt19937 rng(run);
+		std::vector<DEWDTopologyRecord> records;
+		std::vector<int> parent;
+		String response, text;
+		topo_tree(rng, nodes, records, parent, response, text);
+		DEWDTopology view;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		view.load(response);
+		load_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		bytes += view.bytes;
+		chars += response.length();
+		text_chars += text.length();
+		sweep.push_back(topo_sweep(parent, topo_entry_chars(parent, response), run, wire));		// same latencies for both
+		text_sweep.push_back(topo_sweep(parent, topo_entry_chars(parent, text), run, text_wire));
+	}
+	printf("random trees of %d nodes, %d runs, per node\n", nodes, runs);
+	printf(" MAP_TOPOLOGY %4.1f record bytes, %4.1f chars on the wire\n", bytes / runs / nodes, chars / runs / nodes);
+	printf(" MAP_NETWORK  %4.1f chars on the wire\n", text_chars / runs / nodes);
+	printf(" decoding all %d records takes %.0f us on this PC\n", nodes, load_us / runs);
+	printf("per sweep, %.0f ms main loop, lines at %.0f bytes/ms\n", QUERY_LOOP, TOPO_RATE);
+	printf(" MAP_TOPOLOGY %6.0f chars over all hops, done after median %5.0f ms, p90 %5.0f ms\n", wire / runs, median(sweep), percentile(sweep, 90));
+	printf(" MAP_NETWORK  %6.0f chars over all hops, done after median %5.0f ms, p90 %5.0f ms\n", text_wire / runs, median(text_sweep), percentile(text_sweep, 90));
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//		DEWDTopoSync
+/////////////////////////////////////////////////////////////////////////////////
+
+static String topo_message(DEWDTopoSync& node, char kind, String args) {
+	String res = "5c:cf:7f:1:2:3 ";
+	res += node.seq;
+	res += " ";
+	res += kind;
+	res += " ";
+	res += args;
+	return res;
+}
+
+static void test_topo_sync() {
+	DEWDTopoSync node, root;
+	DEWDTopologyRecord r;
+	memset(&r, 0, sizeof(r));
+	uint8_t mac[6] = {0x5c, 0xcf, 0x7f, 1, 2, 3};
+	memcpy(r.mac, mac, 6);
+	r.parent[0] = 9;
+	r.depth = 1;
+	
+	String delta;
+	CHECK(node.compare(r, delta) == TOPO_FULL && node.seq == 1);
+	CHECK(root.apply(topo_message(node, 'F', DEWDTopology::encode(r)), 0));
+	CHECK(root.view.count == 1 && root.view.records[0].depth == 1);
+	delta = "";
+	CHECK(node.compare(r, delta) == TOPO_SAME && node.seq == 1);
+	
+	r.child_count = 2;
+	r.children[0][0] = 4;
+	r.children[1][0] = 7;
+	delta = "";
+	CHECK(node.compare(r, delta) == TOPO_DELTA && delta == "+4:0:0 +7:0:0");
+	CHECK(root.apply(topo_message(node, 'D', delta), 1));
+	CHECK(root.view.records[0].child_count == 2);
+	
+	r.child_count = 1;													// child 4 leaves, the report is lost
+	memcpy(r.children[0], r.children[1], TOPO_SUFFIX);
+	delta = "";
+	CHECK(node.compare(r, delta) == TOPO_DELTA && delta == "-4:0:0");
+	CHECK(!root.apply(topo_message(node, 'S', ""), 2));				// the digest shows the gap
+	CHECK(root.gaps == 1);
+	
+	node.pull();
+	delta = "";
+	CHECK(node.compare(r, delta) == TOPO_FULL);
+	CHECK(root.apply(topo_message(node, 'F', DEWDTopology::encode(r)), 3));
+	CHECK(root.apply(topo_message(node, 'S', ""), 4));
+	CHECK(root.view.records[0].child_count == 1 && root.view.records[0].children[0][0] == 7);
+	
+	root.expire(4 + TOPO_EXPIRE);
+	CHECK(root.view.count == 1);
+	root.expire(4 + TOPO_EXPIRE + 1);
+	CHECK(root.view.count == 0);
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//		DEWDTree
+/////////////////////////////////////////////////////////////////////////////////
+
+static void test_tree_depth() {
+	// a linear mesh of 40 nodes below root 1 stays one tree
+	DEWDTree tree;
+	for (int d = 0; d < 40; d++) {
+		tree.reset(mesh_mac(100), true);
+		tree.on_parent_hello(mesh_mac(100), mesh_mac(2), TREE_PRIO_ROOT, mesh_mac(1), d);
+		CHECK(tree.parent_in_tree && tree.depth == d + 1);
+	}
+	CHECK(tree.depth_limit_hits == 0);
+	
+	// a label with this node as root is a loop at any depth
+	tree.on_parent_hello(mesh_mac(100), mesh_mac(2), TREE_PRIO_ROOT, mesh_mac(100), 3);
+	CHECK(!tree.parent_in_tree && tree.prio == TREE_PRIO_LOOP && tree.depth_limit_hits == 0);
+	
+	// a node with a lower MAC than the loop it hangs off keeps its own label, but stays in the tree
+	tree.reset(mesh_mac(1), true);
+	tree.on_parent_hello(mesh_mac(1), mesh_mac(2), TREE_PRIO_LOOP, mesh_mac(5), 2);
+	CHECK(tree.parent_in_tree && tree.root == mesh_mac(1) && tree.depth == 0);
+	
+	// a label circling in a loop whose root has gone is stopped by the hop limit
+	tree.on_parent_hello(mesh_mac(100), mesh_mac(2), TREE_PRIO_ROOT, mesh_mac(1), TREE_MAX_DEPTH - 1);
+	CHECK(!tree.parent_in_tree && tree.depth_limit_hits == 1);
+}
+
+	const int TREE_SIM_NODES = 30;
+
+/* A tree hello on its way from node from to node to: a parent's label ('D') or a child's in_tree flag ('U')
+     */
+struct TreeSimHello {
+	char dir;
+	int from, to;
+	uint8_t prio;
+	MACAddress root;
+	uint8_t depth;
+	bool in_tree;
+};
+
+/* Exchange hellos as parse_hello() and tree_maintenance() in DEWDComm.h do it, after every node 
+	(re)joined its parent at once, until no hello is left on the way
+     *
+	 * param parent: index of each node's parent, -1 for a root; a loop of parents has no root
+	 * param mac: STA MAC of each node
+	 * return: hellos sent
+     */
+static int tree_converge(std::vector<DEWDTree>& nodes, const std::vector<int>& parent, const std::vector<MACAddress>& mac) {
+	std::deque<TreeSimHello> wire;
+	int n = nodes.size(), sent = 0;
+	auto label = [&](int from, int to) {
+		wire.push_back({'D', from, to, nodes[from].prio, nodes[from].root, nodes[from].depth, false});
+	};
+	for (int i = 0; i < n; i++) {
+		nodes[i].reset(mac[i], parent[i] >= 0);
+		if (parent[i] >= 0)
+			wire.push_back({'U', i, parent[i], 0, MACAddress(), 0, false});
+	}
+	for (int i = 0; i < n; i++)
+		if (parent[i] < 0)
+			for (int c : mesh_links(parent, i))
+				label(i, c);
+	
+	while (!wire.empty()) {
+		TreeSimHello h = wire.front();
+		wire.pop_front();
+		sent++;
+		DEWDTree& node = nodes[h.to];
+		if (h.dir == 'U') {
+			node.on_child_hello(mac[h.from], h.in_tree);
+			label(h.to, h.from);
+			continue;
+		}
+		bool was_known = node.parent_known, was_in_tree = node.parent_in_tree;
+		if (node.on_parent_hello(mac[h.to], mac[h.from], h.prio, h.root, h.depth))
+			for (int c : mesh_links(parent, h.to))
+				if (c != parent[h.to])
+					label(h.to, c);
+		if (!was_known || was_in_tree != node.parent_in_tree)
+			wire.push_back({'U', h.to, parent[h.to], 0, MACAddress(), 0, node.parent_in_tree});
+	}
+	return sent;
+}
+
+/* Send a broadcast from node orig: every node forwards the first copy to its links except the 
+	one it came from, on the tree only as broadcast() does it, and answers a later copy with 'W'
+     *
+	 * param tree: forward along tree links only
+	 * param reached: nodes that received the broadcast, incl. orig
+	 * return: messages sent, copies and 'W'
+     */
+static int tree_broadcast(std::vector<DEWDTree>& nodes, const std::vector<int>& parent, const std::vector<MACAddress>& mac, int orig, bool tree, int& reached) {
+	std::vector<bool> seen(nodes.size(), false);
+	std::deque<std::pair<int, int>> wire;
+	int sent = 0;
+	auto forward = [&](int i, int from) {
+		for (int l : mesh_links(parent, i)) {
+			bool tree_link = l == parent[i] ? nodes[i].use_parent() : nodes[i].child_in_tree(mac[l]);
+			if (l != from && (tree_link || !tree))
+				wire.push_back(std::make_pair(i, l));
+		}
+	};
+	seen[orig] = true;
+	reached = 1;
+	forward(orig, -1);
+	while (!wire.empty()) {
+		std::pair<int, int> m = wire.front();
+		wire.pop_front();
+		sent++;
+		if (seen[m.second]) {
+			sent++;													// wrong response
+			continue;
+		}
+		seen[m.second] = true;
+		reached++;
+		forward(m.second, m.first);
+	}
+	return sent;
+}
+
+/* Hellos until the tree view converged, and the messages of a broadcast pruned to the tree 
+	against a flood over every link with 'W' for every duplicate. TREE_SIM_NODES nodes, in a tree 
+	below a root or hanging off a loop of nodes connected to each others APs, random MACs.
+     */
+static void sim_tree(int runs) {
+	printf("%d nodes, random MACs, broadcasts from a random node, %d runs\n", TREE_SIM_NODES, runs);
+	for (int loop : {0, 3, 10, TREE_SIM_NODES}) {
+		double hellos = 0, pruned = 0, flooded = 0, reached = 0;
+		for (int run = 1; run <= runs; run++) {
+			std::mt19937 rng(run);
+			std::vector<int> parent;
+			mesh_tree(rng, TREE_SIM_NODES, parent);
+			for (int i = 0; i < loop; i++)								// the first nodes form a loop instead
+				parent[i] = (i + 1) % loop;
+			std::vector<MACAddress> mac;
+			for (int i = 0; i < TREE_SIM_NODES; i++)
+				mac.push_back(mesh_mac(i + 1));
+			std::shuffle(mac.begin(), mac.end(), rng);
+			
+			std::vector<DEWDTree> nodes(TREE_SIM_NODES);
+			hellos += tree_converge(nodes, parent, mac);
+			int orig = rng() % TREE_SIM_NODES, r;
+			pruned += tree_broadcast(nodes, parent, mac, orig, true, r);
+			reached += r;
+			flooded += tree_broadcast(nodes, parent, mac, orig, false, r);
+		}
+		printf(" %-16s %5.1f hellos to converge, per broadcast: tree %5.1f messages reaching %4.1f nodes, flood and 'W' %5.1f messages\n", 
+			loop == 0 ? "tree below root" : loop == TREE_SIM_NODES ? "ring, no root" : loop == 3 ? "loop of 3" : "loop of 10", 
+			hellos / runs, pruned / runs, reached / runs, flooded / runs);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//		main
+/////////////////////////////////////////////////////////////////////////////////
+
+struct Test {
+	const char* name;
+	void (*run)();
+};
+
+struct Simulation {
+	const char* name;
+	void (*run)(int runs);
+};
+
+static const Test tests[] = {
+	{"admission", test_admission},
+	{"backoff", test_backoff},
+	{"channel", test_channel},
+	{"mailbox", test_mailbox_order},
+	{"mesh_time", test_mesh_time},
+	{"rtc_seen", test_rtc_seen},
+	{"sleep", test_sleep_schedule},
+	{"sleep_drift", test_sleep_drift},
+	{"stations", test_stations},
+	{"subnet", test_subnet},
+	{"tcp_burst", test_tcp_burst},
+	{"topology", test_topology},
+	{"topo_sync", test_topo_sync},
+	{"tree_depth", test_tree_depth},
+};
+
+static const Simulation simulations[] = {
+	{"gateways", sim_gateways},
+	{"join", sim_join},
+	{"query", sim_query},
+	{"reconnect", sim_reconnect},
+	{"skew", sim_skew},
+	{"subnet", sim_subnet},
+	{"topology", sim_topology},
+	{"tree", sim_tree},
+	{"unicast", sim_unicast},
+};
+
+static bool run_test(const Test& t) {
+	int before = failures;
+	t.run();
+	printf("%-12s %s\n", t.name, failures == before ? "ok" : "FAILED");
+	return failures == before;
+}
+
+int main(int argc, char** argv) {
+	if (argc > 1 && String(argv[1]) == "-l") {
+		for (const Test& t : tests)
+			printf("test %s\n", t.name);
+		for (const Simulation& s : simulations)
+			printf("simulation %s\n", s.name);
+		return 0;
+	}
+	if (argc > 2 && String(argv[1]) == "-s") {
+		for (const Simulation& s : simulations)
+			if (String(argv[2]) == s.name) {
+				s.run(argc > 3 ? atoi(argv[3]) : 200);
+				return 0;
+			}
+		fprintf(stderr, "unknown simulation %s\n", argv[2]);
+		return 2;
+	}
+	bool ok = true;
+	for (const Test& t : tests) {
+		bool wanted = argc == 1;
+		for (int i = 1; i < argc; i++)
+			wanted |= String(argv[i]) == t.name;
+		if (wanted)
+			ok &= run_test(t);
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,44 @@
+/*
+ Arduino.h for dewd_hosttest: just enough of the ESP8266 Arduino core to compile the DEWD library on a PC.
+ Time is simulated, see host.cpp.
+ 
+ */
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include "WString.h"
+#include "Stream.h"
+#include "IPAddress.h"
+
+typedef uint8_t uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef uint64_t uint64;
+typedef int8_t sint8;
+typedef int16_t sint16;
+typedef int32_t sint32;
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define ICACHE_FLASH_ATTR
+#define ICACHE_RAM_ATTR
+#define IRAM_ATTR
+#define OUTPUT 1
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+
+using std::min;
+using std::max;
+#define constrain(x, a, b) ((x) < (a) ? (a) : ((x) > (b) ? (b) : (x)))
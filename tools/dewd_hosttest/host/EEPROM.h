@@ -0,0 +1,22 @@
+/*
+ EEPROM.h for dewd_hosttest: the emulated flash sector kept in memory.
+ 
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+class EEPROMClass {
+public:
+	uint8_t data[4096];
+
+	EEPROMClass() { for (size_t i = 0; i < sizeof(data); i++) data[i] = 0xFF; }
+	void begin(size_t) {}
+	uint8_t read(int address) { return data[address]; }
+	void write(int address, uint8_t v) { data[address] = v; }
+	bool commit() { return true; }
+	void end() {}
+};
+
+extern EEPROMClass EEPROM;
@@ -0,0 +1,11 @@
+#pragma once
+#include "Arduino.h"
+
+class EspClass {
+public:
+	uint32_t getChipId();
+	uint32_t getFreeHeap();
+	void restart();
+};
+
+extern EspClass ESP;
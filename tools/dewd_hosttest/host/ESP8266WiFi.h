@@ -0,0 +1,79 @@
+/*
+ ESP8266WiFi.h for dewd_hosttest. The radio is not simulated: WiFi reports what a test puts in host_wifi, 
+ see host.cpp.
+ 
+ */
+
+#pragma once
+#include "Arduino.h"
+#include "include/wl_definitions.h"
+#include <functional>
+#include <memory>
+extern "C" {
+#include "user_interface.h"
+}
+#include "WiFiClient.h"
+#include "WiFiServer.h"
+#include "WiFiUdp.h"
+
+enum WiFiMode_t { WIFI_OFF = 0, WIFI_STA, WIFI_AP, WIFI_AP_STA };
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED (-2)
+
+typedef enum {
+	WIFI_EVENT_STAMODE_CONNECTED = 0,
+	WIFI_EVENT_STAMODE_DISCONNECTED,
+	WIFI_EVENT_STAMODE_AUTHMODE_CHANGE,
+	WIFI_EVENT_STAMODE_GOT_IP,
+	WIFI_EVENT_STAMODE_DHCP_TIMEOUT,
+	WIFI_EVENT_SOFTAPMODE_STACONNECTED,
+	WIFI_EVENT_SOFTAPMODE_STADISCONNECTED,
+	WIFI_EVENT_SOFTAPMODE_PROBEREQRECVED,
+	WIFI_EVENT_MODE_CHANGE,
+	WIFI_EVENT_SOFTAPMODE_DISTRIBUTE_STA_IP,
+	WIFI_EVENT_MAX,
+	WIFI_EVENT_ANY = WIFI_EVENT_MAX
+} WiFiEvent_t;
+
+struct WiFiEventSoftAPModeStationConnected { uint8 mac[6]; uint8 aid; };
+struct WiFiEventSoftAPModeStationDisconnected { uint8 mac[6]; uint8 aid; };
+struct WiFiEventStationModeGotIP { IPAddress ip, mask, gw; };
+struct WiFiEventStationModeDisconnected { String ssid; uint8 bssid[6]; int reason; };
+struct WiFiEventHandlerOpaque {};
+typedef std::shared_ptr<WiFiEventHandlerOpaque> WiFiEventHandler;
+
+class ESP8266WiFiClass {
+public:
+	int status();
+	String SSID();
+	String SSID(int i);
+	int32_t RSSI();
+	int32_t RSSI(int i);
+	uint8* BSSID();
+	uint8* BSSID(int i);
+	int32_t channel();
+	int32_t channel(int i);
+	IPAddress localIP();
+	IPAddress softAPIP();
+	IPAddress gatewayIP();
+	IPAddress subnetMask();
+	int scanNetworks(bool async = false, bool hidden = false);
+	int8_t scanComplete();
+	void scanDelete();
+	bool mode(WiFiMode_t m);
+	int begin(const char* ssid, const char* password, int32_t ch = 0, const uint8* bssid = 0, bool connect = true);
+	bool config(IPAddress ip, IPAddress gw, IPAddress mask);
+	bool disconnect(bool off = false);
+	bool softAPConfig(IPAddress ip, IPAddress gw, IPAddress mask);
+	bool softAP(const char* ssid, const char* password, int ch = 1, int hidden = 0, int max_connection = 4);
+	WiFiEventHandler onSoftAPModeStationConnected(std::function<void(const WiFiEventSoftAPModeStationConnected&)> f);
+	WiFiEventHandler onSoftAPModeStationDisconnected(std::function<void(const WiFiEventSoftAPModeStationDisconnected&)> f);
+	WiFiEventHandler onStationModeGotIP(std::function<void(const WiFiEventStationModeGotIP&)> f);
+	WiFiEventHandler onStationModeDisconnected(std::function<void(const WiFiEventStationModeDisconnected&)> f);
+	void onEvent(void (*f)(WiFiEvent_t), WiFiEvent_t e = WIFI_EVENT_ANY);
+	String macAddress();
+	String softAPmacAddress();
+};
+
+extern ESP8266WiFiClass WiFi;
+#include "ESP.h"
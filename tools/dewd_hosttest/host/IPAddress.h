@@ -0,0 +1,39 @@
+/*
+ IPAddress.h for dewd_hosttest.
+ 
+ */
+
+#pragma once
+#include "Printable.h"
+
+class IPAddress : public Printable {
+private:
+	uint8_t _a[4];
+
+public:
+	IPAddress() { memset(_a, 0, 4); }
+	IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) { _a[0] = a; _a[1] = b; _a[2] = c; _a[3] = d; }
+	IPAddress(uint32_t v) { memcpy(_a, &v, 4); }
+	operator uint32_t() const { uint32_t v; memcpy(&v, _a, 4); return v; }
+	bool operator==(const IPAddress& x) const { return memcmp(_a, x._a, 4) == 0; }
+	bool operator!=(const IPAddress& x) const { return memcmp(_a, x._a, 4) != 0; }
+	uint8_t operator[](int i) const { return _a[i]; }
+	uint8_t& operator[](int i) { return _a[i]; }
+	bool fromString(const char* str) {
+		unsigned v[4];
+		if (sscanf(str, "%u.%u.%u.%u", &v[0], &v[1], &v[2], &v[3]) != 4)
+			return false;
+		for (int i = 0; i < 4; i++)
+			_a[i] = v[i];
+		return true;
+	}
+	bool fromString(const String& str) { return fromString(str.c_str()); }
+	String toString() const {
+		char buf[16];
+		snprintf(buf, sizeof(buf), "%u.%u.%u.%u", _a[0], _a[1], _a[2], _a[3]);
+		return buf;
+	}
+	size_t printTo(Print& p) const { return p.print(toString()); }
+};
+
+extern const IPAddress INADDR_NONE;
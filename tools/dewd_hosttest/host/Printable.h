@@ -0,0 +1,38 @@
+/*
+ Printable.h for dewd_hosttest: Print and Printable of the Arduino core.
+ 
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "WString.h"
+
+class Print;
+
+class Printable {
+public:
+	virtual ~Printable() {}
+	virtual size_t printTo(Print& p) const = 0;
+};
+
+class Print {
+public:
+	virtual ~Print() {}
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t* buf, size_t n) {
+		size_t res = 0;
+		while (n--)
+			res += write(*buf++);
+		return res;
+	}
+	size_t write(const char* str) { return write((const uint8_t*)str, strlen(str)); }
+	virtual void flush() {}
+	template<class T> size_t print(const T& v) { String str(v); return write((const uint8_t*)str.c_str(), str.length()); }
+	template<class T> size_t print(const T& v, int base) { String str(v, base); return write((const uint8_t*)str.c_str(), str.length()); }
+	size_t print(const Printable& p) { return p.printTo(*this); }
+	size_t println() { return write((const uint8_t*)"\r\n", 2); }
+	template<class T> size_t println(const T& v) { return print(v) + println(); }
+	template<class T> size_t println(const T& v, int base) { return print(v, base) + println(); }
+	size_t println(const Printable& p) { return p.printTo(*this) + println(); }
+};
@@ -0,0 +1,51 @@
+/*
+ Stream.h for dewd_hosttest. Serial reads from host_in and writes to host_out, so a test can type 
+ console commands and look at what the node printed.
+ 
+ */
+
+#pragma once
+#include "Print.h"
+#include <string>
+
+extern std::string host_in, host_out;
+
+class Stream : public Print {
+public:
+	virtual int available() { return host_in.size(); }
+	virtual int read() {
+		if (host_in.empty())
+			return -1;
+		int c = (uint8_t)host_in[0];
+		host_in.erase(0, 1);
+		return c;
+	}
+	virtual int peek() { return host_in.empty() ? -1 : (uint8_t)host_in[0]; }
+	size_t write(uint8_t c) { host_out += (char)c; return 1; }
+	size_t write(const uint8_t* buf, size_t n) { host_out.append((const char*)buf, n); return n; }
+	using Print::write;
+	void setTimeout(unsigned long) {}
+	String readString() { String res(host_in); host_in.clear(); return res; }
+	String readStringUntil(char end) {
+		size_t p = host_in.find(end);
+		String res(host_in.substr(0, p));
+		host_in.erase(0, p == std::string::npos ? p : p + 1);
+		return res;
+	}
+	size_t readBytes(char* buf, size_t n) {
+		n = std::min(n, host_in.size());
+		memcpy(buf, host_in.data(), n);
+		host_in.erase(0, n);
+		return n;
+	}
+};
+
+class HardwareSerial : public Stream {
+public:
+	void begin(unsigned long) {}
+	void updateBaudRate(unsigned long) {}
+	void end() {}
+	operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
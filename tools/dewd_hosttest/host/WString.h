@@ -0,0 +1,104 @@
+/*
+ WString.h for dewd_hosttest: the Arduino String on top of std::string.
+ 
+ */
+
+#pragma once
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cctype>
+
+#define HEX 16
+#define DEC 10
+
+class String {
+private:
+	static std::string num(unsigned long long v, bool neg, int base) {
+		char buf[70];
+		snprintf(buf, sizeof(buf), base == 16 ? "%s%llx" : "%s%llu", neg ? "-" : "", v);
+		return buf;
+	}
+
+public:
+	std::string s;
+
+	String() {}
+	String(const char* c) : s(c ? c : "") {}
+	String(const std::string& x) : s(x) {}
+	String(char c) : s(1, c) {}
+	String(unsigned char v, int base = 10) : s(num(v, false, base)) {}
+	String(int v, int base = 10) : s(base == 10 && v < 0 ? num(-(long long)v, true, base) : num((unsigned)v, false, base)) {}
+	String(unsigned v, int base = 10) : s(num(v, false, base)) {}
+	String(long v, int base = 10) : s(base == 10 && v < 0 ? num(-(long long)v, true, base) : num((unsigned long)v, false, base)) {}
+	String(unsigned long v, int base = 10) : s(num(v, false, base)) {}
+	String(float v, int decimals = 2) { char buf[40]; snprintf(buf, sizeof(buf), "%.*f", decimals, v); s = buf; }
+	String(double v, int decimals = 2) { char buf[40]; snprintf(buf, sizeof(buf), "%.*f", decimals, v); s = buf; }
+
+	const char* c_str() const { return s.c_str(); }
+	unsigned length() const { return s.size(); }
+	char operator[](unsigned i) const { return i < s.size() ? s[i] : 0; }
+	char& operator[](unsigned i) { return s[i]; }
+	char charAt(unsigned i) const { return (*this)[i]; }
+	String substring(unsigned from) const { return from > s.size() ? String() : String(s.substr(from)); }
+	String substring(unsigned from, unsigned to) const {
+		if (to < from)
+			std::swap(from, to);
+		return from > s.size() ? String() : String(s.substr(from, to - from));
+	}
+	int indexOf(char c, unsigned from = 0) const { size_t p = s.find(c, from); return p == std::string::npos ? -1 : (int)p; }
+	int indexOf(const String& x, unsigned from = 0) const { size_t p = s.find(x.s, from); return p == std::string::npos ? -1 : (int)p; }
+	int lastIndexOf(char c) const { size_t p = s.rfind(c); return p == std::string::npos ? -1 : (int)p; }
+	bool startsWith(const String& x) const { return s.compare(0, x.s.size(), x.s) == 0; }
+	bool endsWith(const String& x) const { return s.size() >= x.s.size() && s.compare(s.size() - x.s.size(), x.s.size(), x.s) == 0; }
+	void replace(char a, char b) { for (char& c : s) if (c == a) c = b; }
+	void replace(const String& a, const String& b) {
+		size_t p = 0;
+		while (!a.s.empty() && (p = s.find(a.s, p)) != std::string::npos) {
+			s.replace(p, a.s.size(), b.s);
+			p += b.s.size();
+		}
+	}
+	void remove(unsigned i) { if (i < s.size()) s.erase(i); }
+	void remove(unsigned i, unsigned n) { if (i < s.size()) s.erase(i, n); }
+	void trim() {
+		size_t a = 0, b = s.size();
+		while (a < b && isspace((unsigned char)s[a])) a++;
+		while (b > a && isspace((unsigned char)s[b - 1])) b--;
+		s = s.substr(a, b - a);
+	}
+	void toUpperCase() { for (char& c : s) c = toupper((unsigned char)c); }
+	void toLowerCase() { for (char& c : s) c = tolower((unsigned char)c); }
+	bool reserve(unsigned n) { s.reserve(n); return true; }
+	long toInt() const { return atol(s.c_str()); }
+	float toFloat() const { return atof(s.c_str()); }
+	bool equals(const String& x) const { return s == x.s; }
+	bool operator==(const String& x) const { return s == x.s; }
+	bool operator==(const char* x) const { return s == x; }
+	bool operator!=(const String& x) const { return s != x.s; }
+	bool operator!=(const char* x) const { return s != x; }
+	bool operator<(const String& x) const { return s < x.s; }
+	template<class T> String& operator+=(const T& v) { s += String(v).s; return *this; }
+	String& operator+=(const String& v) { s += v.s; return *this; }
+	String& operator+=(const char* v) { s += v; return *this; }
+	String& operator+=(char v) { s += v; return *this; }
+	String& concat(const String& v) { s += v.s; return *this; }
+	String& concat(char v) { s += v; return *this; }
+	String& concat(const char* v, unsigned n) { s.append(v, n); return *this; }
+	void getBytes(unsigned char* buf, unsigned n) const { toCharArray((char*)buf, n); }
+	void toCharArray(char* buf, unsigned n) const {
+		if (n == 0)
+			return;
+		strncpy(buf, s.c_str(), n - 1);
+		buf[n - 1] = 0;
+	}
+};
+
+inline String operator+(const String& a, const String& b) { return String(a.s + b.s); }
+inline String operator+(const String& a, const char* b) { return String(a.s + b); }
+inline String operator+(const char* a, const String& b) { return String(a + b.s); }
+inline String operator+(const String& a, char b) { return String(a.s + b); }
+inline String operator+(const String& a, int b) { return a + String(b); }
+inline String operator+(const String& a, unsigned long b) { return a + String(b); }
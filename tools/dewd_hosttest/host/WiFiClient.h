@@ -0,0 +1,39 @@
+/*
+ WiFiClient.h for dewd_hosttest. A client is a handle on a HostConn, the bytes a test has queued for it.
+ 
+ */
+
+#pragma once
+#include "Arduino.h"
+#include <memory>
+#include <string>
+
+struct HostConn {
+	std::string data;
+	size_t pos = 0;
+	bool open = true;
+	IPAddress ip;
+};
+
+class WiFiClient : public Stream {
+public:
+	std::shared_ptr<HostConn> conn;
+
+	int connect(IPAddress, uint16_t) { return 1; }
+	int connected() { return conn && conn->open; }
+	void stop() {
+		if (conn)
+			conn->open = false;
+		conn.reset();
+	}
+	operator bool() { return (bool)conn; }
+	IPAddress remoteIP() { return conn ? conn->ip : IPAddress(); }
+	int available() { return conn ? conn->data.size() - conn->pos : 0; }
+	int read() { return conn && conn->pos < conn->data.size() ? (uint8_t)conn->data[conn->pos++] : -1; }
+	size_t write(uint8_t) { return 1; }
+	size_t write(const uint8_t*, size_t n) { return n; }
+	using Print::write;
+	void setNoDelay(bool) {}
+	void setTimeout(unsigned long) {}
+	uint8_t status() { return 0; }
+};
@@ -0,0 +1,26 @@
+/*
+ WiFiServer.h for dewd_hosttest. available() hands out the connections a test has put in host_backlog.
+ 
+ */
+
+#pragma once
+#include "WiFiClient.h"
+#include <deque>
+
+extern std::deque<std::shared_ptr<HostConn> > host_backlog;
+
+class WiFiServer {
+public:
+	WiFiServer(uint16_t) {}
+	void begin() {}
+	void stop() {}
+	bool hasClient() { return !host_backlog.empty(); }
+	WiFiClient available() {
+		WiFiClient res;
+		if (!host_backlog.empty()) {
+			res.conn = host_backlog.front();
+			host_backlog.pop_front();
+		}
+		return res;
+	}
+};
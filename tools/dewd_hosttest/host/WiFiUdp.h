@@ -0,0 +1,20 @@
+#pragma once
+#include "Arduino.h"
+
+class WiFiUDP : public Stream {
+public:
+	uint8_t begin(uint16_t port);
+	uint8_t beginMulticast(IPAddress iface, IPAddress group, uint16_t port);
+	void stop();
+	int beginPacket(IPAddress ip, uint16_t port);
+	int endPacket();
+	int parsePacket();
+	int read(unsigned char* buf, size_t n);
+	int read();
+	void flush();
+	IPAddress remoteIP();
+	uint16_t remotePort();
+	size_t write(const char* buf, size_t n);
+	size_t write(uint8_t c);
+	using Print::write;
+};
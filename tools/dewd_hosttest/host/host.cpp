@@ -0,0 +1,155 @@
+/*
+ host.cpp defines the Arduino core and SDK functions the DEWD library calls, on a simulated clock.
+ 
+ */
+
+#include "host.h"
+#include <EEPROM.h>
+#include <random>
+
+unsigned long long host_us = 0;
+HostWiFi host_wifi;
+uint8_t host_rtc_mem[768];
+std::string host_in, host_out;
+std::deque<std::shared_ptr<HostConn> > host_backlog;
+HardwareSerial Serial;
+ESP8266WiFiClass WiFi;
+EspClass ESP;
+EEPROMClass EEPROM;
+const IPAddress INADDR_NONE(0, 0, 0, 0);
+
+static std::mt19937 rng(1);
+
+void host_seed(unsigned long seed) { rng.seed(seed); }
+
+unsigned long millis() { return host_us / 1000; }
+unsigned long micros() { return host_us; }
+void delay(unsigned long ms) { host_us += ms * 1000ULL; }
+void yield() {}
+long random(long howbig) { return howbig <= 0 ? 0 : (long)(rng() % (unsigned long)howbig); }
+long random(long howsmall, long howbig) { return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall); }
+void randomSeed(unsigned long seed) { host_seed(seed); }
+void pinMode(int, int) {}
+void digitalWrite(int, int) {}
+
+uint32_t EspClass::getChipId() { return host_wifi.mac[3] << 16 | host_wifi.mac[4] << 8 | host_wifi.mac[5]; }
+uint32_t EspClass::getFreeHeap() { return 40000; }
+void EspClass::restart() {}
+
+int ESP8266WiFiClass::status() { return host_wifi.status; }
+String ESP8266WiFiClass::SSID() { return host_wifi.status == WL_CONNECTED ? host_wifi.current.ssid : String(); }
+String ESP8266WiFiClass::SSID(int i) { return host_wifi.scan[i].ssid; }
+int32_t ESP8266WiFiClass::RSSI() { return host_wifi.current.rssi; }
+int32_t ESP8266WiFiClass::RSSI(int i) { return host_wifi.scan[i].rssi; }
+uint8* ESP8266WiFiClass::BSSID() { return host_wifi.current.bssid; }
+uint8* ESP8266WiFiClass::BSSID(int i) { return host_wifi.scan[i].bssid; }
+int32_t ESP8266WiFiClass::channel() { return host_wifi.current.channel; }
+int32_t ESP8266WiFiClass::channel(int i) { return host_wifi.scan[i].channel; }
+IPAddress ESP8266WiFiClass::localIP() { return host_wifi.local_ip; }
+IPAddress ESP8266WiFiClass::softAPIP() { return host_wifi.softap_ip; }
+IPAddress ESP8266WiFiClass::gatewayIP() { return host_wifi.gateway_ip; }
+IPAddress ESP8266WiFiClass::subnetMask() { return IPAddress(255, 255, 255, 0); }
+int ESP8266WiFiClass::scanNetworks(bool async, bool) { return async ? WIFI_SCAN_RUNNING : host_wifi.scan.size(); }
+int8_t ESP8266WiFiClass::scanComplete() { return host_wifi.scan.size(); }
+void ESP8266WiFiClass::scanDelete() {}
+bool ESP8266WiFiClass::mode(WiFiMode_t) { return true; }
+int ESP8266WiFiClass::begin(const char*, const char*, int32_t, const uint8*, bool) { host_wifi.begins++; return host_wifi.status; }
+bool ESP8266WiFiClass::config(IPAddress, IPAddress, IPAddress) { host_wifi.configs++; return true; }
+bool ESP8266WiFiClass::disconnect(bool) { host_wifi.status = WL_DISCONNECTED; return true; }
+bool ESP8266WiFiClass::softAPConfig(IPAddress ip, IPAddress, IPAddress) { host_wifi.softap_ip = ip; return true; }
+bool ESP8266WiFiClass::softAP(const char*, const char*, int, int, int) { return true; }
+WiFiEventHandler ESP8266WiFiClass::onSoftAPModeStationConnected(std::function<void(const WiFiEventSoftAPModeStationConnected&)> f) {
+	host_wifi.station_connected = f;
+	host_wifi.handlers++;
+	return WiFiEventHandler(new WiFiEventHandlerOpaque);
+}
+
+WiFiEventHandler ESP8266WiFiClass::onSoftAPModeStationDisconnected(std::function<void(const WiFiEventSoftAPModeStationDisconnected&)> f) {
+	host_wifi.station_disconnected = f;
+	host_wifi.handlers++;
+	return WiFiEventHandler(new WiFiEventHandlerOpaque);
+}
+
+WiFiEventHandler ESP8266WiFiClass::onStationModeGotIP(std::function<void(const WiFiEventStationModeGotIP&)>) { host_wifi.handlers++; return WiFiEventHandler(new WiFiEventHandlerOpaque); }
+WiFiEventHandler ESP8266WiFiClass::onStationModeDisconnected(std::function<void(const WiFiEventStationModeDisconnected&)>) { host_wifi.handlers++; return WiFiEventHandler(new WiFiEventHandlerOpaque); }
+void ESP8266WiFiClass::onEvent(void (*)(WiFiEvent_t), WiFiEvent_t) { host_wifi.handlers++; }
+String ESP8266WiFiClass::macAddress() { return String(); }
+String ESP8266WiFiClass::softAPmacAddress() { return String(); }
+
+uint8_t WiFiUDP::begin(uint16_t) { return 1; }
+uint8_t WiFiUDP::beginMulticast(IPAddress, IPAddress, uint16_t) { return 1; }
+void WiFiUDP::stop() {}
+int WiFiUDP::beginPacket(IPAddress, uint16_t) { return 1; }
+int WiFiUDP::endPacket() { return 1; }
+int WiFiUDP::parsePacket() { return 0; }
+int WiFiUDP::read(unsigned char*, size_t) { return 0; }
+int WiFiUDP::read() { return -1; }
+void WiFiUDP::flush() {}
+IPAddress WiFiUDP::remoteIP() { return IPAddress(); }
+uint16_t WiFiUDP::remotePort() { return 0; }
+size_t WiFiUDP::write(const char*, size_t n) { return n; }
+size_t WiFiUDP::write(uint8_t) { return 1; }
+
+extern "C" {
+
+bool wifi_set_user_ie(bool, uint8*, user_ie_type, uint8*, uint8) { return true; }
+sint32 wifi_register_user_ie_manufacturer_recv_cb(user_ie_manufacturer_recv_cb_t) { return 0; }
+void wifi_unregister_user_ie_manufacturer_recv_cb() {}
+
+bool wifi_get_macaddr(uint8 if_index, uint8* mac) {
+	memcpy(mac, if_index == SOFTAP_IF ? host_wifi.softap_mac : host_wifi.mac, 6);
+	return true;
+}
+
+struct station_info* wifi_softap_get_station_info() {
+	std::vector<station_info>& st = host_wifi.stations;
+	for (size_t i = 0; i < st.size(); i++)
+		st[i].next.stqe_next = i + 1 < st.size() ? &st[i + 1] : 0;
+	return st.empty() ? 0 : &st[0];
+}
+
+void wifi_softap_free_station_info() {}
+uint8 wifi_softap_get_station_num() { return host_wifi.stations.size(); }
+bool wifi_softap_get_config(struct softap_config*) { return true; }
+bool wifi_station_get_config(struct station_config*) { return true; }
+uint8 wifi_station_get_current_ap_id() { return 0; }
+uint8 wifi_station_get_connect_status() { return host_wifi.status == WL_CONNECTED ? 5 : 0; }
+sint8 wifi_station_get_rssi() { return host_wifi.current.rssi; }
+bool wifi_station_set_auto_connect(uint8) { return true; }
+bool wifi_station_set_reconnect_policy(bool) { return true; }
+bool wifi_station_disconnect(void) { host_wifi.status = WL_DISCONNECTED; return true; }
+uint8 wifi_get_opmode() { return 3; }
+bool wifi_set_phy_mode(phy_mode) { return true; }
+phy_mode wifi_get_phy_mode() { return PHY_MODE_11N; }
+bool wifi_set_sleep_type(sleep_type) { return true; }
+sleep_type wifi_get_sleep_type() { return NONE_SLEEP_T; }
+uint8 wifi_get_channel() { return host_wifi.current.channel; }
+bool wifi_set_channel(uint8) { return true; }
+bool wifi_get_ip_info(uint8, struct ip_info*) { return true; }
+uint16 system_get_vdd33() { return 3300; }
+uint16 system_adc_read() { return 0; }
+const char* system_get_sdk_version() { return "host"; }
+void system_restart() {}
+bool system_deep_sleep_set_option(uint8) { return true; }
+void system_deep_sleep(uint64) {}
+uint32 system_get_free_heap_size() { return 40000; }
+uint32 system_get_time() { return (uint32)host_us; }
+uint32 system_get_rtc_time() { return (uint32)(host_us / 6); }
+uint32 system_rtc_clock_cali_proc() { return 6 << 12; }
+
+bool system_rtc_mem_read(uint8 src_addr, void* des_addr, uint16 save_size) {
+	memcpy(des_addr, host_rtc_mem + src_addr * 4, save_size);
+	return true;
+}
+
+bool system_rtc_mem_write(uint8 des_addr, const void* src_addr, uint16 save_size) {
+	memcpy(host_rtc_mem + des_addr * 4, src_addr, save_size);
+	return true;
+}
+
+struct rst_info* system_get_rst_info() {
+	static struct rst_info info = {REASON_DEFAULT_RST};
+	return &info;
+}
+
+}
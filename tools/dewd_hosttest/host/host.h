@@ -0,0 +1,37 @@
+/*
+ host.h declares the simulated environment of dewd_hosttest: the clock, the random generator and what 
+ the radio reports. Tests set these directly.
+ 
+ */
+
+#pragma once
+#include <ESP8266WiFi.h>
+#include <vector>
+
+struct HostNetwork {
+	String ssid;
+	uint8 bssid[6];
+	int32_t rssi;
+	int32_t channel;
+};
+
+struct HostWiFi {
+	int status = WL_DISCONNECTED;
+	HostNetwork current;											// network the station is connected to
+	uint8 mac[6] = {0x5c, 0xcf, 0x7f, 0x00, 0x00, 0x01};
+	uint8 softap_mac[6] = {0x5e, 0xcf, 0x7f, 0x00, 0x00, 0x01};
+	IPAddress local_ip, gateway_ip, softap_ip;
+	std::vector<HostNetwork> scan;									// result of the next scan
+	std::vector<station_info> stations;								// stations on the softAP
+	int begins = 0;													// calls of WiFi.begin()
+	int configs = 0;												// calls of WiFi.config()
+	int handlers = 0;												// event handlers registered
+	std::function<void(const WiFiEventSoftAPModeStationConnected&)> station_connected;
+	std::function<void(const WiFiEventSoftAPModeStationDisconnected&)> station_disconnected;
+};
+
+extern unsigned long long host_us;									// simulated time, delay() advances it
+extern HostWiFi host_wifi;
+extern uint8_t host_rtc_mem[768];									// RTC memory, 4-byte blocks addressed as on the chip
+
+void host_seed(unsigned long seed);
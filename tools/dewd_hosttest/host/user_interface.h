@@ -0,0 +1,62 @@
+/*
+ user_interface.h for dewd_hosttest: the parts of the NONOS SDK the DEWD library calls, defined in host.cpp.
+ 
+ */
+
+#pragma once
+#include "Arduino.h"
+
+#define STATION_IF 0
+#define SOFTAP_IF 1
+#define STAILQ_ENTRY(t) struct { struct t* stqe_next; }
+#define STAILQ_NEXT(e, f) ((e)->f.stqe_next)
+
+struct ip_addr { uint32_t addr; };
+typedef struct ip_addr ip_addr_t;
+struct ip_info { struct ip_addr ip, netmask, gw; };
+struct station_info { STAILQ_ENTRY(station_info) next; uint8 bssid[6]; struct ip_addr ip; };
+struct station_config { uint8 ssid[32]; uint8 password[64]; uint8 bssid_set; uint8 bssid[6]; };
+struct softap_config { uint8 ssid[32]; uint8 password[64]; uint8 ssid_len; uint8 channel; int authmode; uint8 ssid_hidden; uint8 max_connection; uint16 beacon_interval; };
+struct rst_info { uint32 reason; };
+enum phy_mode { PHY_MODE_11B = 1, PHY_MODE_11G = 2, PHY_MODE_11N = 3 };
+enum sleep_type { NONE_SLEEP_T = 0, LIGHT_SLEEP_T, MODEM_SLEEP_T };
+enum rst_reason { REASON_DEFAULT_RST = 0, REASON_WDT_RST, REASON_EXCEPTION_RST, REASON_SOFT_WDT_RST, REASON_SOFT_RESTART, REASON_DEEP_SLEEP_AWAKE, REASON_EXT_SYS_RST };
+typedef enum { USER_IE_BEACON = 0, USER_IE_PROBE_REQ, USER_IE_PROBE_RESP, USER_IE_ASSOC_REQ, USER_IE_ASSOC_RESP, USER_IE_MAX } user_ie_type;
+typedef void (*user_ie_manufacturer_recv_cb_t)(user_ie_type type, const uint8 sa[6], const uint8 m_oui[3], uint8* ie, uint8 ie_len, sint32 rssi);
+
+bool wifi_set_user_ie(bool enable, uint8* m_oui, user_ie_type type, uint8* user_ie, uint8 len);
+sint32 wifi_register_user_ie_manufacturer_recv_cb(user_ie_manufacturer_recv_cb_t cb);
+void wifi_unregister_user_ie_manufacturer_recv_cb();
+bool wifi_get_macaddr(uint8 if_index, uint8* mac);
+struct station_info* wifi_softap_get_station_info();
+void wifi_softap_free_station_info();
+uint8 wifi_softap_get_station_num();
+bool wifi_softap_get_config(struct softap_config* config);
+bool wifi_station_get_config(struct station_config* config);
+uint8 wifi_station_get_current_ap_id();
+uint8 wifi_station_get_connect_status();
+sint8 wifi_station_get_rssi();
+bool wifi_station_set_auto_connect(uint8 set);
+bool wifi_station_set_reconnect_policy(bool set);
+bool wifi_station_disconnect(void);
+uint8 wifi_get_opmode();
+bool wifi_set_phy_mode(phy_mode mode);
+phy_mode wifi_get_phy_mode();
+bool wifi_set_sleep_type(sleep_type type);
+sleep_type wifi_get_sleep_type();
+uint8 wifi_get_channel();
+bool wifi_set_channel(uint8 channel);
+bool wifi_get_ip_info(uint8 if_index, struct ip_info* info);
+uint16 system_get_vdd33();
+uint16 system_adc_read();
+const char* system_get_sdk_version();
+void system_restart();
+bool system_deep_sleep_set_option(uint8 option);
+void system_deep_sleep(uint64 time_in_us);
+uint32 system_get_free_heap_size();
+uint32 system_get_time();
+uint32 system_get_rtc_time();
+uint32 system_rtc_clock_cali_proc();
+bool system_rtc_mem_read(uint8 src_addr, void* des_addr, uint16 save_size);
+bool system_rtc_mem_write(uint8 des_addr, const void* src_addr, uint16 save_size);
+struct rst_info* system_get_rst_info();